@@ -0,0 +1,322 @@
+/*
+
+Licensed under the Apache License, Version 2.0 (the "License"); you may not use
+this file except in compliance with the License. You may obtain a copy of the
+License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software distributed
+under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+CONDITIONS OF ANY KIND, either express or implied. See the License for the
+specific language governing permissions and limitations under the License.
+
+*/
+
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "window-discovery.h"
+#include "x-backend-fake.h"
+
+
+/**
+ * Numbers of top-level windows to simulate.
+ */
+int WINDOWS_SIZES[] = { 10, 100, 1000, 10000 };
+int WINDOWS_SIZES_SIZE = sizeof(WINDOWS_SIZES) / sizeof(*WINDOWS_SIZES);
+/**
+ * Round trip times to simulate, in seconds: local, a busy server, and a remote
+ * connection.
+ */
+double LATENCIES[] = { 0.0001, 0.001, 0.02 };
+int LATENCIES_SIZE = sizeof(LATENCIES) / sizeof(*LATENCIES);
+/**
+ * Time the server spends on each request, in seconds.
+ */
+double REQUEST_TIME = 0.000002;
+/**
+ * How windows are arranged: clients are children of the root window and
+ * listed in _NET_CLIENT_LIST; or each client is inside a frame (or a frame
+ * inside a frame), with WM_STATE set, and there is no _NET_CLIENT_LIST.
+ */
+char* LAYOUTS[] = { "listed", "framed", "nested" };
+int LAYOUTS_SIZE = sizeof(LAYOUTS) / sizeof(*LAYOUTS);
+/**
+ * Atoms used by the fake server.
+ */
+xcb_atom_t ATOM_CLIENT_LIST = 300;
+xcb_atom_t ATOM_WM_STATE = 301;
+xcb_atom_t ATOM_WINDOW_TYPE = 302;
+xcb_atom_t ATOM_TYPE_NORMAL = 303;
+xcb_atom_t ATOM_TYPE_DOCK = 304;
+xcb_atom_t ATOM_DESKTOP = 305;
+xcb_atom_t ATOM_CURRENT_DESKTOP = 306;
+xcb_atom_t ATOM_STATE = 307;
+xcb_atom_t ATOM_STATE_HIDDEN = 308;
+xcb_atom_t ATOM_TYPE_OTHER = 309;
+/**
+ * Filters used for cases with a filter, and how they're shown.  The first
+ * leaves out docks by the default rule for window types; the others test
+ * types, so they replace the rule, and find only docks, or only normal
+ * windows, including those without a type.
+ */
+char* FILTERS[] = { "desktop & !state=hidden & !class=\"Panel*\"",
+                    "type=dock", "type=normal" };
+char* FILTER_NAMES[] = { "some", "dock", "normal" };
+int FILTERS_SIZE = sizeof(FILTERS) / sizeof(*FILTERS);
+/**
+ * Screen size.
+ */
+int SCREEN_WIDTH = 3840;
+int SCREEN_HEIGHT = 2160;
+/**
+ * Minimum total time spent finding windows for each case, in seconds.
+ */
+double MIN_TIME = 0.1;
+
+
+/**
+ * Get the current time in seconds.
+ */
+double now () {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+/**
+ * Build a fake server for a case.  Every 10th window is unmapped, and every
+ * 7th is a dock; every 13th lists a type we don't know before its standard
+ * one, and every 17th that isn't a dock has no type, so is normal.  Positions
+ * are pseudo-random, but the same for every run.  Windows are spread over 3
+ * desktops, with some on every desktop, every 5th is hidden and every 11th is
+ * a panel.
+ *
+ * layout: index into `LAYOUTS`
+ * filter: index into `FILTERS` of the filter used, or -1
+ * expected_size (output): number of windows that should be found
+ *
+ * returns: 0 on success, -1 on failure
+ */
+int build_fake (int windows_size, int layout, double latency, int filter,
+                x_fake_t* fake, int* expected_size) {
+    if (x_fake_create(SCREEN_WIDTH, SCREEN_HEIGHT, latency, REQUEST_TIME,
+                      fake) != 0) {
+        return -1;
+    }
+    xcb_window_t* clients = calloc(windows_size, sizeof(xcb_window_t));
+    unsigned int seed = 1;
+    *expected_size = 0;
+
+    for (int i = 0; i < windows_size; i++) {
+        seed = seed * 1103515245 + 12345;
+        int x = (seed >> 8) % (SCREEN_WIDTH - 400);
+        seed = seed * 1103515245 + 12345;
+        int y = (seed >> 8) % (SCREEN_HEIGHT - 300);
+        xcb_rectangle_t rect = { x, y, 400, 300 };
+        xcb_rectangle_t inner = { 0, 20, 400, 280 };
+
+        xcb_window_t top = x_fake_add_window(fake, X_FAKE_ROOT, rect, 1);
+        xcb_window_t client = top;
+        if (layout > 0) {
+            xcb_window_t parent = top;
+            if (layout == 2) {
+                xcb_rectangle_t full = { 0, 0, 400, 300 };
+                parent = x_fake_add_window(fake, top, full, 0);
+            }
+            client = x_fake_add_window(fake, parent, inner, 0);
+            uint32_t state[] = { 1, XCB_NONE };
+            x_fake_set_property(fake, client, ATOM_WM_STATE, ATOM_WM_STATE,
+                                state, sizeof(state));
+        }
+        if (client == XCB_NONE) {
+            free(clients);
+            return -1;
+        }
+        clients[i] = client;
+
+        uint32_t type[] = {
+            ATOM_TYPE_OTHER, i % 7 == 0 ? ATOM_TYPE_DOCK : ATOM_TYPE_NORMAL
+        };
+        int other = i % 13 == 0 ? 0 : 1;
+        if (i % 17 != 0 || i % 7 == 0) {
+            x_fake_set_property(fake, client, ATOM_WINDOW_TYPE, XCB_ATOM_ATOM,
+                                type + other, sizeof(type) - other * 4);
+        }
+        if (i % 10 == 0) {
+            x_fake_window(fake, top)->viewable = 0;
+            x_fake_window(fake, client)->viewable = 0;
+        }
+
+        uint32_t desktop[] = { i % 8 == 1 ? 0xFFFFFFFF : (uint32_t)(i % 3) };
+        x_fake_set_property(fake, client, ATOM_DESKTOP, XCB_ATOM_CARDINAL,
+                            desktop, sizeof(desktop));
+        if (i % 5 == 0) {
+            uint32_t state[] = { ATOM_STATE_HIDDEN };
+            x_fake_set_property(fake, client, ATOM_STATE, XCB_ATOM_ATOM,
+                                state, sizeof(state));
+        }
+        // the instance and class, each null-terminated
+        char panel_class[] = "panel\0Panel";
+        char app_class[] = "app\0App";
+        if (i % 11 == 0) {
+            x_fake_set_property(fake, client, XCB_ATOM_WM_CLASS,
+                                XCB_ATOM_STRING, panel_class,
+                                sizeof(panel_class));
+        } else {
+            x_fake_set_property(fake, client, XCB_ATOM_WM_CLASS,
+                                XCB_ATOM_STRING, app_class, sizeof(app_class));
+        }
+
+        if (filter == 1) {
+            if (i % 10 != 0 && i % 7 == 0) *expected_size += 1;
+        } else if (filter == 2) {
+            if (i % 10 != 0 && i % 7 != 0) *expected_size += 1;
+        } else if (i % 10 != 0 && i % 7 != 0 && (filter == -1 || (
+            (i % 8 == 1 || i % 3 == 0) && i % 5 != 0 && i % 11 != 0
+        ))) {
+            *expected_size += 1;
+        }
+    }
+
+    uint32_t current_desktop[] = { 0 };
+    x_fake_set_property(fake, X_FAKE_ROOT, ATOM_CURRENT_DESKTOP,
+                        XCB_ATOM_CARDINAL, current_desktop,
+                        sizeof(current_desktop));
+
+    if (layout == 0) {
+        x_fake_set_property(fake, X_FAKE_ROOT, ATOM_CLIENT_LIST,
+                            XCB_ATOM_WINDOW, clients,
+                            windows_size * sizeof(xcb_window_t));
+    }
+    free(clients);
+    return 0;
+}
+
+
+/**
+ * Run window discovery for one case, and check the result.
+ *
+ * filter_index: index into `FILTERS` of the filter to use, or -1
+ * filter: the filter, compiled, or NULL
+ *
+ * returns: 0 if the result is as expected, 1 otherwise
+ */
+int bench_case (int windows_size, int layout, double latency,
+                int visible_only, int filter_index, filter_t* filter) {
+    xcb_atom_t normal_types[] = { ATOM_TYPE_NORMAL };
+    int runs = 0;
+    // time spent finding windows, excluding building the fake server
+    double elapsed = 0;
+    x_fake_t fake;
+    x_backend_t backend;
+    int found_size;
+    int expected_size;
+    char* problem = NULL;
+
+    do {
+        if (runs > 0) x_fake_free(&fake);
+        if (build_fake(windows_size, layout, latency, filter_index,
+                       &fake, &expected_size) != 0) {
+            problem = "building the fake server failed";
+            break;
+        }
+        x_fake_backend(&fake, &backend);
+        discovery_t discovery = {
+            .backend = &backend, .root = X_FAKE_ROOT,
+            .client_list = ATOM_CLIENT_LIST, .wm_state = ATOM_WM_STATE,
+            .window_type = ATOM_WINDOW_TYPE, .desktop = ATOM_DESKTOP,
+            .current_desktop = ATOM_CURRENT_DESKTOP, .state = ATOM_STATE,
+            .normal_types = normal_types, .normal_types_size = 1,
+            .max_windows = windows_size, .visible_only = visible_only,
+            .filter = filter
+        };
+
+        xcb_window_t* windows;
+        xcb_window_t* tops;
+        xcb_rectangle_t* rects;
+        double start = now();
+        int status = discovery_find_windows(&discovery, &windows, &tops,
+                                            &rects, NULL, &found_size);
+        elapsed += now() - start;
+        if (status != 0) {
+            problem = discovery.error;
+            break;
+        }
+        free(windows);
+        free(tops);
+        free(rects);
+        runs += 1;
+    } while (elapsed < MIN_TIME);
+
+    if (problem == NULL) {
+        for (int i = 0; i < fake.requests_size; i++) {
+            if (!fake.requests[i].replied) problem = "reply not waited for";
+        }
+    }
+    if (problem == NULL && (
+        visible_only ? found_size > expected_size : found_size != expected_size
+    )) {
+        problem = "wrong number of windows found";
+    }
+
+    if (problem == NULL) {
+        printf("%7d %6s %8.1f %7s %6s %7d %8d %6d %10.2f %11.1f  ok\n",
+               windows_size, LAYOUTS[layout], latency * 1e3,
+               visible_only ? "yes" : "no",
+               filter_index == -1 ? "no" : FILTER_NAMES[filter_index],
+               found_size, fake.requests_size,
+               fake.round_trips, fake.clock * 1e3, elapsed / runs * 1e6);
+    } else {
+        printf("%7d %6s %8.1f %7s %6s  error: %s\n",
+               windows_size, LAYOUTS[layout], latency * 1e3,
+               visible_only ? "yes" : "no",
+               filter_index == -1 ? "no" : FILTER_NAMES[filter_index], problem);
+    }
+    x_fake_free(&fake);
+    return problem == NULL ? 0 : 1;
+}
+
+
+int main () {
+    int failures = 0;
+    filter_t filters[FILTERS_SIZE];
+    for (int f = 0; f < FILTERS_SIZE; f++) {
+        filter_t empty = { 0 };
+        char* error;
+        int error_position;
+        filters[f] = empty;
+        if (filter_compile(FILTERS[f], &(filters[f]), &error,
+                           &error_position) != 0) {
+            printf("error: filter: %s at '%s'\n", error,
+                   FILTERS[f] + error_position);
+            return 1;
+        }
+        filters[f].state_atoms[FILTER_STATE_HIDDEN] = ATOM_STATE_HIDDEN;
+        filters[f].type_atoms[FILTER_TYPE_NORMAL] = ATOM_TYPE_NORMAL;
+        filters[f].type_atoms[FILTER_TYPE_DOCK] = ATOM_TYPE_DOCK;
+    }
+
+    printf("%7s %6s %8s %7s %6s %7s %8s %6s %10s %11s  %s\n", "windows",
+           "layout", "rtt (ms)", "visible", "filter", "found", "requests",
+           "trips", "total (ms)", "time (us)", "check");
+    for (int w = 0; w < WINDOWS_SIZES_SIZE; w++) {
+        for (int l = 0; l < LAYOUTS_SIZE; l++) {
+            for (int t = 0; t < LATENCIES_SIZE; t++) {
+                for (int v = 0; v <= 1; v++) {
+                    failures += bench_case(WINDOWS_SIZES[w], l, LATENCIES[t],
+                                           v, -1, NULL);
+                    for (int f = 0; f < FILTERS_SIZE; f++) {
+                        failures += bench_case(WINDOWS_SIZES[w], l,
+                                               LATENCIES[t], v, f,
+                                               &(filters[f]));
+                    }
+                }
+            }
+        }
+    }
+    for (int f = 0; f < FILTERS_SIZE; f++) filter_free(&(filters[f]));
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,1017 @@
+/*
+
+Licensed under the Apache License, Version 2.0 (the "License"); you may not use
+this file except in compliance with the License. You may obtain a copy of the
+License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software distributed
+under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+CONDITIONS OF ANY KIND, either express or implied. See the License for the
+specific language governing permissions and limitations under the License.
+
+*/
+
+#include <time.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include "x-backend-fake.h"
+#include "discovery-trace.h"
+
+
+/*
+
+Trace files start with TRACE_MAGIC and a version byte, followed by records.
+Each record is a byte giving its kind, followed by fields; integers are
+unsigned and little-endian, times are 32-bit microseconds since recording
+started, and strings are a 16-bit length followed by that many bytes.
+
+TRACE_SETTINGS: root window (32); atoms for _NET_CLIENT_LIST, WM_STATE,
+    _NET_WM_WINDOW_TYPE, _NET_WM_DESKTOP, _NET_CURRENT_DESKTOP, _NET_WM_STATE,
+    _NET_WM_NAME and UTF8_STRING (32 each); maximum number of windows (32);
+    whether only visible windows are included (8); number of normal window
+    types (16) and the types (32 each); number of whitelisted windows (32) and
+    the windows (32 each); the same for blacklisted windows; number of filter
+    sources (16) and the sources (strings), followed by the filter's state atoms
+    and type atoms (32 each) if there are any; the characters labels are made
+    of (string)
+TRACE_REQUEST: kind (8); index in the order requests were sent (32); window,
+    other, type and length arguments (32 each); time sent (32); time the reply
+    was read (32); whether it succeeded (8); then if it did, the reply:
+    - X_FAKE_QUERY_TREE: number of children (32) and children (32 each)
+    - X_FAKE_GET_PROPERTY: type (32), value length in bytes (32) and value
+    - X_FAKE_GET_WINDOW_ATTRIBUTES: viewable (8), override-redirect (8)
+    - X_FAKE_GET_GEOMETRY: x, y, width, height and border width (16 each; x
+      and y are two's complement)
+    - X_FAKE_TRANSLATE_COORDINATES: x and y (32 each, two's complement)
+TRACE_LABELS: number of windows (32), then for each, the window (32) and its
+    label (string)
+TRACE_KEY: time (32), character (8)
+TRACE_END: time (32), result (8, two's complement), chosen window (32)
+
+Requests are recorded when their replies are read, so they aren't in the
+order they were sent.  A trace without TRACE_END was cut short.
+
+*/
+
+
+// -- constants
+
+/**
+ * Start of every trace file.
+ */
+char* TRACE_MAGIC = "XCWT";
+/**
+ * Version of the format written; traces of other versions can't be read.
+ */
+int TRACE_VERSION = 1;
+/**
+ * Kinds of record.
+ */
+#define TRACE_SETTINGS 'S'
+#define TRACE_REQUEST 'R'
+#define TRACE_LABELS 'L'
+#define TRACE_KEY 'K'
+#define TRACE_END 'E'
+
+
+// -- types
+
+/**
+ * A trace file being read.
+ *
+ * data: the whole file
+ * position: offset of the next byte to read
+ * truncated: whether reading went past the end; reads then return zeros
+ */
+typedef struct _trace_reader_t {
+    unsigned char* data;
+    size_t size;
+    size_t position;
+    int truncated;
+} _trace_reader_t;
+
+
+// -- utilities
+
+/**
+ * Get the current time in seconds.
+ */
+double _trace_now () {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+/**
+ * Write bytes to a trace file, unless writing already failed.
+ */
+void _trace_put (trace_recorder_t* recorder, void* data, size_t size) {
+    if (recorder->failed) return;
+    if (fwrite(data, 1, size, recorder->file) != size) recorder->failed = 1;
+}
+
+
+void _trace_put_u8 (trace_recorder_t* recorder, uint32_t value) {
+    unsigned char byte = value;
+    _trace_put(recorder, &byte, 1);
+}
+
+
+void _trace_put_u16 (trace_recorder_t* recorder, uint32_t value) {
+    unsigned char bytes[] = { value, value >> 8 };
+    _trace_put(recorder, bytes, sizeof(bytes));
+}
+
+
+void _trace_put_u32 (trace_recorder_t* recorder, uint32_t value) {
+    unsigned char bytes[] = { value, value >> 8, value >> 16, value >> 24 };
+    _trace_put(recorder, bytes, sizeof(bytes));
+}
+
+
+/**
+ * Write a time, in seconds since recording started.
+ */
+void _trace_put_time (trace_recorder_t* recorder, double time) {
+    _trace_put_u32(recorder, (uint32_t)((time - recorder->started) * 1e6));
+}
+
+
+/**
+ * Write a string, truncated to fit its length.
+ */
+void _trace_put_string (trace_recorder_t* recorder, char* string) {
+    size_t size = strlen(string);
+    if (size > 0xffff) size = 0xffff;
+    _trace_put_u16(recorder, size);
+    _trace_put(recorder, string, size);
+}
+
+
+/**
+ * Read bytes from a trace file.
+ *
+ * returns: the bytes, or NULL if there aren't enough
+ */
+unsigned char* _trace_get (_trace_reader_t* reader, size_t size) {
+    if (reader->size - reader->position < size) {
+        reader->truncated = 1;
+        reader->position = reader->size;
+        return NULL;
+    }
+    unsigned char* data = reader->data + reader->position;
+    reader->position += size;
+    return data;
+}
+
+
+uint32_t _trace_get_u8 (_trace_reader_t* reader) {
+    unsigned char* b = _trace_get(reader, 1);
+    return b == NULL ? 0 : b[0];
+}
+
+
+uint32_t _trace_get_u16 (_trace_reader_t* reader) {
+    unsigned char* b = _trace_get(reader, 2);
+    return b == NULL ? 0 : b[0] | b[1] << 8;
+}
+
+
+uint32_t _trace_get_u32 (_trace_reader_t* reader) {
+    unsigned char* b = _trace_get(reader, 4);
+    if (b == NULL) return 0;
+    return b[0] | b[1] << 8 | b[2] << 16 | (uint32_t)b[3] << 24;
+}
+
+
+/**
+ * Read a number of items that follow.  Since a corrupt file could give any
+ * number, it's limited to the number that could fit in what's left.
+ *
+ * item_size: the least number of bytes each item takes
+ */
+int _trace_get_count (_trace_reader_t* reader, int item_size) {
+    uint32_t count = _trace_get_u32(reader);
+    size_t left = (reader->size - reader->position) / item_size;
+    return count < left ? (int)count : (int)left;
+}
+
+
+double _trace_get_time (_trace_reader_t* reader) {
+    return _trace_get_u32(reader) / 1e6;
+}
+
+
+/**
+ * Read a string.
+ *
+ * returns: a null-terminated copy, which should be freed
+ */
+char* _trace_get_string (_trace_reader_t* reader) {
+    int size = _trace_get_u16(reader);
+    unsigned char* data = _trace_get(reader, size);
+    char* string = calloc(size + 1, 1);
+    if (data != NULL) memcpy(string, data, size);
+    return string;
+}
+
+
+/**
+ * Read a list of windows or atoms.
+ *
+ * size: number of items
+ *
+ * returns: the items, which should be freed
+ */
+uint32_t* _trace_get_u32s (_trace_reader_t* reader, int size) {
+    uint32_t* items = calloc(size > 0 ? size : 1, sizeof(uint32_t));
+    for (int i = 0; i < size; i++) items[i] = _trace_get_u32(reader);
+    return items;
+}
+
+
+// -- recording
+
+/**
+ * Remember a request sent through the recorder.
+ *
+ * request: the inner backend's ID for it
+ *
+ * returns: the recorder's ID for it, or 0 if memory can't be allocated
+ */
+unsigned int _trace_recorder_send (trace_recorder_t* recorder,
+                                   unsigned int request, int kind,
+                                   xcb_window_t window, uint32_t other,
+                                   xcb_atom_t type, uint32_t length) {
+    if (recorder->pending_size == recorder->pending_capacity) {
+        int capacity = recorder->pending_capacity == 0 ?
+            64 : 2 * recorder->pending_capacity;
+        trace_request_t* pending = realloc(
+            recorder->pending, capacity * sizeof(trace_request_t));
+        if (pending == NULL) return 0;
+        recorder->pending = pending;
+        unsigned int* inner_requests = realloc(
+            recorder->inner_requests, capacity * sizeof(unsigned int));
+        if (inner_requests == NULL) return 0;
+        recorder->inner_requests = inner_requests;
+        recorder->pending_capacity = capacity;
+    }
+
+    trace_request_t* pending = &(recorder->pending[recorder->pending_size]);
+    memset(pending, 0, sizeof(trace_request_t));
+    pending->kind = kind;
+    pending->window = window;
+    pending->other = other;
+    pending->type = type;
+    pending->length = length;
+    pending->index = recorder->pending_size;
+    pending->sent = _trace_now();
+    recorder->inner_requests[recorder->pending_size] = request;
+    recorder->pending_size += 1;
+    return recorder->pending_size;
+}
+
+
+/**
+ * Get a request sent through the recorder, to pass on waiting for its reply.
+ *
+ * returns: the request, or NULL if the ID is unknown
+ */
+trace_request_t* _trace_recorder_pending (trace_recorder_t* recorder,
+                                          unsigned int id) {
+    if (id < 1 || id > (unsigned int)recorder->pending_size) return NULL;
+    return &(recorder->pending[id - 1]);
+}
+
+
+/**
+ * Write a request whose reply has been read, up to the reply itself.
+ *
+ * status: result of waiting for the reply
+ */
+void _trace_recorder_reply (trace_recorder_t* recorder,
+                            trace_request_t* request, int status) {
+    _trace_put_u8(recorder, TRACE_REQUEST);
+    _trace_put_u8(recorder, request->kind);
+    _trace_put_u32(recorder, request->index);
+    _trace_put_u32(recorder, request->window);
+    _trace_put_u32(recorder, request->other);
+    _trace_put_u32(recorder, request->type);
+    _trace_put_u32(recorder, request->length);
+    _trace_put_time(recorder, request->sent);
+    _trace_put_time(recorder, _trace_now());
+    _trace_put_u8(recorder, status == 0);
+}
+
+
+unsigned int _trace_query_tree (void* data, xcb_window_t window) {
+    trace_recorder_t* recorder = (trace_recorder_t*)data;
+    return _trace_recorder_send(
+        recorder, recorder->inner.query_tree(recorder->inner.data, window),
+        X_FAKE_QUERY_TREE, window, 0, 0, 0);
+}
+
+
+int _trace_query_tree_reply (void* data, unsigned int request,
+                             xcb_window_t** children, int* children_size) {
+    trace_recorder_t* recorder = (trace_recorder_t*)data;
+    trace_request_t* r = _trace_recorder_pending(recorder, request);
+    if (r == NULL) return -1;
+    int status = recorder->inner.query_tree_reply(
+        recorder->inner.data, recorder->inner_requests[request - 1],
+        children, children_size);
+    _trace_recorder_reply(recorder, r, status);
+    if (status == 0) {
+        _trace_put_u32(recorder, *children_size);
+        for (int i = 0; i < *children_size; i++) {
+            _trace_put_u32(recorder, (*children)[i]);
+        }
+    }
+    return status;
+}
+
+
+unsigned int _trace_get_property (void* data, xcb_window_t window,
+                                  xcb_atom_t property, xcb_atom_t type,
+                                  uint32_t length) {
+    trace_recorder_t* recorder = (trace_recorder_t*)data;
+    return _trace_recorder_send(
+        recorder, recorder->inner.get_property(
+            recorder->inner.data, window, property, type, length),
+        X_FAKE_GET_PROPERTY, window, property, type, length);
+}
+
+
+int _trace_get_property_reply (void* data, unsigned int request,
+                               xcb_atom_t* type,
+                               void** value, int* value_length) {
+    trace_recorder_t* recorder = (trace_recorder_t*)data;
+    trace_request_t* r = _trace_recorder_pending(recorder, request);
+    if (r == NULL) return -1;
+    int status = recorder->inner.get_property_reply(
+        recorder->inner.data, recorder->inner_requests[request - 1],
+        type, value, value_length);
+    _trace_recorder_reply(recorder, r, status);
+    if (status == 0) {
+        _trace_put_u32(recorder, *type);
+        _trace_put_u32(recorder, *value_length);
+        _trace_put(recorder, *value, *value_length);
+    }
+    return status;
+}
+
+
+unsigned int _trace_get_window_attributes (void* data, xcb_window_t window) {
+    trace_recorder_t* recorder = (trace_recorder_t*)data;
+    return _trace_recorder_send(
+        recorder, recorder->inner.get_window_attributes(
+            recorder->inner.data, window),
+        X_FAKE_GET_WINDOW_ATTRIBUTES, window, 0, 0, 0);
+}
+
+
+int _trace_get_window_attributes_reply (void* data, unsigned int request,
+                                        int* viewable,
+                                        int* override_redirect) {
+    trace_recorder_t* recorder = (trace_recorder_t*)data;
+    trace_request_t* r = _trace_recorder_pending(recorder, request);
+    if (r == NULL) return -1;
+    int status = recorder->inner.get_window_attributes_reply(
+        recorder->inner.data, recorder->inner_requests[request - 1],
+        viewable, override_redirect);
+    _trace_recorder_reply(recorder, r, status);
+    if (status == 0) {
+        _trace_put_u8(recorder, *viewable != 0);
+        _trace_put_u8(recorder, *override_redirect != 0);
+    }
+    return status;
+}
+
+
+unsigned int _trace_get_geometry (void* data, xcb_window_t window) {
+    trace_recorder_t* recorder = (trace_recorder_t*)data;
+    return _trace_recorder_send(
+        recorder, recorder->inner.get_geometry(recorder->inner.data, window),
+        X_FAKE_GET_GEOMETRY, window, 0, 0, 0);
+}
+
+
+int _trace_get_geometry_reply (void* data, unsigned int request,
+                               xcb_rectangle_t* rect, int* border_width) {
+    trace_recorder_t* recorder = (trace_recorder_t*)data;
+    trace_request_t* r = _trace_recorder_pending(recorder, request);
+    if (r == NULL) return -1;
+    int status = recorder->inner.get_geometry_reply(
+        recorder->inner.data, recorder->inner_requests[request - 1],
+        rect, border_width);
+    _trace_recorder_reply(recorder, r, status);
+    if (status == 0) {
+        _trace_put_u16(recorder, (uint16_t)rect->x);
+        _trace_put_u16(recorder, (uint16_t)rect->y);
+        _trace_put_u16(recorder, rect->width);
+        _trace_put_u16(recorder, rect->height);
+        _trace_put_u16(recorder, *border_width);
+    }
+    return status;
+}
+
+
+unsigned int _trace_translate_coordinates (void* data, xcb_window_t window,
+                                           xcb_window_t relative_to) {
+    trace_recorder_t* recorder = (trace_recorder_t*)data;
+    return _trace_recorder_send(
+        recorder, recorder->inner.translate_coordinates(
+            recorder->inner.data, window, relative_to),
+        X_FAKE_TRANSLATE_COORDINATES, window, relative_to, 0, 0);
+}
+
+
+int _trace_translate_coordinates_reply (void* data, unsigned int request,
+                                        int* x, int* y) {
+    trace_recorder_t* recorder = (trace_recorder_t*)data;
+    trace_request_t* r = _trace_recorder_pending(recorder, request);
+    if (r == NULL) return -1;
+    int status = recorder->inner.translate_coordinates_reply(
+        recorder->inner.data, recorder->inner_requests[request - 1], x, y);
+    _trace_recorder_reply(recorder, r, status);
+    if (status == 0) {
+        _trace_put_u32(recorder, (uint32_t)*x);
+        _trace_put_u32(recorder, (uint32_t)*y);
+    }
+    return status;
+}
+
+
+// -- reading
+
+/**
+ * Read a TRACE_SETTINGS record.
+ *
+ * returns: 0 on success, -1 if a filter source is invalid
+ */
+int _trace_read_settings (_trace_reader_t* reader, trace_t* trace) {
+    discovery_t* discovery = &(trace->discovery);
+    free(discovery->normal_types);
+    free(discovery->whitelist);
+    free(discovery->blacklist);
+    free(trace->characters);
+    if (trace->has_filter) filter_free(&(trace->filter));
+    trace->has_filter = 0;
+
+    discovery->root = _trace_get_u32(reader);
+    discovery->client_list = _trace_get_u32(reader);
+    discovery->wm_state = _trace_get_u32(reader);
+    discovery->window_type = _trace_get_u32(reader);
+    discovery->desktop = _trace_get_u32(reader);
+    discovery->current_desktop = _trace_get_u32(reader);
+    discovery->state = _trace_get_u32(reader);
+    discovery->name = _trace_get_u32(reader);
+    discovery->utf8_string = _trace_get_u32(reader);
+    discovery->max_windows = _trace_get_u32(reader);
+    discovery->visible_only = _trace_get_u8(reader);
+    discovery->normal_types_size = _trace_get_u16(reader);
+    discovery->normal_types = _trace_get_u32s(
+        reader, discovery->normal_types_size);
+    discovery->whitelist_size = _trace_get_count(reader, 4);
+    discovery->whitelist = _trace_get_u32s(reader, discovery->whitelist_size);
+    discovery->blacklist_size = _trace_get_count(reader, 4);
+    discovery->blacklist = _trace_get_u32s(reader, discovery->blacklist_size);
+
+    int sources_size = _trace_get_u16(reader);
+    int status = 0;
+    for (int i = 0; i < sources_size; i++) {
+        char* source = _trace_get_string(reader);
+        char* error;
+        int error_position;
+        if (!trace->has_filter) memset(&(trace->filter), 0, sizeof(filter_t));
+        if (status == 0 && filter_compile(source, &(trace->filter),
+                                          &error, &error_position) != 0) {
+            status = -1;
+        }
+        trace->has_filter = 1;
+        free(source);
+    }
+    if (sources_size > 0) {
+        for (int i = 0; i < FILTER_STATES_SIZE; i++) {
+            trace->filter.state_atoms[i] = _trace_get_u32(reader);
+        }
+        for (int i = 0; i < FILTER_TYPES_SIZE; i++) {
+            trace->filter.type_atoms[i] = _trace_get_u32(reader);
+        }
+    }
+    trace->characters = _trace_get_string(reader);
+    return status;
+}
+
+
+/**
+ * Read a TRACE_REQUEST record.
+ *
+ * returns: 0 on success, -1 if the request is invalid
+ */
+int _trace_read_request (_trace_reader_t* reader, trace_request_t* request) {
+    memset(request, 0, sizeof(trace_request_t));
+    request->kind = _trace_get_u8(reader);
+    request->index = _trace_get_u32(reader);
+    request->window = _trace_get_u32(reader);
+    request->other = _trace_get_u32(reader);
+    request->type = _trace_get_u32(reader);
+    request->length = _trace_get_u32(reader);
+    request->sent = _trace_get_time(reader);
+    request->replied = _trace_get_time(reader);
+    request->ok = _trace_get_u8(reader);
+    if (!request->ok) return 0;
+
+    if (request->kind == X_FAKE_QUERY_TREE) {
+        request->children_size = _trace_get_count(reader, 4);
+        request->children = _trace_get_u32s(reader, request->children_size);
+    } else if (request->kind == X_FAKE_GET_PROPERTY) {
+        request->value_type = _trace_get_u32(reader);
+        int length = _trace_get_count(reader, 1);
+        unsigned char* value = _trace_get(reader, length);
+        request->value = calloc(length + 1, 1);
+        if (value != NULL) memcpy(request->value, value, length);
+        request->value_length = length;
+    } else if (request->kind == X_FAKE_GET_WINDOW_ATTRIBUTES) {
+        request->viewable = _trace_get_u8(reader);
+        request->override_redirect = _trace_get_u8(reader);
+    } else if (request->kind == X_FAKE_GET_GEOMETRY) {
+        request->rect.x = (int16_t)_trace_get_u16(reader);
+        request->rect.y = (int16_t)_trace_get_u16(reader);
+        request->rect.width = _trace_get_u16(reader);
+        request->rect.height = _trace_get_u16(reader);
+        request->border_width = _trace_get_u16(reader);
+    } else if (request->kind == X_FAKE_TRANSLATE_COORDINATES) {
+        request->x = (int32_t)_trace_get_u32(reader);
+        request->y = (int32_t)_trace_get_u32(reader);
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+
+/**
+ * Compare requests by the order they were sent, for use with `qsort`.
+ */
+int _trace_compare_requests (const void* a, const void* b) {
+    const trace_request_t* ra = a;
+    const trace_request_t* rb = b;
+    return ra->index - rb->index;
+}
+
+
+// -- replaying
+
+/**
+ * Find the recorded request matching a request sent during a replay.  Requests
+ * are usually sent in the same order as when recorded, so the next one is
+ * tried first.
+ *
+ * returns: the recorded request, or NULL if there's none that hasn't been
+ *     answered
+ */
+trace_request_t* _trace_replay_find (trace_replay_t* replay, int kind,
+                                     xcb_window_t window, uint32_t other,
+                                     xcb_atom_t type, uint32_t length) {
+    trace_t* trace = replay->trace;
+    for (int n = 0; n < trace->requests_size; n++) {
+        int i = (replay->next + n) % trace->requests_size;
+        trace_request_t* r = &(trace->requests[i]);
+        if (!r->replayed && r->kind == kind && r->window == window &&
+            r->other == other && r->type == type && r->length == length) {
+            r->replayed = 1;
+            replay->next = i + 1;
+            return r;
+        }
+    }
+    return NULL;
+}
+
+
+/**
+ * Record a request sent during a replay.
+ *
+ * returns: the request's ID, or 0 if memory can't be allocated
+ */
+unsigned int _trace_replay_send (trace_replay_t* replay, int kind,
+                                 xcb_window_t window, uint32_t other,
+                                 xcb_atom_t type, uint32_t length) {
+    if (replay->pending_size == replay->pending_capacity) {
+        int capacity = replay->pending_capacity == 0 ?
+            64 : 2 * replay->pending_capacity;
+        trace_request_t** pending = realloc(
+            replay->pending, capacity * sizeof(trace_request_t*));
+        if (pending == NULL) return 0;
+        replay->pending = pending;
+        double* pending_sent = realloc(replay->pending_sent,
+                                       capacity * sizeof(double));
+        if (pending_sent == NULL) return 0;
+        replay->pending_sent = pending_sent;
+        replay->pending_capacity = capacity;
+    }
+
+    trace_request_t* r = _trace_replay_find(replay, kind, window, other,
+                                            type, length);
+    if (r == NULL) replay->unrecorded += 1;
+    replay->pending[replay->pending_size] = r;
+    replay->pending_sent[replay->pending_size] = replay->clock;
+    replay->pending_size += 1;
+    return replay->pending_size;
+}
+
+
+/**
+ * Wait for the reply to a request sent during a replay.
+ *
+ * returns: the recorded request, or NULL if the request fails
+ */
+trace_request_t* _trace_replay_wait (trace_replay_t* replay, unsigned int id,
+                                     int kind) {
+    if (id < 1 || id > (unsigned int)replay->pending_size) return NULL;
+    trace_request_t* r = replay->pending[id - 1];
+    double sent = replay->pending_sent[id - 1];
+    replay->pending[id - 1] = NULL;
+    // a request that wasn't recorded fails straight away
+    if (r == NULL || r->kind != kind) return NULL;
+
+    double reply_time = sent + (r->replied - r->sent);
+    if (reply_time > replay->clock) {
+        // as with the fake server, replies to requests sent before the last
+        // round trip ended were already partly waited for
+        if (sent >= replay->wait_time) replay->round_trips += 1;
+        replay->clock = reply_time;
+        replay->wait_time = replay->clock;
+    }
+    return r->ok ? r : NULL;
+}
+
+
+unsigned int _trace_replay_query_tree (void* data, xcb_window_t window) {
+    return _trace_replay_send((trace_replay_t*)data, X_FAKE_QUERY_TREE,
+                              window, 0, 0, 0);
+}
+
+
+int _trace_replay_query_tree_reply (void* data, unsigned int request,
+                                    xcb_window_t** children,
+                                    int* children_size) {
+    trace_request_t* r = _trace_replay_wait((trace_replay_t*)data, request,
+                                            X_FAKE_QUERY_TREE);
+    if (r == NULL) return -1;
+    *children = calloc(r->children_size > 0 ? r->children_size : 1,
+                       sizeof(xcb_window_t));
+    memcpy(*children, r->children, r->children_size * sizeof(xcb_window_t));
+    *children_size = r->children_size;
+    return 0;
+}
+
+
+unsigned int _trace_replay_get_property (void* data, xcb_window_t window,
+                                         xcb_atom_t property, xcb_atom_t type,
+                                         uint32_t length) {
+    return _trace_replay_send((trace_replay_t*)data, X_FAKE_GET_PROPERTY,
+                              window, property, type, length);
+}
+
+
+int _trace_replay_get_property_reply (void* data, unsigned int request,
+                                      xcb_atom_t* type,
+                                      void** value, int* value_length) {
+    trace_request_t* r = _trace_replay_wait((trace_replay_t*)data, request,
+                                            X_FAKE_GET_PROPERTY);
+    if (r == NULL) return -1;
+    *type = r->value_type;
+    *value = calloc(r->value_length + 1, 1);
+    memcpy(*value, r->value, r->value_length);
+    *value_length = r->value_length;
+    return 0;
+}
+
+
+unsigned int _trace_replay_get_window_attributes (void* data,
+                                                  xcb_window_t window) {
+    return _trace_replay_send((trace_replay_t*)data,
+                              X_FAKE_GET_WINDOW_ATTRIBUTES, window, 0, 0, 0);
+}
+
+
+int _trace_replay_get_window_attributes_reply (void* data,
+                                               unsigned int request,
+                                               int* viewable,
+                                               int* override_redirect) {
+    trace_request_t* r = _trace_replay_wait((trace_replay_t*)data, request,
+                                            X_FAKE_GET_WINDOW_ATTRIBUTES);
+    if (r == NULL) return -1;
+    *viewable = r->viewable;
+    *override_redirect = r->override_redirect;
+    return 0;
+}
+
+
+unsigned int _trace_replay_get_geometry (void* data, xcb_window_t window) {
+    return _trace_replay_send((trace_replay_t*)data, X_FAKE_GET_GEOMETRY,
+                              window, 0, 0, 0);
+}
+
+
+int _trace_replay_get_geometry_reply (void* data, unsigned int request,
+                                      xcb_rectangle_t* rect,
+                                      int* border_width) {
+    trace_request_t* r = _trace_replay_wait((trace_replay_t*)data, request,
+                                            X_FAKE_GET_GEOMETRY);
+    if (r == NULL) return -1;
+    *rect = r->rect;
+    *border_width = r->border_width;
+    return 0;
+}
+
+
+unsigned int _trace_replay_translate_coordinates (void* data,
+                                                  xcb_window_t window,
+                                                  xcb_window_t relative_to) {
+    return _trace_replay_send((trace_replay_t*)data,
+                              X_FAKE_TRANSLATE_COORDINATES, window,
+                              relative_to, 0, 0);
+}
+
+
+int _trace_replay_translate_coordinates_reply (void* data,
+                                               unsigned int request,
+                                               int* x, int* y) {
+    trace_request_t* r = _trace_replay_wait((trace_replay_t*)data, request,
+                                            X_FAKE_TRANSLATE_COORDINATES);
+    if (r == NULL) return -1;
+    *x = r->x;
+    *y = r->y;
+    return 0;
+}
+
+
+// -- public functions
+
+int trace_recorder_open (char* path, x_backend_t* inner,
+                         trace_recorder_t* recorder) {
+    memset(recorder, 0, sizeof(trace_recorder_t));
+    recorder->file = fopen(path, "wb");
+    if (recorder->file == NULL) return -1;
+    recorder->inner = *inner;
+    recorder->started = _trace_now();
+    _trace_put(recorder, TRACE_MAGIC, strlen(TRACE_MAGIC));
+    _trace_put_u8(recorder, TRACE_VERSION);
+    return 0;
+}
+
+
+void trace_recorder_backend (trace_recorder_t* recorder,
+                             x_backend_t* backend) {
+    backend->data = recorder;
+    backend->query_tree = _trace_query_tree;
+    backend->query_tree_reply = _trace_query_tree_reply;
+    backend->get_property = _trace_get_property;
+    backend->get_property_reply = _trace_get_property_reply;
+    backend->get_window_attributes = _trace_get_window_attributes;
+    backend->get_window_attributes_reply = _trace_get_window_attributes_reply;
+    backend->get_geometry = _trace_get_geometry;
+    backend->get_geometry_reply = _trace_get_geometry_reply;
+    backend->translate_coordinates = _trace_translate_coordinates;
+    backend->translate_coordinates_reply = _trace_translate_coordinates_reply;
+}
+
+
+void trace_recorder_settings (trace_recorder_t* recorder,
+                              discovery_t* discovery,
+                              char** filter_sources, int filter_sources_size,
+                              char* characters) {
+    _trace_put_u8(recorder, TRACE_SETTINGS);
+    xcb_atom_t atoms[] = {
+        discovery->root, discovery->client_list, discovery->wm_state,
+        discovery->window_type, discovery->desktop,
+        discovery->current_desktop, discovery->state, discovery->name,
+        discovery->utf8_string, discovery->max_windows
+    };
+    for (size_t i = 0; i < sizeof(atoms) / sizeof(*atoms); i++) {
+        _trace_put_u32(recorder, atoms[i]);
+    }
+    _trace_put_u8(recorder, discovery->visible_only != 0);
+    _trace_put_u16(recorder, discovery->normal_types_size);
+    for (int i = 0; i < discovery->normal_types_size; i++) {
+        _trace_put_u32(recorder, discovery->normal_types[i]);
+    }
+    _trace_put_u32(recorder, discovery->whitelist_size);
+    for (int i = 0; i < discovery->whitelist_size; i++) {
+        _trace_put_u32(recorder, discovery->whitelist[i]);
+    }
+    _trace_put_u32(recorder, discovery->blacklist_size);
+    for (int i = 0; i < discovery->blacklist_size; i++) {
+        _trace_put_u32(recorder, discovery->blacklist[i]);
+    }
+
+    _trace_put_u16(recorder, filter_sources_size);
+    for (int i = 0; i < filter_sources_size; i++) {
+        _trace_put_string(recorder, filter_sources[i]);
+    }
+    if (filter_sources_size > 0) {
+        for (int i = 0; i < FILTER_STATES_SIZE; i++) {
+            _trace_put_u32(recorder, discovery->filter->state_atoms[i]);
+        }
+        for (int i = 0; i < FILTER_TYPES_SIZE; i++) {
+            _trace_put_u32(recorder, discovery->filter->type_atoms[i]);
+        }
+    }
+    _trace_put_string(recorder, characters);
+}
+
+
+void trace_recorder_labels (trace_recorder_t* recorder,
+                            xcb_window_t* windows, char** labels,
+                            int windows_size) {
+    _trace_put_u8(recorder, TRACE_LABELS);
+    _trace_put_u32(recorder, windows_size);
+    for (int i = 0; i < windows_size; i++) {
+        _trace_put_u32(recorder, windows[i]);
+        _trace_put_string(recorder, labels == NULL ? "" : labels[i]);
+    }
+}
+
+
+void trace_recorder_key (trace_recorder_t* recorder, char character) {
+    _trace_put_u8(recorder, TRACE_KEY);
+    _trace_put_time(recorder, _trace_now());
+    _trace_put_u8(recorder, (unsigned char)character);
+}
+
+
+int trace_recorder_close (trace_recorder_t* recorder, int status,
+                          xcb_window_t chosen) {
+    _trace_put_u8(recorder, TRACE_END);
+    _trace_put_time(recorder, _trace_now());
+    _trace_put_u8(recorder, (uint8_t)status);
+    _trace_put_u32(recorder, chosen);
+    int failed = recorder->failed;
+    int close_status = fclose(recorder->file);
+    int err = errno;
+    free(recorder->pending);
+    free(recorder->inner_requests);
+    memset(recorder, 0, sizeof(trace_recorder_t));
+    errno = failed ? EIO : err;
+    return failed || close_status != 0 ? -1 : 0;
+}
+
+
+int trace_read (char* path, trace_t* trace, char** error) {
+    memset(trace, 0, sizeof(trace_t));
+    trace->status = -1;
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        *error = strerror(errno);
+        return -1;
+    }
+    _trace_reader_t reader = { NULL, 0, 0, 0 };
+    size_t capacity = 0;
+    while (!feof(file) && !ferror(file)) {
+        if (reader.size == capacity) {
+            capacity = capacity == 0 ? 65536 : 2 * capacity;
+            reader.data = realloc(reader.data, capacity);
+        }
+        reader.size += fread(reader.data + reader.size, 1,
+                             capacity - reader.size, file);
+    }
+    int read_error = ferror(file);
+    fclose(file);
+    if (read_error) {
+        free(reader.data);
+        *error = "can't read the file";
+        return -1;
+    }
+
+    unsigned char* magic = _trace_get(&reader, strlen(TRACE_MAGIC));
+    if (magic == NULL || memcmp(magic, TRACE_MAGIC, strlen(TRACE_MAGIC)) != 0 ||
+        _trace_get_u8(&reader) != (uint32_t)TRACE_VERSION) {
+        free(reader.data);
+        *error = "not a trace, or from another version";
+        return -1;
+    }
+
+    int requests_capacity = 0;
+    *error = NULL;
+    while (reader.position < reader.size && *error == NULL) {
+        int kind = _trace_get_u8(&reader);
+        if (kind == TRACE_SETTINGS) {
+            if (_trace_read_settings(&reader, trace) != 0) {
+                *error = "invalid filter";
+            }
+        } else if (kind == TRACE_REQUEST) {
+            if (trace->requests_size == requests_capacity) {
+                requests_capacity = requests_capacity == 0 ?
+                    64 : 2 * requests_capacity;
+                trace->requests = realloc(
+                    trace->requests,
+                    requests_capacity * sizeof(trace_request_t));
+            }
+            trace_request_t* r = &(trace->requests[trace->requests_size]);
+            trace->requests_size += 1;
+            if (_trace_read_request(&reader, r) != 0) {
+                *error = "invalid request";
+            }
+        } else if (kind == TRACE_LABELS) {
+            int size = _trace_get_count(&reader, 6);
+            trace->labelled = realloc(trace->labelled,
+                                      (trace->labels_size + size + 1) *
+                                      sizeof(xcb_window_t));
+            trace->labels = realloc(trace->labels,
+                                    (trace->labels_size + size + 1) *
+                                    sizeof(char*));
+            for (int i = 0; i < size; i++) {
+                trace->labelled[trace->labels_size] = _trace_get_u32(&reader);
+                trace->labels[trace->labels_size] = _trace_get_string(&reader);
+                trace->labels_size += 1;
+            }
+        } else if (kind == TRACE_KEY) {
+            trace->keys = realloc(trace->keys, trace->keys_size + 1);
+            trace->key_times = realloc(trace->key_times,
+                                       (trace->keys_size + 1) *
+                                       sizeof(double));
+            trace->key_times[trace->keys_size] = _trace_get_time(&reader);
+            trace->keys[trace->keys_size] = _trace_get_u8(&reader);
+            trace->keys_size += 1;
+        } else if (kind == TRACE_END) {
+            trace->finished = _trace_get_time(&reader);
+            trace->status = (int8_t)_trace_get_u8(&reader);
+            trace->chosen = _trace_get_u32(&reader);
+        } else {
+            *error = "unknown record";
+        }
+        // a record cut short is dropped, along with any result
+        if (reader.truncated) {
+            if (kind == TRACE_REQUEST) {
+                trace->requests_size -= 1;
+                free(trace->requests[trace->requests_size].children);
+                free(trace->requests[trace->requests_size].value);
+            }
+            trace->status = -1;
+        }
+    }
+    free(reader.data);
+    if (*error != NULL) {
+        trace_free(trace);
+        return -1;
+    }
+    qsort(trace->requests, trace->requests_size, sizeof(trace_request_t),
+          _trace_compare_requests);
+    return 0;
+}
+
+
+void trace_free (trace_t* trace) {
+    free(trace->discovery.normal_types);
+    free(trace->discovery.whitelist);
+    free(trace->discovery.blacklist);
+    if (trace->has_filter) filter_free(&(trace->filter));
+    free(trace->characters);
+    for (int i = 0; i < trace->requests_size; i++) {
+        free(trace->requests[i].children);
+        free(trace->requests[i].value);
+    }
+    free(trace->requests);
+    for (int i = 0; i < trace->labels_size; i++) free(trace->labels[i]);
+    free(trace->labelled);
+    free(trace->labels);
+    free(trace->keys);
+    free(trace->key_times);
+    memset(trace, 0, sizeof(trace_t));
+}
+
+
+void trace_replay_backend (trace_t* trace, trace_replay_t* replay,
+                           x_backend_t* backend) {
+    memset(replay, 0, sizeof(trace_replay_t));
+    replay->trace = trace;
+    for (int i = 0; i < trace->requests_size; i++) {
+        trace->requests[i].replayed = 0;
+    }
+    backend->data = replay;
+    backend->query_tree = _trace_replay_query_tree;
+    backend->query_tree_reply = _trace_replay_query_tree_reply;
+    backend->get_property = _trace_replay_get_property;
+    backend->get_property_reply = _trace_replay_get_property_reply;
+    backend->get_window_attributes = _trace_replay_get_window_attributes;
+    backend->get_window_attributes_reply = (
+        _trace_replay_get_window_attributes_reply);
+    backend->get_geometry = _trace_replay_get_geometry;
+    backend->get_geometry_reply = _trace_replay_get_geometry_reply;
+    backend->translate_coordinates = _trace_replay_translate_coordinates;
+    backend->translate_coordinates_reply = (
+        _trace_replay_translate_coordinates_reply);
+}
+
+
+void trace_replay_free (trace_replay_t* replay) {
+    free(replay->pending);
+    free(replay->pending_sent);
+    memset(replay, 0, sizeof(trace_replay_t));
+}
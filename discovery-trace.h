@@ -0,0 +1,257 @@
+/*
+
+Licensed under the Apache License, Version 2.0 (the "License"); you may not use
+this file except in compliance with the License. You may obtain a copy of the
+License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software distributed
+under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+CONDITIONS OF ANY KIND, either express or implied. See the License for the
+specific language governing permissions and limitations under the License.
+
+*/
+
+#ifndef XCW_DISCOVERY_TRACE_H
+#define XCW_DISCOVERY_TRACE_H
+
+#include <stdio.h>
+#include "x-backend.h"
+#include "window-filter.h"
+#include "window-discovery.h"
+
+
+// -- types
+
+/**
+ * Records everything a run used to find and choose windows to a trace file, so
+ * that it can be replayed without the X server it ran against: the settings
+ * for finding windows, every request sent through a backend with its reply and
+ * timing, the labels given to the windows found, keys typed, and the result.
+ * The format is described in discovery-trace.c.
+ *
+ * file: the trace file
+ * inner: the backend requests are passed on to
+ * started: time the recorder was opened, which times in the trace are
+ *     relative to
+ * pending: for each request sent through the recorder, by ID minus 1, its
+ *     arguments and time sent
+ * inner_requests: for each of `pending`, its ID in `inner`
+ * failed: whether writing has failed; nothing more is written
+ */
+typedef struct trace_recorder_t {
+    FILE* file;
+    x_backend_t inner;
+    double started;
+    struct trace_request_t* pending;
+    unsigned int* inner_requests;
+    int pending_size;
+    int pending_capacity;
+    int failed;
+} trace_recorder_t;
+
+/**
+ * A request read from a trace.
+ *
+ * kind: the `x_backend_t` function that sent it, as an X_FAKE_* constant from
+ *     x-backend-fake.h
+ * window, other, type, length: arguments, as in `x_fake_request_t`
+ * index: position in the order requests were sent, from 0
+ * sent: time the request was sent, in seconds
+ * replied: time its reply was read, in seconds; since requests are sent in
+ *     batches, the reply may have arrived earlier
+ * ok: whether the request succeeded; the rest is only set if it did
+ * children: with X_FAKE_QUERY_TREE, the reply
+ * value_type, value, value_length: with X_FAKE_GET_PROPERTY, the reply;
+ *     `value` is followed by a null byte
+ * viewable, override_redirect: with X_FAKE_GET_WINDOW_ATTRIBUTES, the reply
+ * rect, border_width: with X_FAKE_GET_GEOMETRY, the reply
+ * x, y: with X_FAKE_TRANSLATE_COORDINATES, the reply
+ * replayed: whether the request has been answered by a replay
+ */
+typedef struct trace_request_t {
+    int kind;
+    xcb_window_t window;
+    uint32_t other;
+    xcb_atom_t type;
+    uint32_t length;
+    int index;
+    double sent;
+    double replied;
+    int ok;
+    xcb_window_t* children;
+    int children_size;
+    xcb_atom_t value_type;
+    void* value;
+    int value_length;
+    int viewable;
+    int override_redirect;
+    xcb_rectangle_t rect;
+    int border_width;
+    int x;
+    int y;
+    int replayed;
+} trace_request_t;
+
+/**
+ * A trace read back from a file.
+ *
+ * discovery: settings for finding windows as recorded; `backend`, `filter` and
+ *     the request state aren't set, and arrays should be freed with the trace
+ * filter: the filter, compiled from the recorded sources, with its atoms set;
+ *     only used if `has_filter`
+ * characters: characters labels were made of, null-terminated
+ * requests: recorded requests, in the order they were sent
+ * labelled: windows found, in the order they were labelled
+ * labels: for each of `labelled`, its label, null-terminated; empty when
+ *     windows were chosen by searching their names
+ * keys: characters typed, or '\b' for BackSpace, or '\0' for a key that types
+ *     nothing
+ * key_times: time each of `keys` was typed, in seconds
+ * status: result of the run, as in xcw.h, or -1 (XCW_ERROR) if the trace
+ *     ends early
+ * chosen: the window chosen, with XCW_CHOSEN
+ * finished: time the run finished, in seconds
+ */
+typedef struct trace_t {
+    discovery_t discovery;
+    filter_t filter;
+    int has_filter;
+    char* characters;
+    trace_request_t* requests;
+    int requests_size;
+    xcb_window_t* labelled;
+    char** labels;
+    int labels_size;
+    char* keys;
+    double* key_times;
+    int keys_size;
+    int status;
+    xcb_window_t chosen;
+    double finished;
+} trace_t;
+
+/**
+ * Replays a trace through a backend, answering each request with its recorded
+ * reply.  Time is virtual, as with `x_fake_t`: each reply arrives as long
+ * after its request is sent as it took to read when recorded, and waiting for
+ * a reply that hasn't arrived moves the clock forward to when it does.
+ * Requests that weren't recorded fail, as if their window had gone.
+ *
+ * trace: the trace, whose requests are marked as they're answered
+ * pending: for each request sent, by ID minus 1, the recorded request
+ *     answering it (or NULL) and the virtual time it was sent
+ * clock, round_trips, wait_time: as in `x_fake_t`
+ * next: index in `trace->requests` to look for the next request at first
+ * unrecorded: number of requests that weren't recorded
+ */
+typedef struct trace_replay_t {
+    trace_t* trace;
+    trace_request_t** pending;
+    double* pending_sent;
+    int pending_size;
+    int pending_capacity;
+    double clock;
+    int round_trips;
+    double wait_time;
+    int next;
+    int unrecorded;
+} trace_replay_t;
+
+
+// -- functions
+
+/**
+ * Start recording to a file, replacing it if it exists.
+ *
+ * inner: the backend requests are sent through; copied
+ * recorder (output): should be closed with `trace_recorder_close`
+ *
+ * returns: 0 on success, -1 if the file can't be opened (with `errno` set)
+ */
+int trace_recorder_open (char* path, x_backend_t* inner,
+                         trace_recorder_t* recorder);
+
+/**
+ * Set up a backend that sends requests through the recorder's inner backend,
+ * and records them with their replies.
+ *
+ * backend (output): the backend; doesn't need freeing
+ */
+void trace_recorder_backend (trace_recorder_t* recorder,
+                             x_backend_t* backend);
+
+/**
+ * Record the settings for finding windows, once atoms are known.
+ *
+ * discovery: the settings, with the filter and its atoms if it has one
+ * filter_sources: the sources the filter was compiled from
+ * characters: characters labels are made of
+ */
+void trace_recorder_settings (trace_recorder_t* recorder,
+                              discovery_t* discovery,
+                              char** filter_sources, int filter_sources_size,
+                              char* characters);
+
+/**
+ * Record the windows found, with their labels.
+ *
+ * windows: the windows
+ * labels: for each of `windows`, its label, or NULL if windows are chosen by
+ *     searching their names, which aren't recorded as labels
+ */
+void trace_recorder_labels (trace_recorder_t* recorder,
+                            xcb_window_t* windows, char** labels,
+                            int windows_size);
+
+/**
+ * Record a key typed.
+ *
+ * character: as for `trace_t.keys`
+ */
+void trace_recorder_key (trace_recorder_t* recorder, char character);
+
+/**
+ * Record the result of the run, and close the file.
+ *
+ * status: result of the run, as in xcw.h
+ * chosen: the window chosen, with XCW_CHOSEN
+ *
+ * returns: 0 on success, -1 if writing the file failed at any point (with
+ *     `errno` set)
+ */
+int trace_recorder_close (trace_recorder_t* recorder, int status,
+                          xcb_window_t chosen);
+
+/**
+ * Read a trace.
+ *
+ * trace (output): should be freed with `trace_free`
+ * error (output): on failure, a description of the problem; static
+ *
+ * returns: 0 on success, -1 if the file can't be read or isn't a trace
+ */
+int trace_read (char* path, trace_t* trace, char** error);
+
+/**
+ * Free memory used by a trace.
+ */
+void trace_free (trace_t* trace);
+
+/**
+ * Set up a backend that replays a trace.
+ *
+ * replay (output): should be freed with `trace_replay_free`
+ * backend (output): the backend; doesn't need freeing
+ */
+void trace_replay_backend (trace_t* trace, trace_replay_t* replay,
+                           x_backend_t* backend);
+
+/**
+ * Free memory used by a replay.
+ */
+void trace_replay_free (trace_replay_t* replay);
+
+
+#endif
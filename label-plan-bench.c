@@ -0,0 +1,108 @@
+/*
+
+Licensed under the Apache License, Version 2.0 (the "License"); you may not use
+this file except in compliance with the License. You may obtain a copy of the
+License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software distributed
+under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+CONDITIONS OF ANY KIND, either express or implied. See the License for the
+specific language governing permissions and limitations under the License.
+
+*/
+
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "label-plan.h"
+
+
+/**
+ * Numbers of windows to plan for.
+ */
+int WINDOWS_SIZES[] = { 10, 100, 1000, 10000, 100000, 1000000 };
+int WINDOWS_SIZES_SIZE = sizeof(WINDOWS_SIZES) / sizeof(*WINDOWS_SIZES);
+/**
+ * Alphabet sizes to plan with.
+ */
+int ALPHABET_SIZES[] = { 2, 4, 7, 26, 36 };
+int ALPHABET_SIZES_SIZE = sizeof(ALPHABET_SIZES) / sizeof(*ALPHABET_SIZES);
+/**
+ * Minimum total time spent planning for each case, in seconds.
+ */
+double MIN_TIME = 0.2;
+
+
+/**
+ * Get the current time in seconds.
+ */
+double now () {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+/**
+ * Time planning for one case, and check the result.
+ *
+ * weights: as taken by `label_plan_create`
+ *
+ * returns: 0 if the plan is valid, 1 otherwise
+ */
+int bench_case (int windows_size, int alphabet_size, double* weights) {
+    label_plan_t plan;
+    int runs = 0;
+    double start = now();
+    double elapsed;
+    do {
+        if (runs > 0) label_plan_free(&plan);
+        if (label_plan_create(windows_size, alphabet_size, weights,
+                              &plan) != 0) {
+            printf("%8d %4d %9s  error: label_plan_create failed\n",
+                   windows_size, alphabet_size, weights ? "weighted" : "balanced");
+            return 1;
+        }
+        runs += 1;
+        elapsed = now() - start;
+    } while (elapsed < MIN_TIME);
+
+    char* problem = label_plan_check(&plan, alphabet_size);
+    int min_depth = label_plan_min_depth(windows_size, alphabet_size);
+    if (problem == NULL && weights == NULL && plan.max_length != min_depth) {
+        problem = "depth is not minimal";
+    }
+
+    printf("%8d %4d %9s %12.3f %7d %7d  %s\n",
+           windows_size, alphabet_size, weights ? "weighted" : "balanced",
+           elapsed / runs * 1e6, plan.max_length, min_depth,
+           problem == NULL ? "ok" : problem);
+    label_plan_free(&plan);
+    return problem == NULL ? 0 : 1;
+}
+
+
+int main () {
+    int failures = 0;
+    int max_windows_size = WINDOWS_SIZES[WINDOWS_SIZES_SIZE - 1];
+    double* weights = calloc(max_windows_size, sizeof(double));
+    srand(0);
+    for (int i = 0; i < max_windows_size; i++) {
+        weights[i] = (double)rand() / RAND_MAX;
+    }
+
+    printf("%8s %4s %9s %12s %7s %7s  %s\n", "windows", "keys", "mode",
+           "time (us)", "depth", "minimal", "check");
+    for (int w = 0; w < WINDOWS_SIZES_SIZE; w++) {
+        for (int a = 0; a < ALPHABET_SIZES_SIZE; a++) {
+            failures += bench_case(WINDOWS_SIZES[w], ALPHABET_SIZES[a], NULL);
+            failures += bench_case(WINDOWS_SIZES[w], ALPHABET_SIZES[a],
+                                   weights);
+        }
+    }
+
+    free(weights);
+    return failures == 0 ? 0 : 1;
+}
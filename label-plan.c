@@ -0,0 +1,388 @@
+/*
+
+Licensed under the Apache License, Version 2.0 (the "License"); you may not use
+this file except in compliance with the License. You may obtain a copy of the
+License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software distributed
+under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+CONDITIONS OF ANY KIND, either express or implied. See the License for the
+specific language governing permissions and limitations under the License.
+
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include "label-plan.h"
+
+
+// -- utilities
+
+/**
+ * Allocate the arrays in a plan, with `keys` zeroed.
+ *
+ * returns: 0 on success, -1 if memory can't be allocated
+ */
+int _label_plan_alloc (label_plan_t* plan, int size, int max_length) {
+    plan->size = size;
+    plan->max_length = max_length;
+    plan->lengths = calloc(size, sizeof(int));
+    plan->keys = calloc((size_t)size * max_length, sizeof(unsigned char));
+    plan->order = calloc(size, sizeof(int));
+    if (size > 0 && (plan->lengths == NULL || plan->keys == NULL ||
+                     plan->order == NULL)) {
+        label_plan_free(plan);
+        return -1;
+    }
+    return 0;
+}
+
+
+unsigned char* label_plan_label (label_plan_t* plan, int window) {
+    return plan->keys + (size_t)window * plan->max_length;
+}
+
+
+int label_plan_min_depth (int windows_size, int alphabet_size) {
+    int depth = 1;
+    // number of labels of length `depth`
+    long long capacity = alphabet_size;
+    while (capacity < windows_size) {
+        capacity *= alphabet_size;
+        depth += 1;
+    }
+    return depth;
+}
+
+
+// -- balanced plans
+
+/**
+ * Assign labels for a range of windows sharing a prefix.
+ *
+ * remain_depth: number of nested levels remaining (we choose a key at every
+ *     level; if 0, we choose the last key)
+ * start: index of the first window in the range
+ * windows_size: number of windows in the range
+ * depth: length of the prefix already assigned
+ */
+void _label_plan_balanced (label_plan_t* plan, int alphabet_size,
+                           int remain_depth, int start, int windows_size,
+                           int depth) {
+    if (remain_depth == 0) {
+        // guaranteed that windows_size <= alphabet_size
+        for (int i = 0; i < windows_size; i++) {
+            label_plan_label(plan, start + i)[depth] = i;
+            plan->lengths[start + i] = depth + 1;
+        }
+
+    } else {
+        // base number of windows 'used up' per iteration
+        int p = windows_size / alphabet_size;
+        // number of iterations to use one extra window
+        int r = windows_size % alphabet_size;
+        // required number of iterations to use all windows
+        int n = p > 0 ? alphabet_size : r;
+        int remain_start = start;
+
+        for (int i = 0; i < n; i++) {
+            int children_size = i < r ? p + 1 : p;
+            for (int j = remain_start; j < remain_start + children_size; j++) {
+                label_plan_label(plan, j)[depth] = i;
+            }
+
+            if (children_size == 1) {
+                plan->lengths[remain_start] = depth + 1;
+            } else {
+                _label_plan_balanced(plan, alphabet_size, remain_depth - 1,
+                                     remain_start, children_size, depth + 1);
+            }
+
+            remain_start += children_size;
+        }
+    }
+}
+
+
+/**
+ * Assign labels without weights.  See `label_plan_create`.
+ */
+int _label_plan_create_balanced (int windows_size, int alphabet_size,
+                                 label_plan_t* plan) {
+    int depth = windows_size == 0 ? 0 : label_plan_min_depth(windows_size,
+                                                             alphabet_size);
+    if (_label_plan_alloc(plan, windows_size, depth) != 0) return -1;
+    for (int i = 0; i < windows_size; i++) plan->order[i] = i;
+    if (windows_size > 0) {
+        _label_plan_balanced(plan, alphabet_size, depth - 1,
+                             0, windows_size, 0);
+    }
+    return 0;
+}
+
+
+// -- weighted plans
+
+/**
+ * Determine whether one node should be merged before another when building a
+ * weighted plan.  Padding nodes come first among nodes of equal weight, so that
+ * they end up with the highest keys.
+ *
+ * windows_size, leaves_size: nodes with indices in this range are padding
+ */
+int _label_plan_node_before (double* node_weights, int windows_size,
+                             int leaves_size, int a, int b) {
+    if (node_weights[a] != node_weights[b]) {
+        return node_weights[a] < node_weights[b];
+    }
+    int a_padding = a >= windows_size && a < leaves_size;
+    int b_padding = b >= windows_size && b < leaves_size;
+    if (a_padding != b_padding) return a_padding;
+    return a < b;
+}
+
+
+/**
+ * Restore the heap property after changing an item in a binary min-heap of
+ * node indices.
+ *
+ * i: index in `heap` of the changed item
+ */
+void _label_plan_heap_sift (int* heap, int heap_size, int i,
+                            double* node_weights, int windows_size,
+                            int leaves_size) {
+    // sift up
+    while (i > 0 && _label_plan_node_before(node_weights, windows_size,
+                                            leaves_size,
+                                            heap[i], heap[(i - 1) / 2])) {
+        int tmp = heap[i];
+        heap[i] = heap[(i - 1) / 2];
+        heap[(i - 1) / 2] = tmp;
+        i = (i - 1) / 2;
+    }
+
+    // sift down
+    while (1) {
+        int smallest = i;
+        for (int c = 2 * i + 1; c <= 2 * i + 2 && c < heap_size; c++) {
+            if (_label_plan_node_before(node_weights, windows_size,
+                                        leaves_size, heap[c], heap[smallest])) {
+                smallest = c;
+            }
+        }
+        if (smallest == i) break;
+        int tmp = heap[i];
+        heap[i] = heap[smallest];
+        heap[smallest] = tmp;
+        i = smallest;
+    }
+}
+
+
+/**
+ * Assign labels with weights, by building an `alphabet_size`-ary Huffman tree.
+ * See `label_plan_create`.
+ */
+int _label_plan_create_weighted (int windows_size, int alphabet_size,
+                                 double* weights, label_plan_t* plan) {
+    // pad with empty nodes so every internal node has `alphabet_size` children
+    int padding_size = 0;
+    while ((windows_size + padding_size - 1) % (alphabet_size - 1) != 0) {
+        padding_size += 1;
+    }
+    int leaves_size = windows_size + padding_size;
+    int internal_size = (leaves_size - 1) / (alphabet_size - 1);
+    // node indices: windows, then padding, then internal nodes
+    int internal_start = leaves_size;
+    int nodes_size = internal_start + internal_size;
+
+    double* node_weights = calloc(nodes_size, sizeof(double));
+    int* parents = calloc(nodes_size, sizeof(int));
+    unsigned char* node_keys = calloc(nodes_size, sizeof(unsigned char));
+    int* depths = calloc(nodes_size, sizeof(int));
+    int* heap = calloc(leaves_size, sizeof(int));
+    // children of each internal node, by key
+    int* children = calloc((size_t)internal_size * alphabet_size, sizeof(int));
+    int status = -1;
+    if (node_weights == NULL || parents == NULL || node_keys == NULL ||
+        depths == NULL || heap == NULL || children == NULL) {
+        goto cleanup;
+    }
+
+    int heap_size = 0;
+    for (int i = 0; i < leaves_size; i++) {
+        node_weights[i] = i < windows_size ? weights[i] : 0;
+        heap[heap_size] = i;
+        heap_size += 1;
+        _label_plan_heap_sift(heap, heap_size, heap_size - 1,
+                              node_weights, windows_size, leaves_size);
+    }
+
+    for (int n = 0; n < internal_size; n++) {
+        int node = internal_start + n;
+        node_weights[node] = 0;
+        // lightest nodes get the highest keys
+        for (int key = alphabet_size - 1; key >= 0; key--) {
+            int child = heap[0];
+            heap_size -= 1;
+            heap[0] = heap[heap_size];
+            _label_plan_heap_sift(heap, heap_size, 0,
+                                  node_weights, windows_size, leaves_size);
+
+            parents[child] = node;
+            node_keys[child] = key;
+            children[(size_t)n * alphabet_size + key] = child;
+            node_weights[node] += node_weights[child];
+        }
+        heap[heap_size] = node;
+        heap_size += 1;
+        _label_plan_heap_sift(heap, heap_size, heap_size - 1,
+                              node_weights, windows_size, leaves_size);
+    }
+
+    // internal nodes are created after their children, so parents come first
+    // in reverse order
+    int root = internal_start + internal_size - 1;
+    int max_length = 0;
+    for (int n = internal_size - 1; n >= 0; n--) {
+        int node = internal_start + n;
+        for (int key = 0; key < alphabet_size; key++) {
+            int child = children[(size_t)n * alphabet_size + key];
+            depths[child] = node == root ? 1 : depths[node] + 1;
+            if (child < windows_size && depths[child] > max_length) {
+                max_length = depths[child];
+            }
+        }
+    }
+
+    if (_label_plan_alloc(plan, windows_size, max_length) != 0) goto cleanup;
+    for (int i = 0; i < windows_size; i++) {
+        plan->lengths[i] = depths[i];
+        unsigned char* label = label_plan_label(plan, i);
+        int node = i;
+        for (int d = depths[i] - 1; d >= 0; d--) {
+            label[d] = node_keys[node];
+            node = parents[node];
+        }
+    }
+
+    // depth-first traversal in key order visits windows in label order; the
+    // heap is empty, so reuse it as the stack (which holds at most
+    // `leaves_size` nodes)
+    int stack_size = 0;
+    int order_size = 0;
+    heap[stack_size] = root;
+    stack_size += 1;
+    while (stack_size > 0) {
+        stack_size -= 1;
+        int node = heap[stack_size];
+        if (node < windows_size) {
+            plan->order[order_size] = node;
+            order_size += 1;
+        } else if (node >= internal_start) {
+            int n = node - internal_start;
+            for (int key = alphabet_size - 1; key >= 0; key--) {
+                heap[stack_size] = children[(size_t)n * alphabet_size + key];
+                stack_size += 1;
+            }
+        }
+    }
+    status = 0;
+
+cleanup:
+    free(children);
+    free(heap);
+    free(depths);
+    free(node_keys);
+    free(parents);
+    free(node_weights);
+    return status;
+}
+
+
+// -- public functions
+
+int label_plan_create (int windows_size, int alphabet_size, double* weights,
+                       label_plan_t* plan) {
+    memset(plan, 0, sizeof(label_plan_t));
+    if (windows_size < 0 || alphabet_size < 2 || alphabet_size > 256) {
+        return -1;
+    }
+
+    if (weights == NULL || windows_size < 2) {
+        return _label_plan_create_balanced(windows_size, alphabet_size, plan);
+    } else {
+        for (int i = 0; i < windows_size; i++) {
+            if (!(weights[i] >= 0)) return -1;
+        }
+        return _label_plan_create_weighted(windows_size, alphabet_size,
+                                           weights, plan);
+    }
+}
+
+
+void label_plan_free (label_plan_t* plan) {
+    free(plan->lengths);
+    free(plan->keys);
+    free(plan->order);
+    memset(plan, 0, sizeof(label_plan_t));
+}
+
+
+char* label_plan_check (label_plan_t* plan, int alphabet_size) {
+    if (plan->size < 0) return "negative size";
+    int max_length = 0;
+    for (int i = 0; i < plan->size; i++) {
+        if (plan->lengths[i] < 1 || plan->lengths[i] > plan->max_length) {
+            return "label length out of range";
+        }
+        max_length = plan->lengths[i] > max_length ? plan->lengths[i] :
+                                                     max_length;
+        for (int d = 0; d < plan->lengths[i]; d++) {
+            if (label_plan_label(plan, i)[d] >= alphabet_size) {
+                return "key out of range";
+            }
+        }
+    }
+    if (max_length != plan->max_length) return "incorrect maximum length";
+
+    char* seen = calloc((size_t)plan->size, sizeof(char));
+    char* problem = NULL;
+    for (int i = 0; i < plan->size && problem == NULL; i++) {
+        int window = plan->order[i];
+        if (window < 0 || window >= plan->size || seen[window]) {
+            problem = "order is not a permutation";
+            break;
+        }
+        seen[window] = 1;
+        unsigned char* label = label_plan_label(plan, window);
+        int length = plan->lengths[window];
+
+        // each label is the smallest one under the prefix it shares with the
+        // previous label, and follows it without a gap
+        int shared = 0;
+        if (i > 0) {
+            int prev = plan->order[i - 1];
+            unsigned char* prev_label = label_plan_label(plan, prev);
+            int prev_length = plan->lengths[prev];
+            while (shared < length && shared < prev_length &&
+                   label[shared] == prev_label[shared]) {
+                shared += 1;
+            }
+            if (shared == length || shared == prev_length) {
+                problem = "labels are not prefix-free";
+            } else if (label[shared] != prev_label[shared] + 1) {
+                problem = "labels are not sorted, or keys are skipped";
+            }
+            shared += 1;
+        }
+        for (int d = shared; d < length && problem == NULL; d++) {
+            if (label[d] != 0) problem = "keys are skipped";
+        }
+    }
+
+    free(seen);
+    return problem;
+}
@@ -0,0 +1,95 @@
+/*
+
+Licensed under the Apache License, Version 2.0 (the "License"); you may not use
+this file except in compliance with the License. You may obtain a copy of the
+License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software distributed
+under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+CONDITIONS OF ANY KIND, either express or implied. See the License for the
+specific language governing permissions and limitations under the License.
+
+*/
+
+#ifndef XCW_LABEL_PLAN_H
+#define XCW_LABEL_PLAN_H
+
+
+// -- types
+
+/**
+ * The labels assigned to a number of windows.  Labels are sequences of keys,
+ * where a key is an index into an alphabet.
+ *
+ * Labels are prefix-free.  For every prefix shared by some labels, the keys
+ * following it are exactly `0` to `c - 1` for some `c`.
+ *
+ * size: number of labels (one per window)
+ * max_length: length of the longest label
+ * lengths: length of each label
+ * keys: `size` rows of `max_length` keys; row `i` starts with the label for
+ *     window `i`
+ * order: window indices, sorted by label
+ */
+typedef struct label_plan_t {
+    int size;
+    int max_length;
+    int* lengths;
+    unsigned char* keys;
+    int* order;
+} label_plan_t;
+
+
+// -- functions
+
+/**
+ * Assign labels to windows.
+ *
+ * Without weights, every label has either the minimum length needed to give
+ * every window a label, or one key less, and labels are assigned in order (so
+ * `order` is `0` to `windows_size - 1`).
+ *
+ * With weights, the average label length weighted by `weights` is minimised.
+ *
+ * windows_size: number of windows
+ * alphabet_size: number of keys available, at least 2 and at most 256
+ * weights: non-negative weight of each window, or NULL
+ * plan (output): the result; should be freed with `label_plan_free`
+ *
+ * returns: 0 on success, -1 if arguments are invalid or memory can't be
+ *     allocated
+ */
+int label_plan_create (int windows_size, int alphabet_size, double* weights,
+                       label_plan_t* plan);
+
+/**
+ * Free memory used by a plan.
+ */
+void label_plan_free (label_plan_t* plan);
+
+/**
+ * Get the label for a window.
+ *
+ * window: index of the window
+ *
+ * returns: the keys in the label, of length `plan->lengths[window]`
+ */
+unsigned char* label_plan_label (label_plan_t* plan, int window);
+
+/**
+ * Get the minimum label length required to give each window a unique
+ * prefix-free label.
+ */
+int label_plan_min_depth (int windows_size, int alphabet_size);
+
+/**
+ * Check that a plan satisfies the guarantees made by `label_plan_t`.
+ *
+ * returns: NULL if the plan is valid, or a description of the problem
+ */
+char* label_plan_check (label_plan_t* plan, int alphabet_size);
+
+
+#endif
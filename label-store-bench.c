@@ -0,0 +1,210 @@
+/*
+
+Licensed under the Apache License, Version 2.0 (the "License"); you may not use
+this file except in compliance with the License. You may obtain a copy of the
+License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software distributed
+under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+CONDITIONS OF ANY KIND, either express or implied. See the License for the
+specific language governing permissions and limitations under the License.
+
+*/
+
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "label-plan.h"
+#include "label-store.h"
+
+
+/**
+ * Numbers of windows open at a time, on average.
+ */
+int WINDOWS_SIZES[] = { 5, 20, 100, 1000 };
+int WINDOWS_SIZES_SIZE = sizeof(WINDOWS_SIZES) / sizeof(*WINDOWS_SIZES);
+/**
+ * Alphabets to use.
+ */
+char* ALPHABETS[] = { "asdf", "asdfjkl;g", "abcdefghijklmnopqrstuvwxyz" };
+int ALPHABETS_SIZE = sizeof(ALPHABETS) / sizeof(*ALPHABETS);
+/**
+ * Number of runs simulated for each case.  Between runs, each window is hidden
+ * (such as on another desktop) with probability 1/5, and closed and reopened
+ * with a new ID with probability 1/50.
+ */
+int RUNS = 200;
+/**
+ * Number of windows belonging to each application.
+ */
+int WINDOWS_PER_CLASS = 3;
+
+
+/**
+ * Get the current time in seconds.
+ */
+double now () {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+/**
+ * Check that labels are prefix-free, use keys from the alphabet, and are
+ * sorted by `order`.
+ *
+ * returns: NULL if the plan is valid, or a description of the problem
+ */
+char* check_plan (label_plan_t* plan, int alphabet_size) {
+    for (int i = 0; i < plan->size; i++) {
+        for (int d = 0; d < plan->lengths[i]; d++) {
+            if (label_plan_label(plan, i)[d] >= alphabet_size) {
+                return "key out of range";
+            }
+        }
+    }
+    for (int i = 1; i < plan->size; i++) {
+        int a = plan->order[i - 1];
+        int b = plan->order[i];
+        int la = plan->lengths[a];
+        int lb = plan->lengths[b];
+        int shared = 0;
+        while (shared < la && shared < lb && label_plan_label(plan, a)[shared]
+               == label_plan_label(plan, b)[shared]) {
+            shared += 1;
+        }
+        if (shared == la || shared == lb) return "labels are not prefix-free";
+        if (label_plan_label(plan, a)[shared] >
+            label_plan_label(plan, b)[shared]) {
+            return "labels are not sorted";
+        }
+    }
+    return NULL;
+}
+
+
+/**
+ * Simulate runs for one case, timing label assignment and counting how many
+ * windows keep their labels between runs.
+ *
+ * returns: 0 if every plan is valid, 1 otherwise
+ */
+int bench_case (int windows_size, char* alphabet) {
+    int alphabet_size = strlen(alphabet);
+    int universe_size = windows_size + windows_size / 4;
+    uint32_t* ids = calloc(universe_size, sizeof(uint32_t));
+    uint32_t* classes = calloc(universe_size, sizeof(uint32_t));
+    // the label each window had in the last run it was in, as keys, or empty
+    unsigned char* last = calloc((size_t)universe_size * 32, 1);
+    uint32_t* windows = calloc(universe_size, sizeof(uint32_t));
+    uint32_t* window_classes = calloc(universe_size, sizeof(uint32_t));
+    int* present = calloc(universe_size, sizeof(int));
+    uint32_t next_id = 0x400001;
+    unsigned int seed = 1;
+    for (int u = 0; u < universe_size; u++) {
+        char class[16];
+        snprintf(class, sizeof(class), "app%d", u / WINDOWS_PER_CLASS);
+        ids[u] = next_id;
+        next_id += 0x100;
+        classes[u] = label_store_hash(class, strlen(class));
+    }
+
+    char path[] = "/tmp/label-store-bench-XXXXXX";
+    int fd = mkstemp(path);
+    label_store_t store;
+    char* problem = NULL;
+    if (fd == -1 || label_store_open(path, &store) != 0) {
+        problem = "can't create the store";
+    }
+    if (fd != -1) close(fd);
+
+    double elapsed = 0;
+    long long kept = 0;
+    long long seen_again = 0;
+    long long total_length = 0;
+    long long labelled = 0;
+    for (int r = 0; r < RUNS && problem == NULL; r++) {
+        int size = 0;
+        for (int u = 0; u < universe_size; u++) {
+            seed = seed * 1103515245 + 12345;
+            int roll = (seed >> 8) % 50;
+            if (roll == 0) {
+                // reopened: the old label should go to the new window
+                ids[u] = next_id;
+                next_id += 0x100;
+            }
+            if (roll < 10 && r > 0) continue;
+            windows[size] = ids[u];
+            window_classes[size] = classes[u];
+            present[size] = u;
+            size += 1;
+        }
+        if (size == 0) continue;
+
+        label_plan_t plan;
+        double start = now();
+        if (label_store_assign(&store, windows, window_classes, size,
+                               alphabet, alphabet_size, 1, &plan) != 0) {
+            problem = "label_store_assign failed";
+            break;
+        }
+        elapsed += now() - start;
+        problem = check_plan(&plan, alphabet_size);
+
+        for (int i = 0; i < size; i++) {
+            unsigned char* old = last + (size_t)present[i] * 32;
+            unsigned char* label = label_plan_label(&plan, i);
+            if (old[0] != 0) {
+                seen_again += 1;
+                if (old[0] == plan.lengths[i] &&
+                    memcmp(old + 1, label, plan.lengths[i]) == 0) {
+                    kept += 1;
+                }
+            }
+            old[0] = plan.lengths[i];
+            memcpy(old + 1, label, plan.lengths[i]);
+            total_length += plan.lengths[i];
+            labelled += 1;
+        }
+        label_plan_free(&plan);
+    }
+
+    if (problem == NULL) {
+        printf("%7d %8d %10.2f %10.2f %9.1f %9.2f  ok\n", windows_size,
+               alphabet_size, (double)total_length / labelled,
+               (double)label_plan_min_depth(windows_size, alphabet_size),
+               100.0 * kept / (seen_again > 0 ? seen_again : 1),
+               elapsed / RUNS * 1e3);
+    } else {
+        printf("%7d %8d  error: %s\n", windows_size, alphabet_size, problem);
+    }
+    if (fd != -1) {
+        label_store_close(&store);
+        unlink(path);
+    }
+    free(ids);
+    free(classes);
+    free(last);
+    free(windows);
+    free(window_classes);
+    free(present);
+    return problem == NULL ? 0 : 1;
+}
+
+
+int main () {
+    int failures = 0;
+    printf("%7s %8s %10s %10s %9s %9s  %s\n", "windows", "alphabet",
+           "mean len", "min depth", "kept (%)", "time (ms)", "check");
+    for (int w = 0; w < WINDOWS_SIZES_SIZE; w++) {
+        for (int a = 0; a < ALPHABETS_SIZE; a++) {
+            failures += bench_case(WINDOWS_SIZES[w], ALPHABETS[a]);
+        }
+    }
+    return failures == 0 ? 0 : 1;
+}
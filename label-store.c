@@ -0,0 +1,843 @@
+/*
+
+Licensed under the Apache License, Version 2.0 (the "License"); you may not use
+this file except in compliance with the License. You may obtain a copy of the
+License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software distributed
+under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+CONDITIONS OF ANY KIND, either express or implied. See the License for the
+specific language governing permissions and limitations under the License.
+
+*/
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "label-plan.h"
+#include "label-store.h"
+
+
+/**
+ * Maximum number of characters in a label.  Entries are 32 bytes.
+ */
+#define LABEL_STORE_LABEL_MAX 19
+
+
+// -- types
+
+/**
+ * Start of a label store file.
+ *
+ * magic: `LABEL_STORE_MAGIC`
+ * version: `LABEL_STORE_VERSION`
+ * clock: number of times labels have been assigned and saved
+ * entries_size: number of entries following the header
+ */
+typedef struct _label_store_header_t {
+    char magic[4];
+    uint32_t version;
+    uint32_t clock;
+    uint32_t entries_size;
+} _label_store_header_t;
+
+/**
+ * A remembered label.
+ *
+ * window: the window ID
+ * class: hash of the window's application
+ * used: `clock` when the window was last seen
+ * length: number of characters in `label`
+ * label: the characters typed to choose the window
+ */
+typedef struct _label_store_entry_t {
+    uint32_t window;
+    uint32_t class;
+    uint32_t used;
+    unsigned char length;
+    char label[LABEL_STORE_LABEL_MAX];
+} _label_store_entry_t;
+
+/**
+ * A label taken by a window, or reserved for a window that has gone, while
+ * assigning labels.
+ *
+ * window: index of the window, or -1 for a reservation
+ * used: when the label was last used, as in `_label_store_entry_t`
+ * node: the node in the trie where the label ends, or 0 if it isn't in the
+ *     trie
+ * length: number of keys in `keys`
+ * keys: the label, as indices into the alphabet
+ */
+typedef struct _label_claim_t {
+    int window;
+    uint32_t used;
+    int node;
+    int length;
+    unsigned char keys[LABEL_STORE_LABEL_MAX];
+} _label_claim_t;
+
+/**
+ * Labels taken so far while assigning labels, as a tree with a node for each
+ * prefix of each label.  Node 0 is the empty prefix.
+ *
+ * children: for each node, `alphabet_size` child nodes, or 0 for none
+ * claims: for each node, the index of the claim whose label ends there, or -1
+ * nodes_size: number of nodes
+ * nodes_capacity: allocated number of nodes
+ */
+typedef struct _label_trie_t {
+    int* children;
+    int* claims;
+    int nodes_size;
+    int nodes_capacity;
+    int alphabet_size;
+} _label_trie_t;
+
+
+// -- constants
+
+/**
+ * Identifies label store files.
+ */
+char LABEL_STORE_MAGIC[] = "XCWL";
+/**
+ * Version of the file format; files with other versions are overwritten.
+ */
+uint32_t LABEL_STORE_VERSION = 1;
+/**
+ * Maximum number of entries kept.  Entries for windows seen least recently are
+ * forgotten first.
+ */
+int LABEL_STORE_MAX_ENTRIES = 4096;
+/**
+ * Number of times labels are assigned before a window that has gone is
+ * forgotten.
+ */
+uint32_t LABEL_STORE_FORGET_AGE = 1000;
+/**
+ * Number of times labels are assigned before the label of a window that has
+ * gone stops being reserved, and can be given to another window.
+ */
+uint32_t LABEL_STORE_RESERVE_AGE = 50;
+
+
+// -- utilities
+
+/**
+ * Compare entries by window ID, for use with `qsort` and `bsearch`.
+ */
+int _label_store_compare_entries (const void* a, const void* b) {
+    const _label_store_entry_t* ea = a;
+    const _label_store_entry_t* eb = b;
+    return ea->window < eb->window ? -1 : ea->window > eb->window;
+}
+
+
+/**
+ * Compare entries by when they were last used, most recent first, for use with
+ * `qsort`.
+ */
+int _label_store_compare_used (const void* a, const void* b) {
+    const _label_store_entry_t* ea = a;
+    const _label_store_entry_t* eb = b;
+    return ea->used > eb->used ? -1 : ea->used < eb->used;
+}
+
+
+/**
+ * Compare window IDs, for use with `qsort` and `bsearch`.
+ */
+int _label_store_compare_windows (const void* a, const void* b) {
+    uint32_t wa = *(const uint32_t*)a;
+    uint32_t wb = *(const uint32_t*)b;
+    return wa < wb ? -1 : wa > wb;
+}
+
+
+/**
+ * Compare claims to decide which keep their labels, for use with `qsort`:
+ * windows before reservations, then most recently used first.
+ */
+int _label_store_compare_claims (const void* a, const void* b) {
+    const _label_claim_t* ca = a;
+    const _label_claim_t* cb = b;
+    if ((ca->window == -1) != (cb->window == -1)) {
+        return ca->window == -1 ? 1 : -1;
+    }
+    return ca->used > cb->used ? -1 : ca->used < cb->used;
+}
+
+
+/**
+ * Compare labels, for use with `qsort`: shortest first, then in key order.
+ */
+int _label_store_compare_slots (const void* a, const void* b) {
+    const _label_claim_t* ca = a;
+    const _label_claim_t* cb = b;
+    if (ca->length != cb->length) return ca->length - cb->length;
+    return memcmp(ca->keys, cb->keys, ca->length);
+}
+
+
+/**
+ * Convert a remembered label to keys.
+ *
+ * keys (output): has room for `LABEL_STORE_LABEL_MAX` keys
+ *
+ * returns: 0 on success, -1 if the label is empty or has a character not in
+ *     `alphabet`
+ */
+int _label_store_keys (_label_store_entry_t* entry, char* alphabet,
+                       int alphabet_size, unsigned char* keys) {
+    if (entry->length == 0 || entry->length > LABEL_STORE_LABEL_MAX) return -1;
+    for (int d = 0; d < entry->length; d++) {
+        char* c = memchr(alphabet, entry->label[d], alphabet_size);
+        if (c == NULL) return -1;
+        keys[d] = c - alphabet;
+    }
+    return 0;
+}
+
+
+/**
+ * Get the entries in the mapped file, if it's a valid label store.
+ *
+ * clock (output): the store's clock, or 0 if it isn't valid
+ * entries_size (output): number of entries, or 0 if it isn't valid
+ *
+ * returns: the entries
+ */
+_label_store_entry_t* _label_store_entries (label_store_t* store,
+                                            uint32_t* clock,
+                                            int* entries_size) {
+    _label_store_header_t* header = (_label_store_header_t*)store->map;
+    *clock = 0;
+    *entries_size = 0;
+    if (store->map_size < sizeof(_label_store_header_t) ||
+        memcmp(header->magic, LABEL_STORE_MAGIC, 4) != 0 ||
+        header->version != LABEL_STORE_VERSION ||
+        header->entries_size > (
+            (store->map_size - sizeof(_label_store_header_t)) /
+            sizeof(_label_store_entry_t))) {
+        return NULL;
+    }
+    *clock = header->clock;
+    *entries_size = header->entries_size;
+    return (_label_store_entry_t*)(store->map + sizeof(_label_store_header_t));
+}
+
+
+/**
+ * Map the file again if its size has changed.
+ *
+ * size: the size the file should have, or 0 to use its current size
+ *
+ * returns: 0 on success, -1 on failure, with `store->map` NULL
+ */
+int _label_store_remap (label_store_t* store, size_t size) {
+    struct stat st;
+    if (size != 0 && ftruncate(store->fd, size) != 0) return -1;
+    if (fstat(store->fd, &st) != 0) return -1;
+    if (store->map != NULL && (size_t)st.st_size == store->map_size) return 0;
+
+    if (store->map != NULL) munmap(store->map, store->map_size);
+    store->map = NULL;
+    store->map_size = 0;
+    if (st.st_size == 0) return 0;
+    void* map = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                     store->fd, 0);
+    if (map == MAP_FAILED) return -1;
+    store->map = map;
+    store->map_size = st.st_size;
+    return 0;
+}
+
+
+// -- label trees
+
+/**
+ * Create an empty tree.
+ *
+ * returns: 0 on success, -1 if memory can't be allocated
+ */
+int _label_trie_create (_label_trie_t* trie, int alphabet_size) {
+    _label_trie_t empty = { NULL, NULL, 1, 64, alphabet_size };
+    *trie = empty;
+    trie->children = calloc((size_t)trie->nodes_capacity * alphabet_size,
+                            sizeof(int));
+    trie->claims = malloc(trie->nodes_capacity * sizeof(int));
+    if (trie->children == NULL || trie->claims == NULL) return -1;
+    trie->claims[0] = -1;
+    return 0;
+}
+
+
+/**
+ * Free memory used by a tree.
+ */
+void _label_trie_free (_label_trie_t* trie) {
+    free(trie->children);
+    free(trie->claims);
+}
+
+
+/**
+ * Determine whether a node has any children.
+ */
+int _label_trie_has_children (_label_trie_t* trie, int node) {
+    int* children = trie->children + (size_t)node * trie->alphabet_size;
+    for (int k = 0; k < trie->alphabet_size; k++) {
+        if (children[k] != 0) return 1;
+    }
+    return 0;
+}
+
+
+/**
+ * Find where a label would go in a tree.
+ *
+ * depth (output): number of keys of `keys` that have nodes
+ *
+ * returns: the node for the first `depth` keys, or -1 if the label can't be
+ *     added, because it has a prefix in the tree or is a prefix of a label in
+ *     the tree
+ */
+int _label_trie_find (_label_trie_t* trie, unsigned char* keys, int length,
+                      int* depth) {
+    int node = 0;
+    for (*depth = 0; *depth < length; *depth += 1) {
+        if (trie->claims[node] != -1) return -1;
+        int child = trie->children[
+            (size_t)node * trie->alphabet_size + keys[*depth]];
+        if (child == 0) return node;
+        node = child;
+    }
+    if (trie->claims[node] != -1 || _label_trie_has_children(trie, node)) {
+        return -1;
+    }
+    return node;
+}
+
+
+/**
+ * Add a claim's label to a tree, if it doesn't clash with any label already
+ * there, and set `claim->node`.
+ *
+ * index: the index of `claim`
+ *
+ * returns: 1 if the label was added, 0 if it clashes, or -1 if memory can't
+ *     be allocated
+ */
+int _label_trie_insert (_label_trie_t* trie, _label_claim_t* claim,
+                        int index) {
+    int depth;
+    int node = _label_trie_find(trie, claim->keys, claim->length, &depth);
+    if (node == -1) return 0;
+
+    for (; depth < claim->length; depth++) {
+        if (trie->nodes_size == trie->nodes_capacity) {
+            int capacity = trie->nodes_capacity * 2;
+            int* children = realloc(
+                trie->children,
+                (size_t)capacity * trie->alphabet_size * sizeof(int));
+            if (children == NULL) return -1;
+            trie->children = children;
+            int* claims = realloc(trie->claims, capacity * sizeof(int));
+            if (claims == NULL) return -1;
+            trie->claims = claims;
+            trie->nodes_capacity = capacity;
+        }
+        int child = trie->nodes_size;
+        trie->nodes_size += 1;
+        memset(trie->children + (size_t)child * trie->alphabet_size, 0,
+               trie->alphabet_size * sizeof(int));
+        trie->claims[child] = -1;
+        trie->children[(size_t)node * trie->alphabet_size +
+                       claim->keys[depth]] = child;
+        node = child;
+    }
+    trie->claims[node] = index;
+    claim->node = node;
+    return 1;
+}
+
+
+/**
+ * See `_label_trie_slots`.
+ *
+ * node: the node for `path`
+ * path: keys leading to `node`
+ * depth: number of keys in `path`
+ */
+void _label_trie_slots_from (_label_trie_t* trie, int node,
+                             unsigned char* path, int depth,
+                             _label_claim_t* slots, int* slots_size) {
+    if (trie->claims[node] != -1) return;
+    if (node != 0 && !_label_trie_has_children(trie, node)) {
+        // a label given up by `label_store_assign`
+        _label_claim_t slot = { -1, 0, 0, depth, { 0 } };
+        memcpy(slot.keys, path, depth);
+        slots[*slots_size] = slot;
+        *slots_size += 1;
+        return;
+    }
+    if (depth == LABEL_STORE_LABEL_MAX) return;
+
+    for (int k = 0; k < trie->alphabet_size; k++) {
+        int child = trie->children[(size_t)node * trie->alphabet_size + k];
+        path[depth] = k;
+        if (child != 0) {
+            _label_trie_slots_from(trie, child, path, depth + 1,
+                                   slots, slots_size);
+        } else {
+            _label_claim_t slot = { -1, 0, 0, depth + 1, { 0 } };
+            memcpy(slot.keys, path, depth + 1);
+            slots[*slots_size] = slot;
+            *slots_size += 1;
+        }
+    }
+}
+
+
+/**
+ * Find the shortest labels that can be added to a tree without clashing: each
+ * is the root of a subtree of labels that are free.
+ *
+ * slots (output): the labels; has room for `alphabet_size` per node
+ * slots_size (output): number of items in `slots`
+ */
+void _label_trie_slots (_label_trie_t* trie, _label_claim_t* slots,
+                        int* slots_size) {
+    unsigned char path[LABEL_STORE_LABEL_MAX];
+    *slots_size = 0;
+    _label_trie_slots_from(trie, 0, path, 0, slots, slots_size);
+}
+
+
+// -- assigning labels
+
+/**
+ * Find remembered labels for windows: their own, if they were seen before with
+ * the same application, or else that of the most recently seen window of the
+ * same application that has gone.  Labels of other windows that have gone,
+ * seen recently enough, are reserved.
+ *
+ * entries: remembered labels, sorted by window ID; copied, not mapped
+ * sorted_windows: `windows`, sorted
+ * claims (output): a claim for each window that has a label, then each
+ *     reservation; has room for `windows_size + entries_size` claims
+ * claims_size (output): number of items in `claims`
+ * claimed (output): for each entry, whether it was claimed by a window
+ * labelled (output): for each window, whether it kept its own label; zeroed
+ *     by the caller
+ */
+void _label_store_claim (_label_store_entry_t* entries, int entries_size,
+                         uint32_t clock, uint32_t* windows,
+                         uint32_t* sorted_windows, uint32_t* classes,
+                         int windows_size, char* alphabet, int alphabet_size,
+                         _label_claim_t* claims, int* claims_size,
+                         char* claimed, char* labelled) {
+    *claims_size = 0;
+
+    for (int i = 0; i < windows_size; i++) {
+        _label_store_entry_t key = { windows[i], 0, 0, 0, { 0 } };
+        _label_store_entry_t* entry = bsearch(
+            &key, entries, entries_size, sizeof(_label_store_entry_t),
+            _label_store_compare_entries);
+        if (entry == NULL || entry->class != classes[i]) continue;
+        _label_claim_t claim = { i, entry->used, 0, entry->length, { 0 } };
+        if (_label_store_keys(entry, alphabet, alphabet_size,
+                              claim.keys) != 0) {
+            continue;
+        }
+        claimed[entry - entries] = 1;
+        labelled[i] = 1;
+        claims[*claims_size] = claim;
+        *claims_size += 1;
+    }
+
+    for (int i = 0; i < windows_size; i++) {
+        if (labelled[i]) continue;
+        int best = -1;
+        for (int e = 0; e < entries_size; e++) {
+            if (claimed[e] || entries[e].class != classes[i]) continue;
+            if (best == -1 || entries[e].used > entries[best].used) best = e;
+        }
+        if (best == -1) continue;
+        _label_claim_t claim = { i, entries[best].used, 0,
+                                 entries[best].length, { 0 } };
+        if (_label_store_keys(&(entries[best]), alphabet, alphabet_size,
+                              claim.keys) != 0) {
+            continue;
+        }
+        claimed[best] = 1;
+        claims[*claims_size] = claim;
+        *claims_size += 1;
+    }
+
+    for (int e = 0; e < entries_size; e++) {
+        if (claimed[e] || clock - entries[e].used >= LABEL_STORE_RESERVE_AGE) {
+            continue;
+        }
+        uint32_t* present = bsearch(&(entries[e].window), sorted_windows,
+                                    windows_size, sizeof(uint32_t),
+                                    _label_store_compare_windows);
+        _label_claim_t claim = { -1, entries[e].used, 0, entries[e].length,
+                                 { 0 } };
+        // a window ID that's been reused by another application
+        if (present != NULL || _label_store_keys(
+            &(entries[e]), alphabet, alphabet_size, claim.keys) != 0) {
+            continue;
+        }
+        claims[*claims_size] = claim;
+        *claims_size += 1;
+    }
+}
+
+
+/**
+ * Give labels to windows without a claim, keeping as many claims as possible.
+ *
+ * claims: the claims; reordered so the ones kept come first, by priority
+ * claims_size: number of items in `claims`
+ * labels (output): for each window, its label
+ *
+ * returns: 0 on success, -1 if memory can't be allocated
+ */
+int _label_store_fill (_label_claim_t* claims, int claims_size,
+                       int windows_size, int alphabet_size,
+                       _label_claim_t* labels) {
+    _label_trie_t trie;
+    char* labelled = calloc(windows_size, 1);
+    _label_claim_t* slots = NULL;
+    int status = -1;
+    if (labelled == NULL || _label_trie_create(&trie, alphabet_size) != 0) {
+        free(labelled);
+        return -1;
+    }
+
+    qsort(claims, claims_size, sizeof(_label_claim_t),
+          _label_store_compare_claims);
+    for (int c = 0; c < claims_size; c++) {
+        int added = _label_trie_insert(&trie, &(claims[c]), c);
+        if (added == -1) goto end;
+        if (added == 1 && claims[c].window != -1) {
+            labels[claims[c].window] = claims[c];
+            labelled[claims[c].window] = 1;
+        }
+    }
+    int unlabelled_size = 0;
+    for (int i = 0; i < windows_size; i++) {
+        if (!labelled[i]) unlabelled_size += 1;
+    }
+
+    // every node has `alphabet_size` possible children, splitting a slot
+    // adds `alphabet_size - 1`, and at most one label is given up
+    int slots_capacity = (trie.nodes_size + 2 + unlabelled_size) *
+                         alphabet_size;
+    slots = malloc(slots_capacity * sizeof(_label_claim_t));
+    if (slots == NULL) goto end;
+    int slots_size;
+    _label_trie_slots(&trie, slots, &slots_size);
+
+    // give up the least important labels until there's somewhere to put the
+    // rest, starting with reservations
+    for (int c = claims_size - 1;
+         slots_size == 0 && unlabelled_size > 0 && c >= 0; c--) {
+        if (claims[c].node == 0) continue;
+        trie.claims[claims[c].node] = -1;
+        if (claims[c].window != -1) {
+            labelled[claims[c].window] = 0;
+            unlabelled_size += 1;
+        }
+        _label_trie_slots(&trie, slots, &slots_size);
+    }
+
+    // split the shortest slot until there are enough
+    while (slots_size < unlabelled_size) {
+        int shortest = -1;
+        for (int s = 0; s < slots_size; s++) {
+            if (slots[s].length < LABEL_STORE_LABEL_MAX &&
+                (shortest == -1 || slots[s].length < slots[shortest].length)) {
+                shortest = s;
+            }
+        }
+        if (shortest == -1) goto end;
+        _label_claim_t slot = slots[shortest];
+        slots[shortest] = slots[slots_size - 1];
+        slots_size -= 1;
+        for (int k = 0; k < alphabet_size; k++) {
+            slots[slots_size] = slot;
+            slots[slots_size].keys[slot.length] = k;
+            slots[slots_size].length = slot.length + 1;
+            slots_size += 1;
+        }
+    }
+
+    qsort(slots, slots_size, sizeof(_label_claim_t),
+          _label_store_compare_slots);
+    int s = 0;
+    for (int i = 0; i < windows_size; i++) {
+        if (labelled[i]) continue;
+        labels[i] = slots[s];
+        labels[i].window = i;
+        s += 1;
+    }
+    status = 0;
+
+end:
+    free(slots);
+    free(labelled);
+    _label_trie_free(&trie);
+    return status;
+}
+
+
+/**
+ * Fill in a label plan.
+ *
+ * labels: for each window, its label
+ *
+ * returns: 0 on success, -1 if memory can't be allocated
+ */
+int _label_store_plan (_label_claim_t* labels, int windows_size,
+                       label_plan_t* plan) {
+    label_plan_t result = { windows_size, 0, NULL, NULL, NULL };
+    for (int i = 0; i < windows_size; i++) {
+        if (labels[i].length > result.max_length) {
+            result.max_length = labels[i].length;
+        }
+    }
+    result.lengths = calloc(windows_size, sizeof(int));
+    result.keys = calloc((size_t)windows_size * result.max_length, 1);
+    result.order = calloc(windows_size, sizeof(int));
+    _label_claim_t* sorted = calloc(windows_size, sizeof(_label_claim_t));
+    if (result.lengths == NULL || result.keys == NULL ||
+        result.order == NULL || sorted == NULL) {
+        free(sorted);
+        label_plan_free(&result);
+        return -1;
+    }
+
+    for (int i = 0; i < windows_size; i++) {
+        result.lengths[i] = labels[i].length;
+        memcpy(label_plan_label(&result, i), labels[i].keys,
+               labels[i].length);
+        sorted[i] = labels[i];
+    }
+    // labels are prefix-free, so comparing keys alone puts them in order
+    for (int i = 0; i < windows_size; i++) {
+        memset(sorted[i].keys + sorted[i].length, 0,
+               LABEL_STORE_LABEL_MAX - sorted[i].length);
+        sorted[i].length = LABEL_STORE_LABEL_MAX;
+    }
+    qsort(sorted, windows_size, sizeof(_label_claim_t),
+          _label_store_compare_slots);
+    for (int i = 0; i < windows_size; i++) result.order[i] = sorted[i].window;
+    free(sorted);
+    *plan = result;
+    return 0;
+}
+
+
+/**
+ * Write the remembered labels: one entry for each window, and those of windows
+ * that have gone, unless they're too old or their labels were given away.
+ *
+ * entries: the old entries; reordered
+ * claimed: for each entry, whether it was claimed by a window
+ * labels: for each window, its label
+ *
+ * returns: 0 on success, -1 on failure
+ */
+int _label_store_save (label_store_t* store, _label_store_entry_t* entries,
+                       int entries_size, char* claimed, uint32_t clock,
+                       uint32_t* windows, uint32_t* sorted_windows,
+                       uint32_t* classes, int windows_size,
+                       char* alphabet, int alphabet_size,
+                       _label_claim_t* labels) {
+    _label_trie_t trie;
+    if (_label_trie_create(&trie, alphabet_size) != 0) return -1;
+    for (int i = 0; i < windows_size; i++) {
+        if (_label_trie_insert(&trie, &(labels[i]), i) == -1) {
+            _label_trie_free(&trie);
+            return -1;
+        }
+    }
+
+    // keep old entries that are still useful, most recent first
+    int kept_size = 0;
+    for (int e = 0; e < entries_size; e++) {
+        unsigned char keys[LABEL_STORE_LABEL_MAX];
+        int depth;
+        if (claimed[e] || clock - entries[e].used >= LABEL_STORE_FORGET_AGE ||
+            bsearch(&(entries[e].window), sorted_windows, windows_size,
+                    sizeof(uint32_t), _label_store_compare_windows) != NULL) {
+            continue;
+        }
+        // labels with other characters don't clash with this alphabet
+        if (_label_store_keys(&(entries[e]), alphabet, alphabet_size,
+                              keys) == 0 &&
+            _label_trie_find(&trie, keys, entries[e].length, &depth) == -1) {
+            continue;
+        }
+        entries[kept_size] = entries[e];
+        kept_size += 1;
+    }
+    _label_trie_free(&trie);
+    int max_kept = LABEL_STORE_MAX_ENTRIES - windows_size;
+    if (kept_size > max_kept) {
+        qsort(entries, kept_size, sizeof(_label_store_entry_t),
+              _label_store_compare_used);
+        kept_size = max_kept > 0 ? max_kept : 0;
+    }
+
+    int size = windows_size + kept_size;
+    _label_store_entry_t* new_entries = calloc(size > 0 ? size : 1,
+                                               sizeof(_label_store_entry_t));
+    if (new_entries == NULL) return -1;
+    for (int i = 0; i < windows_size; i++) {
+        _label_store_entry_t entry = {
+            windows[i], classes[i], clock, labels[i].length, { 0 }
+        };
+        for (int d = 0; d < labels[i].length; d++) {
+            entry.label[d] = alphabet[labels[i].keys[d]];
+        }
+        new_entries[i] = entry;
+    }
+    memcpy(new_entries + windows_size, entries,
+           kept_size * sizeof(_label_store_entry_t));
+    qsort(new_entries, size, sizeof(_label_store_entry_t),
+          _label_store_compare_entries);
+
+    size_t file_size = (sizeof(_label_store_header_t) +
+                        size * sizeof(_label_store_entry_t));
+    if (_label_store_remap(store, file_size) != 0) {
+        free(new_entries);
+        return -1;
+    }
+    _label_store_header_t header = { { 0 }, LABEL_STORE_VERSION, clock, size };
+    memcpy(header.magic, LABEL_STORE_MAGIC, 4);
+    memcpy(store->map, &header, sizeof(header));
+    memcpy(store->map + sizeof(header), new_entries,
+           size * sizeof(_label_store_entry_t));
+    free(new_entries);
+    return 0;
+}
+
+
+// -- public functions
+
+int label_store_open (char* path, label_store_t* store) {
+    label_store_t result = { -1, NULL, 0 };
+    result.fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (result.fd == -1) return -1;
+    *store = result;
+    return 0;
+}
+
+
+void label_store_close (label_store_t* store) {
+    if (store->map != NULL) munmap(store->map, store->map_size);
+    close(store->fd);
+    store->map = NULL;
+    store->map_size = 0;
+    store->fd = -1;
+}
+
+
+uint32_t label_store_hash (char* data, size_t size) {
+    // FNV-1a
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < size; i++) {
+        h ^= (unsigned char)data[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+
+int label_store_assign (label_store_t* store, uint32_t* windows,
+                        uint32_t* classes, int windows_size,
+                        char* alphabet, int alphabet_size, int save,
+                        label_plan_t* plan) {
+    if (windows_size < 1 || alphabet_size < 2 || alphabet_size > 256) {
+        return -1;
+    }
+    // another process may be assigning labels with the same store
+    flock(store->fd, LOCK_EX);
+    int status = -1;
+    uint32_t clock;
+    int entries_size = 0;
+    _label_store_entry_t* entries = NULL;
+    uint32_t* sorted_windows = NULL;
+    char* claimed = NULL;
+    char* labelled = NULL;
+    _label_claim_t* claims = NULL;
+    _label_claim_t* labels = NULL;
+
+    // the file may be replaced while we're using it, so work on a copy
+    if (_label_store_remap(store, 0) == 0) {
+        _label_store_entry_t* mapped = _label_store_entries(
+            store, &clock, &entries_size);
+        entries = malloc((entries_size > 0 ? entries_size : 1) *
+                         sizeof(_label_store_entry_t));
+        if (entries == NULL) goto end;
+        if (entries_size > 0) {
+            memcpy(entries, mapped,
+                   entries_size * sizeof(_label_store_entry_t));
+        }
+    } else {
+        clock = 0;
+        entries = malloc(sizeof(_label_store_entry_t));
+        if (entries == NULL) goto end;
+    }
+    if (save) clock += 1;
+
+    sorted_windows = malloc(windows_size * sizeof(uint32_t));
+    claimed = calloc(entries_size > 0 ? entries_size : 1, 1);
+    labelled = calloc(windows_size, 1);
+    claims = calloc(windows_size + entries_size, sizeof(_label_claim_t));
+    labels = calloc(windows_size, sizeof(_label_claim_t));
+    if (sorted_windows == NULL || claimed == NULL || labelled == NULL ||
+        claims == NULL || labels == NULL) {
+        goto end;
+    }
+    memcpy(sorted_windows, windows, windows_size * sizeof(uint32_t));
+    qsort(sorted_windows, windows_size, sizeof(uint32_t),
+          _label_store_compare_windows);
+
+    int claims_size;
+    _label_store_claim(entries, entries_size, clock, windows, sorted_windows,
+                       classes, windows_size, alphabet, alphabet_size,
+                       claims, &claims_size, claimed, labelled);
+    if (_label_store_fill(claims, claims_size, windows_size, alphabet_size,
+                          labels) != 0 ||
+        _label_store_plan(labels, windows_size, plan) != 0) {
+        goto end;
+    }
+    status = 0;
+    if (save) {
+        _label_store_save(store, entries, entries_size, claimed, clock,
+                          windows, sorted_windows, classes, windows_size,
+                          alphabet, alphabet_size, labels);
+    }
+
+end:
+    flock(store->fd, LOCK_UN);
+    free(entries);
+    free(sorted_windows);
+    free(claimed);
+    free(labelled);
+    free(claims);
+    free(labels);
+    return status;
+}
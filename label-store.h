@@ -0,0 +1,103 @@
+/*
+
+Licensed under the Apache License, Version 2.0 (the "License"); you may not use
+this file except in compliance with the License. You may obtain a copy of the
+License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software distributed
+under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+CONDITIONS OF ANY KIND, either express or implied. See the License for the
+specific language governing permissions and limitations under the License.
+
+*/
+
+#ifndef XCW_LABEL_STORE_H
+#define XCW_LABEL_STORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "label-plan.h"
+
+
+// -- types
+
+/**
+ * Labels remembered across runs, so that a window keeps its label.  Stored in
+ * a file mapped into memory, which holds a header followed by one fixed-size
+ * entry per window, sorted by window ID (see label-store.c).  The file is
+ * rewritten without forgotten entries every time labels are assigned.
+ *
+ * fd: the open file, locked while labels are assigned
+ * map: the mapped file, or NULL if it's empty
+ * map_size: size of `map`
+ */
+typedef struct label_store_t {
+    int fd;
+    unsigned char* map;
+    size_t map_size;
+} label_store_t;
+
+
+// -- functions
+
+/**
+ * Open a label store, creating the file if it doesn't exist.  A file that
+ * isn't a label store, or is from an incompatible version, is treated as
+ * empty, and overwritten when labels are assigned.
+ *
+ * path: the file
+ * store (output): the result; should be closed with `label_store_close`
+ *
+ * returns: 0 on success, -1 if the file can't be opened (with `errno` set)
+ */
+int label_store_open (char* path, label_store_t* store);
+
+/**
+ * Close a label store.
+ */
+void label_store_close (label_store_t* store);
+
+/**
+ * Hash the application a window belongs to, for `label_store_assign`.
+ *
+ * data: bytes identifying the application, such as WM_CLASS
+ */
+uint32_t label_store_hash (char* data, size_t size);
+
+/**
+ * Assign labels to windows, keeping each window's remembered label where
+ * possible, and remember the result.
+ *
+ * A window keeps its label if it was seen with the same application before.
+ * A window seen for the first time takes the label of a window of the same
+ * application that has gone, if there is one, so restarting a program keeps
+ * its label.  Recently seen windows that have gone keep their labels reserved
+ * for a while, so that windows can come and go (such as when switching
+ * desktops) without disturbing each other.  Other windows get the shortest
+ * labels that don't clash with those; only when there are none left is the
+ * least recently used label given up, and split into longer ones.
+ *
+ * Unlike with `label_plan_create`, a prefix shared by some labels may be
+ * followed by any keys, not just the first few.
+ *
+ * windows: window IDs
+ * classes: for each of `windows`, the result of `label_store_hash`
+ * alphabet: characters that keys are indices into; if it changes, remembered
+ *     labels with characters not in it are forgotten
+ * alphabet_size: number of characters in `alphabet`, at least 2
+ * save: whether to remember the result; if not, the store isn't changed
+ * plan (output): the labels; should be freed with `label_plan_free`
+ *
+ * returns: 0 on success, -1 if arguments are invalid or memory can't be
+ *     allocated; the store is unchanged on failure, but failing to write it
+ *     doesn't make this fail
+ */
+int label_store_assign (label_store_t* store, uint32_t* windows,
+                        uint32_t* classes, int windows_size,
+                        char* alphabet, int alphabet_size, int save,
+                        label_plan_t* plan);
+
+
+#endif
@@ -0,0 +1,191 @@
+/*
+
+Licensed under the Apache License, Version 2.0 (the "License"); you may not use
+this file except in compliance with the License. You may obtain a copy of the
+License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software distributed
+under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+CONDITIONS OF ANY KIND, either express or implied. See the License for the
+specific language governing permissions and limitations under the License.
+
+*/
+
+#include <time.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "title-index.h"
+
+
+/**
+ * Numbers of titles to index.
+ */
+int TITLES_SIZES[] = { 100, 1000, 10000, 100000 };
+int TITLES_SIZES_SIZE = sizeof(TITLES_SIZES) / sizeof(*TITLES_SIZES);
+/**
+ * Words that titles are made of.
+ */
+char* WORDS[] = {
+    "Firefox", "Terminal", "README", "main.c", "Inbox", "Makefile", "Music",
+    "Settings", "Downloads", "Calendar", "report", "draft", "notes", "build",
+    "review", "Chat", "Editor", "Video", "photos", "invoice", "server", "logs",
+    "index.html", "todo", "budget.ods", "slides", "home", "Mozilla", "vim",
+    "Documents", "meeting", "xorg"
+};
+int WORDS_SIZE = sizeof(WORDS) / sizeof(*WORDS);
+/**
+ * Queries typed one character at a time.  The last one matches nothing.
+ */
+char* QUERIES[] = { "firefox", "main", "ox", "notes 1", "report - v", "zzz" };
+int QUERIES_SIZE = sizeof(QUERIES) / sizeof(*QUERIES);
+/**
+ * Minimum total time spent searching for each case, in seconds.
+ */
+double MIN_TIME = 0.1;
+
+
+/**
+ * Get the current time in seconds.
+ */
+double now () {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+/**
+ * Make up titles like 'notes 12 - Editor'.  They're pseudo-random, but the
+ * same for every run.
+ *
+ * returns: allocated titles; each should be freed
+ */
+char** make_titles (int titles_size) {
+    char** titles = calloc(titles_size, sizeof(char*));
+    unsigned int seed = 1;
+    for (int i = 0; i < titles_size; i++) {
+        char title[64];
+        seed = seed * 1103515245 + 12345;
+        char* first = WORDS[(seed >> 8) % WORDS_SIZE];
+        seed = seed * 1103515245 + 12345;
+        char* second = WORDS[(seed >> 8) % WORDS_SIZE];
+        snprintf(title, sizeof(title), "%s %d - %s", first, i % 100, second);
+        titles[i] = strdup(title);
+    }
+    return titles;
+}
+
+
+/**
+ * Find matching titles without the index, for checking results.
+ *
+ * lower: `titles` in lower case
+ * query: in lower case
+ * matches (output): as for `title_index_search`
+ *
+ * returns: number of items in `matches`
+ */
+int search_slowly (char** lower, int titles_size, char* query, int* matches) {
+    int size = 0;
+    for (int i = 0; i < titles_size; i++) {
+        if (strstr(lower[i], query) != NULL) {
+            matches[size] = i;
+            size += 1;
+        }
+    }
+    return size;
+}
+
+
+/**
+ * Time building an index and typing each query, and check the results.
+ *
+ * returns: 0 if the results are correct, 1 otherwise
+ */
+int bench_case (int titles_size) {
+    char** titles = make_titles(titles_size);
+    char** lower = calloc(titles_size, sizeof(char*));
+    for (int i = 0; i < titles_size; i++) {
+        lower[i] = strdup(titles[i]);
+        for (char* c = lower[i]; *c != '\0'; c++) {
+            if (*c >= 'A' && *c <= 'Z') *c += 'a' - 'A';
+        }
+    }
+    // one result per prefix of a query, so no typed character waits for
+    // memory to be allocated
+    int* results = calloc((size_t)titles_size * 16, sizeof(int));
+    int* expected = calloc(titles_size, sizeof(int));
+    char* problem = NULL;
+
+    title_index_t index;
+    double start = now();
+    if (title_index_create(titles, titles_size, &index) != 0) {
+        problem = "title_index_create failed";
+    }
+    double build_time = now() - start;
+
+    double elapsed = 0;
+    double slowest = 0;
+    int keys = 0;
+    while (problem == NULL && elapsed < MIN_TIME) {
+        for (int q = 0; q < QUERIES_SIZE && problem == NULL; q++) {
+            char query[16] = { 0 };
+            int query_size = strlen(QUERIES[q]);
+            int* candidates = NULL;
+            int candidates_size = 0;
+            for (int k = 0; k < query_size; k++) {
+                query[k] = QUERIES[q][k];
+                int* matches = results + (size_t)titles_size * k;
+                double key_start = now();
+                int size = title_index_search(&index, query, candidates,
+                                              candidates_size, matches);
+                double key_time = now() - key_start;
+                elapsed += key_time;
+                if (key_time > slowest) slowest = key_time;
+                keys += 1;
+
+                int expected_size = search_slowly(lower, titles_size, query,
+                                                  expected);
+                if (size != expected_size ||
+                    memcmp(matches, expected, size * sizeof(int)) != 0) {
+                    problem = "wrong matches";
+                    break;
+                }
+                candidates = matches;
+                candidates_size = size;
+            }
+        }
+    }
+
+    if (problem == NULL) {
+        printf("%7d %10.2f %9.2f %9.2f  ok\n", titles_size, build_time * 1e3,
+               elapsed / keys * 1e6, slowest * 1e6);
+        title_index_free(&index);
+    } else {
+        printf("%7d  error: %s\n", titles_size, problem);
+        if (index.texts != NULL) title_index_free(&index);
+    }
+    for (int i = 0; i < titles_size; i++) {
+        free(titles[i]);
+        free(lower[i]);
+    }
+    free(titles);
+    free(lower);
+    free(results);
+    free(expected);
+    return problem == NULL ? 0 : 1;
+}
+
+
+int main () {
+    int failures = 0;
+    printf("%7s %10s %9s %9s  %s\n", "titles", "build (ms)", "key (us)",
+           "max (us)", "check");
+    for (int t = 0; t < TITLES_SIZES_SIZE; t++) {
+        failures += bench_case(TITLES_SIZES[t]);
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,196 @@
+/*
+
+Licensed under the Apache License, Version 2.0 (the "License"); you may not use
+this file except in compliance with the License. You may obtain a copy of the
+License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software distributed
+under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+CONDITIONS OF ANY KIND, either express or implied. See the License for the
+specific language governing permissions and limitations under the License.
+
+*/
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "title-index.h"
+
+
+// -- constants
+
+/**
+ * Number of buckets trigrams are hashed into.  Must be 2^16, since bucket
+ * numbers are the top 16 bits of a 32-bit hash.
+ */
+#define TITLE_INDEX_BUCKETS 65536
+
+
+// -- utilities
+
+/**
+ * Make a copy of a text with ASCII letters in lower case.  Other bytes, such as
+ * those in multi-byte UTF-8 characters, are kept.
+ *
+ * returns: the allocated copy, or NULL if memory can't be allocated
+ */
+char* _title_index_lower (char* text) {
+    char* lower = strdup(text);
+    if (lower == NULL) return NULL;
+    for (char* c = lower; *c != '\0'; c++) {
+        if (*c >= 'A' && *c <= 'Z') *c += 'a' - 'A';
+    }
+    return lower;
+}
+
+
+/**
+ * Get the bucket for the trigram at the start of some text.
+ *
+ * trigram: at least 3 bytes, in lower case
+ */
+int _title_index_bucket (char* trigram) {
+    uint32_t h = ((uint32_t)(unsigned char)trigram[0] << 16 |
+                  (uint32_t)(unsigned char)trigram[1] << 8 |
+                  (uint32_t)(unsigned char)trigram[2]);
+    // Fibonacci hashing: the top bits of the product are well mixed
+    return (uint32_t)(h * 2654435761u) >> 16;
+}
+
+
+/**
+ * Add each text to the buckets of its trigrams, once per bucket.  Called
+ * twice: first to count the texts in each bucket (with `postings` NULL), then
+ * to fill in `postings`.
+ *
+ * last: for each bucket, scratch space used to skip repeated trigrams
+ *
+ * returns: total number of texts added to buckets
+ */
+int _title_index_fill (title_index_t* index, int* last) {
+    int total = 0;
+    for (int b = 0; b < TITLE_INDEX_BUCKETS; b++) last[b] = -1;
+    for (int t = 0; t < index->texts_size; t++) {
+        char* text = index->texts[t];
+        int size = strlen(text);
+        for (int i = 0; i + 3 <= size; i++) {
+            int b = _title_index_bucket(text + i);
+            if (last[b] == t) continue;
+            last[b] = t;
+            if (index->postings != NULL) {
+                index->postings[index->buckets_start[b] +
+                                index->buckets_size[b]] = t;
+            }
+            index->buckets_size[b] += 1;
+            total += 1;
+        }
+    }
+    return total;
+}
+
+
+// -- public functions
+
+int title_index_create (char** texts, int texts_size, title_index_t* index) {
+    memset(index, 0, sizeof(title_index_t));
+    index->texts = calloc(texts_size > 0 ? texts_size : 1, sizeof(char*));
+    index->buckets_start = calloc(TITLE_INDEX_BUCKETS, sizeof(int));
+    index->buckets_size = calloc(TITLE_INDEX_BUCKETS, sizeof(int));
+    int* last = calloc(TITLE_INDEX_BUCKETS, sizeof(int));
+    if (index->texts == NULL || index->buckets_start == NULL ||
+        index->buckets_size == NULL || last == NULL) {
+        free(last);
+        title_index_free(index);
+        return -1;
+    }
+    for (int t = 0; t < texts_size; t++) {
+        index->texts[t] = _title_index_lower(texts[t]);
+        index->texts_size += 1;
+        if (index->texts[t] == NULL) {
+            free(last);
+            title_index_free(index);
+            return -1;
+        }
+    }
+
+    // lay out the buckets one after another, then fill them
+    int total = _title_index_fill(index, last);
+    int start = 0;
+    for (int b = 0; b < TITLE_INDEX_BUCKETS; b++) {
+        index->buckets_start[b] = start;
+        start += index->buckets_size[b];
+        index->buckets_size[b] = 0;
+    }
+    index->postings = calloc(total > 0 ? total : 1, sizeof(int));
+    if (index->postings == NULL) {
+        free(last);
+        title_index_free(index);
+        return -1;
+    }
+    _title_index_fill(index, last);
+
+    free(last);
+    return 0;
+}
+
+
+void title_index_free (title_index_t* index) {
+    for (int t = 0; t < index->texts_size; t++) free(index->texts[t]);
+    free(index->texts);
+    free(index->buckets_start);
+    free(index->buckets_size);
+    free(index->postings);
+    memset(index, 0, sizeof(title_index_t));
+}
+
+
+int title_index_search (title_index_t* index, char* query,
+                        int* candidates, int candidates_size, int* matches) {
+    char* lower = _title_index_lower(query);
+    if (lower == NULL) return 0;
+    int query_size = strlen(lower);
+
+    // the smallest bucket of any of the query's trigrams
+    int* bucket = NULL;
+    int bucket_size = 0;
+    for (int i = 0; i + 3 <= query_size; i++) {
+        int b = _title_index_bucket(lower + i);
+        if (bucket == NULL || index->buckets_size[b] < bucket_size) {
+            bucket = index->postings + index->buckets_start[b];
+            bucket_size = index->buckets_size[b];
+        }
+    }
+
+    int size = 0;
+    if (bucket != NULL &&
+        (candidates == NULL || bucket_size < candidates_size)) {
+        // both lists are in ascending order
+        int c = 0;
+        for (int i = 0; i < bucket_size; i++) {
+            int t = bucket[i];
+            if (candidates != NULL) {
+                while (c < candidates_size && candidates[c] < t) c += 1;
+                if (c == candidates_size) break;
+                if (candidates[c] != t) continue;
+            }
+            if (strstr(index->texts[t], lower) != NULL) {
+                matches[size] = t;
+                size += 1;
+            }
+        }
+    } else {
+        int n = candidates == NULL ? index->texts_size : candidates_size;
+        for (int i = 0; i < n; i++) {
+            int t = candidates == NULL ? i : candidates[i];
+            if (strstr(index->texts[t], lower) != NULL) {
+                matches[size] = t;
+                size += 1;
+            }
+        }
+    }
+
+    free(lower);
+    return size;
+}
@@ -0,0 +1,84 @@
+/*
+
+Licensed under the Apache License, Version 2.0 (the "License"); you may not use
+this file except in compliance with the License. You may obtain a copy of the
+License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software distributed
+under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+CONDITIONS OF ANY KIND, either express or implied. See the License for the
+specific language governing permissions and limitations under the License.
+
+*/
+
+#ifndef XCW_TITLE_INDEX_H
+#define XCW_TITLE_INDEX_H
+
+
+// -- types
+
+/**
+ * An index for finding the texts that contain a query, ignoring ASCII case.
+ *
+ * Every trigram (3 consecutive bytes) of every text is hashed into a bucket,
+ * and each bucket lists the texts with a trigram in it.  A text containing the
+ * query must be listed in the bucket of each of the query's trigrams, so only
+ * the texts in the smallest of those buckets need checking.  Hash collisions
+ * only make buckets larger, since every text found is checked.
+ *
+ * texts: lower-case copies of the indexed texts
+ * texts_size: number of texts
+ * buckets_start: for each bucket, the index in `postings` of its first text;
+ *     has size `TITLE_INDEX_BUCKETS` (see title-index.c)
+ * buckets_size: for each bucket, the number of texts in it
+ * postings: indices of texts in each bucket, in ascending order
+ */
+typedef struct title_index_t {
+    char** texts;
+    int texts_size;
+    int* buckets_start;
+    int* buckets_size;
+    int* postings;
+} title_index_t;
+
+
+// -- functions
+
+/**
+ * Build an index.  Takes time linear in the total size of the texts.
+ *
+ * texts: null-terminated texts to index; copied
+ * index (output): the result; should be freed with `title_index_free`
+ *
+ * returns: 0 on success, -1 if memory can't be allocated
+ */
+int title_index_create (char** texts, int texts_size, title_index_t* index);
+
+/**
+ * Free memory used by an index.
+ */
+void title_index_free (title_index_t* index);
+
+/**
+ * Find the texts that contain a query, ignoring ASCII case.  Typing a query one
+ * character at a time should pass the result for the previous query as
+ * `candidates`, since a text containing the longer query must also contain the
+ * shorter one; the work done is at most proportional to the number of
+ * candidates.
+ *
+ * query: null-terminated text to look for
+ * candidates: indices of texts to consider, in ascending order, or NULL to
+ *     consider every text
+ * candidates_size: size of `candidates`, if not NULL
+ * matches (output): indices of texts containing `query`, in ascending order;
+ *     must have room for every candidate
+ *
+ * returns: number of items in `matches`
+ */
+int title_index_search (title_index_t* index, char* query,
+                        int* candidates, int candidates_size, int* matches);
+
+
+#endif
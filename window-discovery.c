@@ -0,0 +1,883 @@
+/*
+
+Licensed under the Apache License, Version 2.0 (the "License"); you may not use
+this file except in compliance with the License. You may obtain a copy of the
+License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software distributed
+under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+CONDITIONS OF ANY KIND, either express or implied. See the License for the
+specific language governing permissions and limitations under the License.
+
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include "window-discovery.h"
+
+
+// -- constants
+
+/**
+ * Maximum number of atoms read from a window's _NET_WM_STATE, or its
+ * _NET_WM_WINDOW_TYPE when a filter needs all of them.
+ */
+uint32_t DISCOVERY_MAX_ATOMS = 32;
+/**
+ * Maximum length of WM_CLASS read, in 4-byte units.
+ */
+uint32_t DISCOVERY_MAX_CLASS = 64;
+/**
+ * Maximum length of _NET_WM_NAME and WM_NAME read, in 4-byte units.
+ */
+uint32_t DISCOVERY_MAX_NAME = 64;
+
+
+// -- utilities
+
+/**
+ * Record that a request failed.  Only the first failure is kept, since later
+ * ones are usually caused by it.
+ */
+void _discovery_fail (discovery_t* discovery, char* error) {
+    if (discovery->error == NULL) discovery->error = error;
+}
+
+
+/**
+ * Determine whether a window is in the list of windows.
+ */
+int _discovery_contains_window (xcb_window_t* windows, int windows_size,
+                                xcb_window_t window) {
+    for (int i = 0; i < windows_size; i++) {
+        if (windows[i] == window) return 1;
+    }
+    return 0;
+}
+
+
+/**
+ * Remove a rectangle from a region.
+ *
+ * region: non-overlapping rectangles making up the region; replaced by a new
+ *     array, and the old one is freed
+ * region_size: size of `region`, updated
+ * r: rectangle to remove
+ */
+void _discovery_region_subtract (xcb_rectangle_t** region, int* region_size,
+                                 xcb_rectangle_t* r) {
+    // each rectangle splits into at most 4
+    xcb_rectangle_t* result = calloc(*region_size * 4, sizeof(xcb_rectangle_t));
+    int size = 0;
+    int rx1 = r->x, ry1 = r->y;
+    int rx2 = r->x + r->width, ry2 = r->y + r->height;
+
+    for (int i = 0; i < *region_size; i++) {
+        xcb_rectangle_t* a = &((*region)[i]);
+        int ax1 = a->x, ay1 = a->y;
+        int ax2 = a->x + a->width, ay2 = a->y + a->height;
+        if (rx1 >= ax2 || rx2 <= ax1 || ry1 >= ay2 || ry2 <= ay1) {
+            result[size] = *a;
+            size += 1;
+            continue;
+        }
+
+        // bands above and below `r`, then to the left and right of it
+        int my1 = ay1 > ry1 ? ay1 : ry1, my2 = ay2 < ry2 ? ay2 : ry2;
+        xcb_rectangle_t pieces[] = {
+            { ax1, ay1, ax2 - ax1, ry1 > ay1 ? ry1 - ay1 : 0 },
+            { ax1, ry2, ax2 - ax1, ay2 > ry2 ? ay2 - ry2 : 0 },
+            { ax1, my1, rx1 > ax1 ? rx1 - ax1 : 0, my2 - my1 },
+            { rx2, my1, ax2 > rx2 ? ax2 - rx2 : 0, my2 - my1 }
+        };
+        for (int j = 0; j < 4; j++) {
+            if (pieces[j].width > 0 && pieces[j].height > 0) {
+                result[size] = pieces[j];
+                size += 1;
+            }
+        }
+    }
+
+    free(*region);
+    *region = result;
+    *region_size = size;
+}
+
+
+/**
+ * Find the largest rectangle in a region.
+ *
+ * region_size: size of `region`; must be at least 1
+ */
+xcb_rectangle_t _discovery_region_largest (xcb_rectangle_t* region,
+                                           int region_size) {
+    int largest = 0;
+    for (int i = 1; i < region_size; i++) {
+        if (region[i].width * region[i].height >
+            region[largest].width * region[largest].height) {
+            largest = i;
+        }
+    }
+    return region[largest];
+}
+
+
+// -- requests
+
+/**
+ * Get windows managed by the window manager.
+ *
+ * request: get_property request for _NET_CLIENT_LIST on the root window
+ * is_defined (output): whether the window manager defines the windows it
+ *     tracks; if 0, `windows` and `windows_size` will not be set
+ * windows (output): window IDs
+ * windows_size (output): size of `windows`
+ *
+ * returns: 0 on success, -1 on failure
+ */
+int _discovery_get_managed_windows (discovery_t* discovery,
+                                    unsigned int request, int* is_defined,
+                                    xcb_window_t** windows, int* windows_size) {
+    x_backend_t* b = discovery->backend;
+    xcb_atom_t type;
+    void* value;
+    int value_length;
+    if (b->get_property_reply(b->data, request, &type,
+                              &value, &value_length) != 0) {
+        _discovery_fail(discovery, "get_property _NET_CLIENT_LIST");
+        return -1;
+    }
+    // the property's type is None if it doesn't exist
+    *is_defined = type != XCB_NONE;
+    if (*is_defined) {
+        *windows = value;
+        // each window ID is 4 bytes
+        *windows_size = value_length / 4;
+    } else {
+        free(value);
+    }
+    return 0;
+}
+
+
+/**
+ * Find client windows (those with the WM_STATE property) by searching down the
+ * window tree breadth-first, starting from the children of the root window.
+ * Requests for each level of the tree are sent together, so this costs a round
+ * trip per level.  For a top-level window with no client window in its
+ * subtree, the top-level window itself is used (as with a window manager that
+ * doesn't set WM_STATE).
+ *
+ * tops: children of the root window, bottom first
+ * clients (output): client windows, ordered like `tops`
+ * client_tops (output): for each of `clients`, the item in `tops` that
+ *     contains it
+ * clients_size (output): size of `clients`
+ */
+void _discovery_find_clients (discovery_t* discovery,
+                              xcb_window_t* tops, int tops_size,
+                              xcb_window_t** clients, xcb_window_t** client_tops,
+                              int* clients_size) {
+    x_backend_t* b = discovery->backend;
+    // windows to search at the current level, with the index in `tops` of the
+    // top-level window containing them
+    xcb_window_t* level = calloc(tops_size, sizeof(xcb_window_t));
+    int* level_tops = calloc(tops_size, sizeof(int));
+    int level_size = tops_size;
+    for (int i = 0; i < tops_size; i++) {
+        level[i] = tops[i];
+        level_tops[i] = i;
+    }
+    xcb_window_t* found = NULL;
+    int* found_tops = NULL;
+    int found_size = 0;
+
+    while (level_size > 0) {
+        unsigned int* gprs = calloc(level_size, sizeof(unsigned int));
+        unsigned int* qtrs = calloc(level_size, sizeof(unsigned int));
+        for (int i = 0; i < level_size; i++) {
+            // we only need to know whether the property exists
+            gprs[i] = b->get_property(b->data, level[i], discovery->wm_state,
+                                      XCB_GET_PROPERTY_TYPE_ANY, 0);
+            qtrs[i] = b->query_tree(b->data, level[i]);
+        }
+
+        xcb_window_t* next_level = NULL;
+        int* next_level_tops = NULL;
+        int next_level_size = 0;
+        for (int i = 0; i < level_size; i++) {
+            // windows may be destroyed while we search
+            xcb_atom_t type;
+            void* value;
+            int value_length;
+            int has_state = (
+                b->get_property_reply(b->data, gprs[i], &type,
+                                      &value, &value_length) == 0);
+            if (has_state) {
+                free(value);
+                has_state = type != XCB_NONE;
+            }
+            xcb_window_t* children;
+            int children_size;
+            int has_children = (
+                b->query_tree_reply(b->data, qtrs[i],
+                                    &children, &children_size) == 0);
+
+            if (has_state) {
+                found = realloc(found, sizeof(xcb_window_t) * (found_size + 1));
+                found_tops = realloc(found_tops, sizeof(int) * (found_size + 1));
+                found[found_size] = level[i];
+                found_tops[found_size] = level_tops[i];
+                found_size += 1;
+
+            } else if (has_children) {
+                int new_size = next_level_size + children_size;
+                next_level = realloc(next_level,
+                                     sizeof(xcb_window_t) * new_size);
+                next_level_tops = realloc(next_level_tops,
+                                          sizeof(int) * new_size);
+                for (int c = 0; c < children_size; c++) {
+                    next_level[next_level_size] = children[c];
+                    next_level_tops[next_level_size] = level_tops[i];
+                    next_level_size += 1;
+                }
+            }
+            if (has_children) free(children);
+        }
+
+        free(qtrs);
+        free(gprs);
+        free(level);
+        free(level_tops);
+        level = next_level;
+        level_tops = next_level_tops;
+        level_size = next_level_size;
+    }
+    free(level);
+    free(level_tops);
+
+    // group by top-level window, in stacking order: count the clients for
+    // each top-level window (at least 1, for the fallback), then place each
+    // client after those for the previous top-level windows
+    int* tops_start = calloc(tops_size + 1, sizeof(int));
+    for (int i = 0; i < found_size; i++) tops_start[found_tops[i] + 1] += 1;
+    for (int t = 0; t < tops_size; t++) {
+        int count = tops_start[t + 1] > 1 ? tops_start[t + 1] : 1;
+        tops_start[t + 1] = tops_start[t] + count;
+    }
+    *clients_size = tops_start[tops_size];
+    *clients = calloc(*clients_size, sizeof(xcb_window_t));
+    *client_tops = calloc(*clients_size, sizeof(xcb_window_t));
+    int* tops_next = calloc(tops_size, sizeof(int));
+    for (int t = 0; t < tops_size; t++) {
+        tops_next[t] = tops_start[t];
+        (*clients)[tops_start[t]] = tops[t];
+        (*client_tops)[tops_start[t]] = tops[t];
+    }
+    for (int i = 0; i < found_size; i++) {
+        int t = found_tops[i];
+        (*clients)[tops_next[t]] = found[i];
+        (*client_tops)[tops_next[t]] = tops[t];
+        tops_next[t] += 1;
+    }
+
+    free(tops_next);
+    free(tops_start);
+    free(found);
+    free(found_tops);
+}
+
+
+/**
+ * Wait for a property requested with `get_property`, recording a failure.
+ *
+ * error: describes the request, for `discovery->error`
+ * value (output): as for `x_backend_t.get_property_reply`; on failure, an
+ *     empty value is returned anyway
+ *
+ * returns: 0 on success, -1 on failure
+ */
+int _discovery_property_reply (discovery_t* discovery, unsigned int request,
+                               char* error, void** value, int* value_length) {
+    x_backend_t* b = discovery->backend;
+    xcb_atom_t type;
+    if (b->get_property_reply(b->data, request, &type,
+                              value, value_length) != 0) {
+        _discovery_fail(discovery, error);
+        *value = calloc(1, 1);
+        *value_length = 0;
+        return -1;
+    }
+    return 0;
+}
+
+
+/**
+ * Determine which windows can be chosen.  They must be viewable and not
+ * override-redirect according to the base Xorg specification, and match
+ * `discovery->filter`.  Unless the filter tests window types, they must also
+ * be a persistent application window according to EWMH: one of their types
+ * is in `discovery->normal_types`, or they have none.  Only the properties the
+ * filter needs are requested, and all requests are sent before any replies
+ * are waited for.
+ *
+ * match (output): result for each of `windows`
+ *
+ * returns: 0 on success, -1 on failure
+ */
+int _discovery_windows_match (discovery_t* discovery,
+                              xcb_window_t* windows, int windows_size,
+                              int* match) {
+    x_backend_t* b = discovery->backend;
+    filter_t* filter = discovery->filter;
+    int needs = filter == NULL ? 0 : filter->needs;
+    // a filter testing types replaces the default rule, so that it can match
+    // docks and desktops
+    int typed = needs & FILTER_NEEDS_TYPE;
+    unsigned int cdr = 0;
+    if (needs & FILTER_NEEDS_DESKTOP) {
+        cdr = b->get_property(b->data, discovery->root,
+                              discovery->current_desktop, XCB_ATOM_CARDINAL, 1);
+    }
+    unsigned int* gwars = calloc(windows_size, sizeof(unsigned int));
+    unsigned int* wtrs = calloc(windows_size, sizeof(unsigned int));
+    unsigned int* wdrs = calloc(windows_size, sizeof(unsigned int));
+    unsigned int* wsrs = calloc(windows_size, sizeof(unsigned int));
+    unsigned int* wcrs = calloc(windows_size, sizeof(unsigned int));
+    for (int i = 0; i < windows_size; i++) {
+        gwars[i] = b->get_window_attributes(b->data, windows[i]);
+        wtrs[i] = b->get_property(b->data, windows[i], discovery->window_type,
+                                  XCB_ATOM_ATOM, DISCOVERY_MAX_ATOMS);
+        if (needs & FILTER_NEEDS_DESKTOP) {
+            wdrs[i] = b->get_property(b->data, windows[i], discovery->desktop,
+                                      XCB_ATOM_CARDINAL, 1);
+        }
+        if (needs & FILTER_NEEDS_STATE) {
+            wsrs[i] = b->get_property(b->data, windows[i], discovery->state,
+                                      XCB_ATOM_ATOM, DISCOVERY_MAX_ATOMS);
+        }
+        if (needs & FILTER_NEEDS_CLASS) {
+            wcrs[i] = b->get_property(b->data, windows[i], XCB_ATOM_WM_CLASS,
+                                      XCB_ATOM_STRING, DISCOVERY_MAX_CLASS);
+        }
+    }
+
+    // every reply is waited for even after a failure
+    int status = 0;
+    // without desktops, every window is on the current one
+    int current_desktop_defined = 0;
+    uint32_t current_desktop = 0;
+    if (needs & FILTER_NEEDS_DESKTOP) {
+        void* value;
+        int value_length;
+        if (_discovery_property_reply(discovery, cdr,
+                                      "get_property _NET_CURRENT_DESKTOP",
+                                      &value, &value_length) != 0) {
+            status = -1;
+        }
+        current_desktop_defined = value_length >= 4;
+        if (current_desktop_defined) current_desktop = ((uint32_t*)value)[0];
+        free(value);
+    }
+
+    for (int i = 0; i < windows_size; i++) {
+        int viewable, override_redirect;
+        if (b->get_window_attributes_reply(b->data, gwars[i], &viewable,
+                                           &override_redirect) != 0) {
+            _discovery_fail(discovery, "get_window_attributes");
+            status = -1;
+        }
+        void* types;
+        int types_length;
+        void* desktop = NULL;
+        int desktop_length = 0;
+        void* states = NULL;
+        int states_length = 0;
+        void* class = NULL;
+        int class_length = 0;
+        if (_discovery_property_reply(discovery, wtrs[i],
+                                      "get_property _NET_WM_WINDOW_TYPE",
+                                      &types, &types_length) != 0) {
+            status = -1;
+        }
+        if ((needs & FILTER_NEEDS_DESKTOP) && _discovery_property_reply(
+            discovery, wdrs[i], "get_property _NET_WM_DESKTOP",
+            &desktop, &desktop_length
+        ) != 0) {
+            status = -1;
+        }
+        if ((needs & FILTER_NEEDS_STATE) && _discovery_property_reply(
+            discovery, wsrs[i], "get_property _NET_WM_STATE",
+            &states, &states_length
+        ) != 0) {
+            status = -1;
+        }
+        if ((needs & FILTER_NEEDS_CLASS) && _discovery_property_reply(
+            discovery, wcrs[i], "get_property WM_CLASS",
+            &class, &class_length
+        ) != 0) {
+            status = -1;
+        }
+
+        // if the type isn't defined, treat the window as normal; clients may
+        // list types we don't know before the standard one
+        int normal = typed || types_length < 4;
+        for (int t = 0; t < types_length / 4 && !normal; t++) {
+            normal = _discovery_contains_window(
+                discovery->normal_types, discovery->normal_types_size,
+                ((uint32_t*)types)[t]);
+        }
+        if (status == 0 && viewable && !override_redirect && normal) {
+            // a window on desktop 0xFFFFFFFF is on every desktop
+            uint32_t window_desktop = (
+                desktop_length >= 4 ? ((uint32_t*)desktop)[0] : 0xFFFFFFFF);
+            // WM_CLASS is the instance and class, each null-terminated
+            char* instance = class == NULL ? "" : (char*)class;
+            int instance_size = strlen(instance);
+            char* class_name = (
+                instance_size + 1 < class_length ? instance + instance_size + 1 :
+                "");
+            // an untyped window is normal to `type=` tests too
+            xcb_atom_t* window_types = (xcb_atom_t*)types;
+            int window_types_size = types_length / 4;
+            if (typed && window_types_size == 0) {
+                window_types = &(filter->type_atoms[FILTER_TYPE_NORMAL]);
+                window_types_size = 1;
+            }
+            filter_window_t fw = {
+                !current_desktop_defined || window_desktop == 0xFFFFFFFF ||
+                    window_desktop == current_desktop,
+                states, states_length / 4,
+                window_types, window_types_size,
+                instance, class_name
+            };
+            match[i] = filter == NULL || filter_match(filter, &fw);
+        }
+        free(types);
+        free(desktop);
+        free(states);
+        free(class);
+    }
+
+    free(wcrs);
+    free(wsrs);
+    free(wdrs);
+    free(wtrs);
+    free(gwars);
+    return status;
+}
+
+
+/**
+ * Request the properties needed by `_discovery_names_reply`.  Nothing is waited
+ * for, so these can share a round trip with other requests.
+ *
+ * returns: the requests, 3 for each of `windows`
+ */
+unsigned int* _discovery_request_names (discovery_t* discovery,
+                                        xcb_window_t* windows,
+                                        int windows_size) {
+    x_backend_t* b = discovery->backend;
+    unsigned int* requests = calloc(windows_size * 3, sizeof(unsigned int));
+    for (int i = 0; i < windows_size; i++) {
+        // both names are requested, since waiting to find out whether the
+        // first is set would cost another round trip
+        requests[3 * i] = b->get_property(b->data, windows[i], discovery->name,
+                                          discovery->utf8_string,
+                                          DISCOVERY_MAX_NAME);
+        requests[3 * i + 1] = b->get_property(b->data, windows[i],
+                                              XCB_ATOM_WM_NAME,
+                                              XCB_GET_PROPERTY_TYPE_ANY,
+                                              DISCOVERY_MAX_NAME);
+        requests[3 * i + 2] = b->get_property(b->data, windows[i],
+                                              XCB_ATOM_WM_CLASS,
+                                              XCB_ATOM_STRING,
+                                              DISCOVERY_MAX_CLASS);
+    }
+    return requests;
+}
+
+
+/**
+ * Wait for the properties requested by `_discovery_request_names`, and build
+ * the names returned by `discovery_find_windows`.
+ *
+ * requests: from `_discovery_request_names`; freed
+ * names (output): as for `discovery_find_windows`; only set on success
+ *
+ * returns: 0 on success, -1 on failure
+ */
+int _discovery_names_reply (discovery_t* discovery, unsigned int* requests,
+                            int windows_size, char*** names) {
+    int status = 0;
+    *names = calloc(windows_size, sizeof(char*));
+    for (int i = 0; i < windows_size; i++) {
+        void* net_name;
+        int net_name_length;
+        void* name;
+        int name_length;
+        void* class;
+        int class_length;
+        if (_discovery_property_reply(discovery, requests[3 * i],
+                                      "get_property _NET_WM_NAME",
+                                      &net_name, &net_name_length) != 0) {
+            status = -1;
+        }
+        if (_discovery_property_reply(discovery, requests[3 * i + 1],
+                                      "get_property WM_NAME",
+                                      &name, &name_length) != 0) {
+            status = -1;
+        }
+        if (_discovery_property_reply(discovery, requests[3 * i + 2],
+                                      "get_property WM_CLASS",
+                                      &class, &class_length) != 0) {
+            status = -1;
+        }
+
+        // values are null-terminated, and WM_CLASS is the instance and class,
+        // each null-terminated
+        char* title = net_name_length > 0 ? (char*)net_name : (char*)name;
+        char* instance = (char*)class;
+        int instance_size = strlen(instance);
+        char* class_name = (
+            instance_size + 1 < class_length ? instance + instance_size + 1 :
+            "");
+        int title_size = strlen(title);
+        int class_size = strlen(class_name);
+        char* result = calloc(title_size + instance_size + class_size + 3, 1);
+        memcpy(result, title, title_size);
+        memcpy(result + title_size + 1, instance, instance_size);
+        memcpy(result + title_size + instance_size + 2, class_name,
+               class_size);
+        (*names)[i] = result;
+        free(net_name);
+        free(name);
+        free(class);
+    }
+
+    free(requests);
+    if (status != 0) {
+        for (int i = 0; i < windows_size; i++) free((*names)[i]);
+        free(*names);
+    }
+    return status;
+}
+
+
+/**
+ * Get the areas covered by windows.  Positions of windows which aren't children
+ * of the root window are translated to screen coordinates, in the same batch of
+ * requests as the geometry.
+ *
+ * tops: for each of `windows`, the child of the root window containing it
+ * rects (output): absolute areas covered by the contents of `windows`
+ *
+ * returns: 0 on success, -1 on failure
+ */
+int _discovery_window_rects (discovery_t* discovery,
+                             xcb_window_t* windows, xcb_window_t* tops,
+                             int windows_size, xcb_rectangle_t** rects) {
+    x_backend_t* b = discovery->backend;
+    unsigned int* tcrs = calloc(windows_size, sizeof(unsigned int));
+    unsigned int* ggrs = calloc(windows_size, sizeof(unsigned int));
+    for (int i = 0; i < windows_size; i++) {
+        if (windows[i] != tops[i]) {
+            tcrs[i] = b->translate_coordinates(b->data, windows[i],
+                                               discovery->root);
+        }
+        ggrs[i] = b->get_geometry(b->data, windows[i]);
+    }
+
+    int status = 0;
+    *rects = calloc(windows_size, sizeof(xcb_rectangle_t));
+    for (int i = 0; i < windows_size; i++) {
+        int x = 0, y = 0;
+        if (windows[i] != tops[i] &&
+            b->translate_coordinates_reply(b->data, tcrs[i], &x, &y) != 0) {
+            _discovery_fail(discovery, "translate_coordinates");
+            status = -1;
+        }
+        xcb_rectangle_t* rect = &((*rects)[i]);
+        int border_width;
+        if (b->get_geometry_reply(b->data, ggrs[i], rect,
+                                  &border_width) != 0) {
+            _discovery_fail(discovery, "get_geometry");
+            status = -1;
+            continue;
+        }
+        // children of the root window are positioned in screen coordinates
+        if (windows[i] != tops[i]) {
+            rect->x = x;
+            rect->y = y;
+        } else {
+            rect->x += border_width;
+            rect->y += border_width;
+        }
+    }
+
+    free(ggrs);
+    free(tcrs);
+    if (status != 0) free(*rects);
+    return status;
+}
+
+
+/**
+ * Remove windows which are completely covered by other windows, and reduce the
+ * area of each remaining window to its largest visible part.  Stacking order
+ * is determined by `all_windows`.
+ *
+ * all_windows: all children of the root window, bottom first
+ * windows: windows to filter, ordered like `tops`; filtered in place
+ * tops: for each of `windows`, the item in `all_windows` containing it, in
+ *     the same order as `all_windows`; filtered in place
+ * windows_size: size of `windows`, updated
+ * rects: absolute areas covered by `windows`; filtered and reduced in place
+ * names: names of `windows`, or NULL; filtered in place, freeing those removed
+ *
+ * returns: 0 on success, -1 on failure
+ */
+int _discovery_visible_window_rects (discovery_t* discovery,
+                                     xcb_window_t* all_windows,
+                                     int all_windows_size,
+                                     xcb_window_t* windows, xcb_window_t* tops,
+                                     int* windows_size,
+                                     xcb_rectangle_t* rects, char** names) {
+    x_backend_t* b = discovery->backend;
+    unsigned int* gwars = calloc(all_windows_size, sizeof(unsigned int));
+    unsigned int* ggrs = calloc(all_windows_size, sizeof(unsigned int));
+    for (int i = 0; i < all_windows_size; i++) {
+        gwars[i] = b->get_window_attributes(b->data, all_windows[i]);
+        ggrs[i] = b->get_geometry(b->data, all_windows[i]);
+    }
+
+    int status = 0;
+    xcb_rectangle_t* occluders = calloc(all_windows_size,
+                                        sizeof(xcb_rectangle_t));
+    int occluders_size = 0;
+    int* visible = calloc(*windows_size, sizeof(int));
+    int w = *windows_size - 1;
+
+    // sweep from the top, tracking the areas covered so far
+    for (int i = all_windows_size - 1; i >= 0; i--) {
+        int viewable, override_redirect;
+        if (b->get_window_attributes_reply(b->data, gwars[i], &viewable,
+                                           &override_redirect) != 0) {
+            _discovery_fail(discovery, "get_window_attributes");
+            status = -1;
+            viewable = 0;
+        }
+        xcb_rectangle_t outer;
+        int border_width;
+        if (b->get_geometry_reply(b->data, ggrs[i], &outer,
+                                  &border_width) != 0) {
+            _discovery_fail(discovery, "get_geometry");
+            status = -1;
+            viewable = 0;
+        }
+
+        // several windows may share a top-level window
+        for (; w >= 0 && tops[w] == all_windows[i]; w--) {
+            if (viewable) {
+                xcb_rectangle_t* region = malloc(sizeof(xcb_rectangle_t));
+                *region = rects[w];
+                int region_size = 1;
+                for (int j = 0; j < occluders_size && region_size > 0; j++) {
+                    _discovery_region_subtract(&region, &region_size,
+                                               &(occluders[j]));
+                }
+                if (region_size > 0) {
+                    visible[w] = 1;
+                    rects[w] = _discovery_region_largest(region, region_size);
+                }
+                free(region);
+            }
+        }
+
+        if (viewable) {
+            outer.width += 2 * border_width;
+            outer.height += 2 * border_width;
+            occluders[occluders_size] = outer;
+            occluders_size += 1;
+        }
+    }
+
+    int size = 0;
+    for (int i = 0; i < *windows_size; i++) {
+        if (visible[i]) {
+            windows[size] = windows[i];
+            tops[size] = tops[i];
+            rects[size] = rects[i];
+            if (names != NULL) names[size] = names[i];
+            size += 1;
+        } else if (names != NULL) {
+            free(names[i]);
+        }
+    }
+    *windows_size = size;
+
+    free(visible);
+    free(occluders);
+    free(ggrs);
+    free(gwars);
+    return status;
+}
+
+
+// -- public functions
+
+void discovery_request_tree (discovery_t* discovery) {
+    x_backend_t* b = discovery->backend;
+    discovery->tree_request = b->query_tree(b->data, discovery->root);
+    discovery->tree_requested = 1;
+}
+
+
+int discovery_find_windows (discovery_t* discovery,
+                            xcb_window_t** windows, xcb_window_t** tops,
+                            xcb_rectangle_t** rects, char*** names,
+                            int* windows_size) {
+    x_backend_t* b = discovery->backend;
+    discovery->error = NULL;
+    if (!discovery->tree_requested) discovery_request_tree(discovery);
+    unsigned int mwr = b->get_property(b->data, discovery->root,
+                                       discovery->client_list, XCB_ATOM_WINDOW,
+                                       discovery->max_windows);
+    discovery->tree_requested = 0;
+
+    xcb_window_t* all_windows;
+    int all_windows_size;
+    int tree_status = b->query_tree_reply(b->data, discovery->tree_request,
+                                          &all_windows, &all_windows_size);
+    if (tree_status != 0) _discovery_fail(discovery, "query_tree");
+    int managed_windows_defined;
+    xcb_window_t* managed_windows;
+    int managed_windows_size;
+    int managed_status = _discovery_get_managed_windows(
+        discovery, mwr, &managed_windows_defined,
+        &managed_windows, &managed_windows_size);
+    if (tree_status != 0 || managed_status != 0) {
+        if (tree_status == 0) free(all_windows);
+        if (managed_status == 0 && managed_windows_defined) {
+            free(managed_windows);
+        }
+        return -1;
+    }
+
+    // without a list of managed windows, a reparenting window manager's
+    // clients are inside frame windows
+    xcb_window_t* candidates;
+    xcb_window_t* candidate_tops;
+    int candidates_size;
+    if (managed_windows_defined) {
+        candidates = calloc(all_windows_size, sizeof(xcb_window_t));
+        candidate_tops = calloc(all_windows_size, sizeof(xcb_window_t));
+        for (int i = 0; i < all_windows_size; i++) {
+            candidates[i] = candidate_tops[i] = all_windows[i];
+        }
+        candidates_size = all_windows_size;
+    } else {
+        _discovery_find_clients(discovery, all_windows, all_windows_size,
+                                &candidates, &candidate_tops, &candidates_size);
+    }
+
+    // cheap checks first, so fewer windows need requests
+    *windows = calloc(candidates_size, sizeof(xcb_window_t));
+    *tops = calloc(candidates_size, sizeof(xcb_window_t));
+    int size = 0;
+    for (int i = 0; i < candidates_size; i++) {
+        if (
+            // ignore if not managed by the window manager
+            !(managed_windows_defined && !_discovery_contains_window(
+                managed_windows, managed_windows_size, candidates[i]
+            )) &&
+
+            // only include if whitelisted
+            (discovery->whitelist_size == 0 || _discovery_contains_window(
+                discovery->whitelist, discovery->whitelist_size, candidates[i]
+            )) &&
+
+            // ignore if blacklisted
+            !_discovery_contains_window(
+                discovery->blacklist, discovery->blacklist_size, candidates[i]
+            )
+        ) {
+            (*windows)[size] = candidates[i];
+            (*tops)[size] = candidate_tops[i];
+            size += 1;
+        }
+    }
+    free(candidate_tops);
+    free(candidates);
+    if (managed_windows_defined) free(managed_windows);
+
+    int* match = calloc(size, sizeof(int));
+    int status = _discovery_windows_match(discovery, *windows, size, match);
+    int match_size = 0;
+    for (int i = 0; i < size; i++) {
+        if (match[i]) {
+            (*windows)[match_size] = (*windows)[i];
+            (*tops)[match_size] = (*tops)[i];
+            match_size += 1;
+        }
+    }
+    size = match_size;
+    free(match);
+
+    // names are sent before the areas are waited for, so they share a
+    // round trip
+    unsigned int* names_requests = NULL;
+    if (status == 0 && names != NULL) {
+        names_requests = _discovery_request_names(discovery, *windows, size);
+    }
+    if (status == 0) {
+        status = _discovery_window_rects(discovery, *windows, *tops, size,
+                                         rects);
+    }
+    if (names_requests != NULL) {
+        if (_discovery_names_reply(discovery, names_requests, size,
+                                   names) != 0) {
+            if (status == 0) free(*rects);
+            status = -1;
+        } else if (status != 0) {
+            for (int i = 0; i < size; i++) free((*names)[i]);
+            free(*names);
+        }
+    }
+    if (status == 0 && discovery->visible_only) {
+        status = _discovery_visible_window_rects(
+            discovery, all_windows, all_windows_size,
+            *windows, *tops, &size, *rects, names == NULL ? NULL : *names);
+        if (status != 0) {
+            free(*rects);
+            if (names != NULL) {
+                for (int i = 0; i < size; i++) free((*names)[i]);
+                free(*names);
+            }
+        }
+    }
+    free(all_windows);
+
+    if (status != 0) {
+        free(*windows);
+        free(*tops);
+        return -1;
+    }
+    *windows_size = size;
+    return 0;
+}
+
+
+void discovery_cancel (discovery_t* discovery) {
+    if (!discovery->tree_requested) return;
+    x_backend_t* b = discovery->backend;
+    xcb_window_t* children;
+    int children_size;
+    if (b->query_tree_reply(b->data, discovery->tree_request,
+                            &children, &children_size) == 0) {
+        free(children);
+    }
+    discovery->tree_requested = 0;
+}
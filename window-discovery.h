@@ -0,0 +1,124 @@
+/*
+
+Licensed under the Apache License, Version 2.0 (the "License"); you may not use
+this file except in compliance with the License. You may obtain a copy of the
+License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software distributed
+under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+CONDITIONS OF ANY KIND, either express or implied. See the License for the
+specific language governing permissions and limitations under the License.
+
+*/
+
+#ifndef XCW_WINDOW_DISCOVERY_H
+#define XCW_WINDOW_DISCOVERY_H
+
+#include "x-backend.h"
+#include "window-filter.h"
+
+
+// -- types
+
+/**
+ * Settings for finding the windows that can be chosen, and the state of a
+ * search.  Settings are set by the caller before `discovery_request_tree`
+ * (zeroing is fine for those not needed), except that atoms and the filter's
+ * atoms only need to be set before `discovery_find_windows`.
+ *
+ * backend: used for all requests
+ * root: the root window
+ * client_list: the _NET_CLIENT_LIST atom
+ * wm_state: the WM_STATE atom
+ * window_type: the _NET_WM_WINDOW_TYPE atom
+ * desktop, current_desktop, state: the _NET_WM_DESKTOP,
+ *     _NET_CURRENT_DESKTOP and _NET_WM_STATE atoms (only needed by some
+ *     filters)
+ * name, utf8_string: the _NET_WM_NAME and UTF8_STRING atoms (only needed for
+ *     window names)
+ * normal_types: window types that can be chosen, if any of a window's types
+ *     is one of these; windows without a type can always be chosen.  Not
+ *     used if `filter` tests window types.
+ * max_windows: maximum number of windows read from _NET_CLIENT_LIST
+ * whitelist: if not empty, only these windows can be chosen
+ * blacklist: windows that can't be chosen
+ * visible_only: whether to leave out windows that are completely covered, and
+ *     reduce the others to their largest visible part
+ * filter: windows that can be chosen must match this, if not NULL; its atoms
+ *     must be set
+ * tree_request: request for the children of the root window, if
+ *     `tree_requested`
+ * error: the request that failed, if `discovery_find_windows` failed
+ */
+typedef struct discovery_t {
+    x_backend_t* backend;
+    xcb_window_t root;
+    xcb_atom_t client_list;
+    xcb_atom_t wm_state;
+    xcb_atom_t window_type;
+    xcb_atom_t desktop;
+    xcb_atom_t current_desktop;
+    xcb_atom_t state;
+    xcb_atom_t name;
+    xcb_atom_t utf8_string;
+    xcb_atom_t* normal_types;
+    int normal_types_size;
+    int max_windows;
+    xcb_window_t* whitelist;
+    int whitelist_size;
+    xcb_window_t* blacklist;
+    int blacklist_size;
+    int visible_only;
+    filter_t* filter;
+    unsigned int tree_request;
+    int tree_requested;
+    char* error;
+} discovery_t;
+
+
+// -- functions
+
+/**
+ * Request the children of the root window.  This doesn't depend on anything,
+ * so it can be sent before atoms are known, to overlap with other requests.
+ * If this isn't called, `discovery_find_windows` calls it.
+ */
+void discovery_request_tree (discovery_t* discovery);
+
+/**
+ * Find the windows that can be chosen.  Requests are sent in batches, so this
+ * costs a few round trips regardless of the number of windows or the
+ * properties the filter needs (plus one per level of the window tree if the
+ * window manager doesn't set _NET_CLIENT_LIST).
+ *
+ * windows (output): window IDs, grouped by `tops` in stacking order, bottom
+ *     first
+ * tops (output): for each of `windows`, the child of the root window
+ *     containing it (which may be the window itself)
+ * rects (output): absolute areas to cover for `windows`
+ * names (output): if not NULL, for each of `windows`, its title (_NET_WM_NAME,
+ *     or WM_NAME if that isn't set) followed by the instance and class from
+ *     WM_CLASS, each null-terminated and empty if not set; requested with the
+ *     areas, so this costs no extra round trip
+ * windows_size (output): size of `windows`, `tops`, `rects` and `names`
+ *
+ * returns: 0 on success, or -1 if a request failed, with `discovery->error`
+ *     naming it; outputs are only set on success, and should be freed (each
+ *     item of `names` too)
+ */
+int discovery_find_windows (discovery_t* discovery,
+                            xcb_window_t** windows, xcb_window_t** tops,
+                            xcb_rectangle_t** rects, char*** names,
+                            int* windows_size);
+
+/**
+ * Wait for the reply to `discovery_request_tree` and drop it, if it was sent
+ * and `discovery_find_windows` hasn't been called since.  Used when giving up
+ * before finding windows, so that no reply is left unread.
+ */
+void discovery_cancel (discovery_t* discovery);
+
+
+#endif
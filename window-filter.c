@@ -0,0 +1,365 @@
+/*
+
+Licensed under the Apache License, Version 2.0 (the "License"); you may not use
+this file except in compliance with the License. You may obtain a copy of the
+License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software distributed
+under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+CONDITIONS OF ANY KIND, either express or implied. See the License for the
+specific language governing permissions and limitations under the License.
+
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <fnmatch.h>
+#include "window-filter.h"
+
+
+// -- constants
+
+char* FILTER_STATE_NAMES[FILTER_STATES_SIZE] = {
+    "hidden", "shaded", "skip-pager", "skip-taskbar", "sticky", "fullscreen",
+    "above", "below", "modal", "demands-attention"
+};
+char* FILTER_TYPE_NAMES[FILTER_TYPES_SIZE] = {
+    "normal", "dialog", "utility", "toolbar", "menu", "splash", "dock",
+    "desktop"
+};
+/**
+ * Kinds of filter step.
+ */
+#define FILTER_OP_DESKTOP 0
+#define FILTER_OP_STATE 1
+#define FILTER_OP_TYPE 2
+#define FILTER_OP_CLASS 3
+#define FILTER_OP_INSTANCE 4
+#define FILTER_OP_NOT 5
+#define FILTER_OP_AND 6
+#define FILTER_OP_OR 7
+/**
+ * Characters that end an unquoted pattern, besides spaces.
+ */
+char* FILTER_DELIMITERS = "!&|()";
+
+
+// -- types
+
+/**
+ * State of parsing an expression.
+ *
+ * source: the expression
+ * position: index in `source` of the next character to read
+ * ops: steps compiled so far
+ * needs: as for `filter_t`
+ * error, error_position: the first problem found, or NULL
+ */
+typedef struct filter_parser_t {
+    char* source;
+    int position;
+    filter_op_t* ops;
+    int ops_size;
+    int needs;
+    char* error;
+    int error_position;
+} filter_parser_t;
+
+
+// -- parsing
+
+/**
+ * Record a problem at the current position.  Only the first is kept.
+ */
+void _filter_fail (filter_parser_t* p, char* error) {
+    if (p->error == NULL) {
+        p->error = error;
+        p->error_position = p->position;
+    }
+}
+
+
+/**
+ * Skip spaces, and get the next character without consuming it.
+ */
+char _filter_peek (filter_parser_t* p) {
+    while (p->source[p->position] == ' ' || p->source[p->position] == '\t') {
+        p->position += 1;
+    }
+    return p->source[p->position];
+}
+
+
+/**
+ * Add a step.
+ *
+ * pattern: allocated pattern, owned by the step afterwards, or NULL
+ */
+void _filter_emit (filter_parser_t* p, int kind, int index, char* pattern) {
+    p->ops = realloc(p->ops, (p->ops_size + 1) * sizeof(filter_op_t));
+    filter_op_t op = { kind, index, pattern };
+    p->ops[p->ops_size] = op;
+    p->ops_size += 1;
+}
+
+
+/**
+ * Consume `word` if it's next.
+ *
+ * returns: whether it was consumed
+ */
+int _filter_accept (filter_parser_t* p, char* word) {
+    _filter_peek(p);
+    int size = strlen(word);
+    if (strncmp(p->source + p->position, word, size) != 0) return 0;
+    p->position += size;
+    return 1;
+}
+
+
+/**
+ * Read a word (a name or unquoted pattern), or a quoted pattern.
+ *
+ * returns: allocated copy of the word, without quotes, or NULL on failure
+ */
+char* _filter_read_word (filter_parser_t* p, int allow_quotes) {
+    int start = p->position;
+    int end;
+    if (allow_quotes && p->source[start] == '"') {
+        char* close = strchr(p->source + start + 1, '"');
+        if (close == NULL) {
+            _filter_fail(p, "missing closing quote");
+            return NULL;
+        }
+        start += 1;
+        end = close - p->source;
+        p->position = end + 1;
+    } else {
+        end = start;
+        while (p->source[end] != '\0' && p->source[end] != ' ' &&
+               p->source[end] != '\t' &&
+               strchr(FILTER_DELIMITERS, p->source[end]) == NULL) {
+            end += 1;
+        }
+        if (end == start) {
+            _filter_fail(p, "expected a value");
+            return NULL;
+        }
+        p->position = end;
+    }
+
+    char* word = calloc(end - start + 1, 1);
+    memcpy(word, p->source + start, end - start);
+    return word;
+}
+
+
+/**
+ * Find a name in a list of names.
+ *
+ * returns: index of the name, or -1
+ */
+int _filter_find_name (char** names, int names_size, char* name) {
+    for (int i = 0; i < names_size; i++) {
+        if (strcmp(names[i], name) == 0) return i;
+    }
+    return -1;
+}
+
+
+/**
+ * Parse a `state=` or `type=` predicate after the '='.
+ */
+void _filter_parse_name (filter_parser_t* p, int kind,
+                         char** names, int names_size, char* error) {
+    int position = p->position;
+    char* name = _filter_read_word(p, 0);
+    if (name == NULL) return;
+    int index = _filter_find_name(names, names_size, name);
+    free(name);
+    if (index == -1) {
+        p->position = position;
+        _filter_fail(p, error);
+        return;
+    }
+    _filter_emit(p, kind, index, NULL);
+}
+
+
+void _filter_parse_expression (filter_parser_t* p);
+
+
+/**
+ * Parse a factor (see `filter_compile`).
+ */
+void _filter_parse_factor (filter_parser_t* p) {
+    char c = _filter_peek(p);
+    if (c == '!') {
+        p->position += 1;
+        _filter_parse_factor(p);
+        _filter_emit(p, FILTER_OP_NOT, 0, NULL);
+
+    } else if (c == '(') {
+        p->position += 1;
+        _filter_parse_expression(p);
+        if (_filter_peek(p) != ')') {
+            _filter_fail(p, "expected ')'");
+            return;
+        }
+        p->position += 1;
+
+    } else if (_filter_accept(p, "state=")) {
+        _filter_parse_name(p, FILTER_OP_STATE, FILTER_STATE_NAMES,
+                           FILTER_STATES_SIZE, "unknown state");
+        p->needs |= FILTER_NEEDS_STATE;
+    } else if (_filter_accept(p, "type=")) {
+        _filter_parse_name(p, FILTER_OP_TYPE, FILTER_TYPE_NAMES,
+                           FILTER_TYPES_SIZE, "unknown type");
+        p->needs |= FILTER_NEEDS_TYPE;
+    } else if (_filter_accept(p, "class=")) {
+        char* pattern = _filter_read_word(p, 1);
+        if (pattern != NULL) _filter_emit(p, FILTER_OP_CLASS, 0, pattern);
+        p->needs |= FILTER_NEEDS_CLASS;
+    } else if (_filter_accept(p, "instance=")) {
+        char* pattern = _filter_read_word(p, 1);
+        if (pattern != NULL) _filter_emit(p, FILTER_OP_INSTANCE, 0, pattern);
+        p->needs |= FILTER_NEEDS_CLASS;
+    } else {
+        // `desktop` must be a whole word, so that `desktops` is an error
+        int position = p->position;
+        char* word = c == '\0' ? NULL : _filter_read_word(p, 0);
+        if (word != NULL && strcmp(word, "desktop") == 0) {
+            _filter_emit(p, FILTER_OP_DESKTOP, 0, NULL);
+            p->needs |= FILTER_NEEDS_DESKTOP;
+        } else {
+            p->position = position;
+            _filter_fail(p, "expected 'desktop', 'state=', 'type=', 'class=', \
+'instance=', '!' or '('");
+        }
+        free(word);
+    }
+}
+
+
+/**
+ * Parse a term (see `filter_compile`).
+ */
+void _filter_parse_term (filter_parser_t* p) {
+    _filter_parse_factor(p);
+    while (p->error == NULL && _filter_peek(p) == '&') {
+        p->position += 1;
+        _filter_parse_factor(p);
+        _filter_emit(p, FILTER_OP_AND, 0, NULL);
+    }
+}
+
+
+/**
+ * Parse an expression (see `filter_compile`).
+ */
+void _filter_parse_expression (filter_parser_t* p) {
+    _filter_parse_term(p);
+    while (p->error == NULL && _filter_peek(p) == '|') {
+        p->position += 1;
+        _filter_parse_term(p);
+        _filter_emit(p, FILTER_OP_OR, 0, NULL);
+    }
+}
+
+
+// -- matching
+
+/**
+ * Determine whether an atom is in a list of atoms.
+ */
+int _filter_contains_atom (xcb_atom_t* atoms, int atoms_size,
+                           xcb_atom_t atom) {
+    for (int i = 0; i < atoms_size; i++) {
+        if (atoms[i] == atom) return 1;
+    }
+    return 0;
+}
+
+
+// -- public functions
+
+int filter_compile (char* source, filter_t* filter,
+                    char** error, int* error_position) {
+    filter_parser_t p = { source, 0, NULL, 0, 0, NULL, 0 };
+    _filter_parse_expression(&p);
+    if (p.error == NULL && _filter_peek(&p) != '\0') {
+        _filter_fail(&p, "expected '&', '|' or the end of the filter");
+    }
+    if (p.error != NULL) {
+        for (int i = 0; i < p.ops_size; i++) free(p.ops[i].pattern);
+        free(p.ops);
+        *error = p.error;
+        *error_position = p.error_position;
+        return -1;
+    }
+
+    // a filter that was already compiled is combined with this one
+    int size = filter->ops_size + p.ops_size + (filter->ops_size > 0 ? 1 : 0);
+    filter->ops = realloc(filter->ops, size * sizeof(filter_op_t));
+    memcpy(filter->ops + filter->ops_size, p.ops,
+           p.ops_size * sizeof(filter_op_t));
+    if (filter->ops_size > 0) {
+        filter_op_t and = { FILTER_OP_AND, 0, NULL };
+        filter->ops[size - 1] = and;
+    }
+    filter->ops_size = size;
+    filter->needs |= p.needs;
+    free(filter->stack);
+    filter->stack = calloc(size, sizeof(char));
+    free(p.ops);
+    return 0;
+}
+
+
+void filter_free (filter_t* filter) {
+    for (int i = 0; i < filter->ops_size; i++) free(filter->ops[i].pattern);
+    free(filter->ops);
+    free(filter->stack);
+    memset(filter, 0, sizeof(filter_t));
+}
+
+
+int filter_match (filter_t* filter, filter_window_t* window) {
+    if (filter->ops_size == 0) return 1;
+    char* stack = filter->stack;
+    int size = 0;
+    for (int i = 0; i < filter->ops_size; i++) {
+        filter_op_t* op = &(filter->ops[i]);
+        if (op->kind == FILTER_OP_NOT) {
+            stack[size - 1] = !stack[size - 1];
+        } else if (op->kind == FILTER_OP_AND) {
+            stack[size - 2] = stack[size - 2] && stack[size - 1];
+            size -= 1;
+        } else if (op->kind == FILTER_OP_OR) {
+            stack[size - 2] = stack[size - 2] || stack[size - 1];
+            size -= 1;
+        } else {
+            char result = 0;
+            if (op->kind == FILTER_OP_DESKTOP) {
+                result = window->on_desktop;
+            } else if (op->kind == FILTER_OP_STATE) {
+                result = _filter_contains_atom(
+                    window->states, window->states_size,
+                    filter->state_atoms[op->index]);
+            } else if (op->kind == FILTER_OP_TYPE) {
+                result = _filter_contains_atom(
+                    window->types, window->types_size,
+                    filter->type_atoms[op->index]);
+            } else if (op->kind == FILTER_OP_CLASS) {
+                result = fnmatch(op->pattern, window->class, 0) == 0;
+            } else if (op->kind == FILTER_OP_INSTANCE) {
+                result = fnmatch(op->pattern, window->instance, 0) == 0;
+            }
+            stack[size] = result;
+            size += 1;
+        }
+    }
+    return stack[0];
+}
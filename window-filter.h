@@ -0,0 +1,171 @@
+/*
+
+Licensed under the Apache License, Version 2.0 (the "License"); you may not use
+this file except in compliance with the License. You may obtain a copy of the
+License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software distributed
+under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+CONDITIONS OF ANY KIND, either express or implied. See the License for the
+specific language governing permissions and limitations under the License.
+
+*/
+
+#ifndef XCW_WINDOW_FILTER_H
+#define XCW_WINDOW_FILTER_H
+
+#include <xcb/xcb.h>
+
+
+// -- constants
+
+/**
+ * Window states that can be matched with `state=NAME`, as indices into
+ * `FILTER_STATE_NAMES` and `filter_t.state_atoms`.
+ */
+#define FILTER_STATE_HIDDEN 0
+#define FILTER_STATE_SHADED 1
+#define FILTER_STATE_SKIP_PAGER 2
+#define FILTER_STATE_SKIP_TASKBAR 3
+#define FILTER_STATE_STICKY 4
+#define FILTER_STATE_FULLSCREEN 5
+#define FILTER_STATE_ABOVE 6
+#define FILTER_STATE_BELOW 7
+#define FILTER_STATE_MODAL 8
+#define FILTER_STATE_DEMANDS_ATTENTION 9
+#define FILTER_STATES_SIZE 10
+/**
+ * Window types that can be matched with `type=NAME`, as indices into
+ * `FILTER_TYPE_NAMES` and `filter_t.type_atoms`.
+ */
+#define FILTER_TYPE_NORMAL 0
+#define FILTER_TYPE_DIALOG 1
+#define FILTER_TYPE_UTILITY 2
+#define FILTER_TYPE_TOOLBAR 3
+#define FILTER_TYPE_MENU 4
+#define FILTER_TYPE_SPLASH 5
+#define FILTER_TYPE_DOCK 6
+#define FILTER_TYPE_DESKTOP 7
+#define FILTER_TYPES_SIZE 8
+/**
+ * Properties a filter needs, as bits in `filter_t.needs`.
+ *
+ * FILTER_NEEDS_DESKTOP: _NET_WM_DESKTOP, and the root window's
+ *     _NET_CURRENT_DESKTOP
+ * FILTER_NEEDS_STATE: _NET_WM_STATE
+ * FILTER_NEEDS_TYPE: every atom in _NET_WM_WINDOW_TYPE
+ * FILTER_NEEDS_CLASS: WM_CLASS
+ */
+#define FILTER_NEEDS_DESKTOP 1
+#define FILTER_NEEDS_STATE 2
+#define FILTER_NEEDS_TYPE 4
+#define FILTER_NEEDS_CLASS 8
+
+/**
+ * Names used for states and types in filter expressions.
+ */
+extern char* FILTER_STATE_NAMES[FILTER_STATES_SIZE];
+extern char* FILTER_TYPE_NAMES[FILTER_TYPES_SIZE];
+
+
+// -- types
+
+/**
+ * One step of a compiled filter.  Filters are compiled to postfix order: each
+ * predicate pushes its result, and operators replace results on top of the
+ * stack.
+ *
+ * kind: a FILTER_OP_* constant (see window-filter.c)
+ * index: the state or type to look for, for `state=` and `type=`
+ * pattern: the glob pattern, for `class=` and `instance=`
+ */
+typedef struct filter_op_t {
+    int kind;
+    int index;
+    char* pattern;
+} filter_op_t;
+
+/**
+ * A compiled filter expression.
+ *
+ * ops: steps, in postfix order
+ * needs: properties the filter looks at, as FILTER_NEEDS_* bits
+ * state_atoms, type_atoms: the atom for each state and type name; set by the
+ *     caller before using `filter_match`
+ * stack: space for evaluating the filter, with size `ops_size`
+ */
+typedef struct filter_t {
+    filter_op_t* ops;
+    int ops_size;
+    int needs;
+    xcb_atom_t state_atoms[FILTER_STATES_SIZE];
+    xcb_atom_t type_atoms[FILTER_TYPES_SIZE];
+    char* stack;
+} filter_t;
+
+/**
+ * The properties of a window that a filter can look at.  Only those in
+ * `filter_t.needs` have to be set.
+ *
+ * on_desktop: whether the window is on the current desktop (or on all
+ *     desktops, or the window manager doesn't have desktops)
+ * states: _NET_WM_STATE
+ * types: _NET_WM_WINDOW_TYPE
+ * instance, class: the two parts of WM_CLASS; empty if not set
+ */
+typedef struct filter_window_t {
+    int on_desktop;
+    xcb_atom_t* states;
+    int states_size;
+    xcb_atom_t* types;
+    int types_size;
+    char* instance;
+    char* class;
+} filter_window_t;
+
+
+// -- functions
+
+/**
+ * Compile a filter expression.
+ *
+ * The syntax is:
+ *
+ *     expression := term ( '|' term )*
+ *     term := factor ( '&' factor )*
+ *     factor := '!' factor | '(' expression ')' | predicate
+ *     predicate := 'desktop' | 'state=' NAME | 'type=' NAME |
+ *                  'class=' PATTERN | 'instance=' PATTERN
+ *
+ * where '!' is 'not', '&' is 'and', and '|' is 'or'.  Spaces between tokens
+ * are ignored.  NAME is one of `FILTER_STATE_NAMES` or `FILTER_TYPE_NAMES`.
+ * PATTERN is a glob pattern matched against part of WM_CLASS, either in double
+ * quotes, or running up to the next space or one of '!&|()'.
+ *
+ * source: the expression
+ * filter: an empty (zeroed) filter, or one that has already been compiled,
+ *     in which case windows must match both expressions; should be freed with
+ *     `filter_free`
+ * error (output): on failure, a description of the problem
+ * error_position (output): on failure, the index in `source` of the problem
+ *
+ * returns: 0 on success, -1 on failure, with `filter` unchanged
+ */
+int filter_compile (char* source, filter_t* filter,
+                    char** error, int* error_position);
+
+/**
+ * Free memory used by a filter.
+ */
+void filter_free (filter_t* filter);
+
+/**
+ * Determine whether a window matches a filter.  An empty filter matches every
+ * window.  Not thread-safe, since the filter's stack is reused.
+ */
+int filter_match (filter_t* filter, filter_window_t* window);
+
+
+#endif
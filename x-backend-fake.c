@@ -0,0 +1,360 @@
+/*
+
+Licensed under the Apache License, Version 2.0 (the "License"); you may not use
+this file except in compliance with the License. You may obtain a copy of the
+License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software distributed
+under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+CONDITIONS OF ANY KIND, either express or implied. See the License for the
+specific language governing permissions and limitations under the License.
+
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include "x-backend-fake.h"
+
+
+// -- utilities
+
+/**
+ * Get a window that exists and hasn't been destroyed.
+ *
+ * returns: the window, or NULL
+ */
+x_fake_window_t* _x_fake_live_window (x_fake_t* fake, xcb_window_t window) {
+    x_fake_window_t* w = x_fake_window(fake, window);
+    return w == NULL || w->destroyed ? NULL : w;
+}
+
+
+/**
+ * Find a property on a window.
+ *
+ * returns: the property, or NULL if it isn't set
+ */
+x_fake_property_t* _x_fake_find_property (x_fake_window_t* w,
+                                          xcb_atom_t atom) {
+    for (int i = 0; i < w->properties_size; i++) {
+        if (w->properties[i].atom == atom) return &(w->properties[i]);
+    }
+    return NULL;
+}
+
+
+/**
+ * Get the absolute position of a window's origin (inside its border).
+ */
+void _x_fake_origin (x_fake_t* fake, xcb_window_t window, int* x, int* y) {
+    *x = 0;
+    *y = 0;
+    x_fake_window_t* w = x_fake_window(fake, window);
+    while (w != NULL && w->parent != XCB_NONE) {
+        *x += w->rect.x + w->border_width;
+        *y += w->rect.y + w->border_width;
+        w = x_fake_window(fake, w->parent);
+    }
+}
+
+
+/**
+ * Record a request, and work out when its reply arrives.
+ *
+ * returns: the request's ID, or 0 if memory can't be allocated
+ */
+unsigned int _x_fake_send (x_fake_t* fake, int kind, xcb_window_t window,
+                           uint32_t other, xcb_atom_t type, uint32_t length) {
+    if (fake->requests_size == fake->requests_capacity) {
+        int capacity = fake->requests_capacity == 0 ?
+            64 : 2 * fake->requests_capacity;
+        x_fake_request_t* requests = realloc(
+            fake->requests, capacity * sizeof(x_fake_request_t));
+        if (requests == NULL) return 0;
+        fake->requests = requests;
+        fake->requests_capacity = capacity;
+    }
+
+    double arrival = fake->clock + fake->latency / 2;
+    double start = arrival > fake->server_time ? arrival : fake->server_time;
+    fake->server_time = start + fake->request_time;
+    x_fake_request_t request = {
+        kind, window, other, type, length,
+        fake->clock, fake->server_time + fake->latency / 2, 0
+    };
+    fake->requests[fake->requests_size] = request;
+    fake->requests_size += 1;
+    return fake->requests_size;
+}
+
+
+/**
+ * Wait for the reply to a request.
+ *
+ * returns: the request, or NULL if it isn't of kind `kind`, or its reply has
+ *     already been waited for
+ */
+x_fake_request_t* _x_fake_wait (x_fake_t* fake, unsigned int id, int kind) {
+    if (id < 1 || id > (unsigned int)fake->requests_size) return NULL;
+    x_fake_request_t* request = &(fake->requests[id - 1]);
+    if (request->kind != kind || request->replied) return NULL;
+    request->replied = 1;
+    if (request->reply_time > fake->clock) {
+        // replies to requests sent before the last round trip ended were
+        // already partly waited for
+        if (request->send_time >= fake->wait_time) fake->round_trips += 1;
+        fake->clock = request->reply_time;
+        fake->wait_time = fake->clock;
+    }
+    return request;
+}
+
+
+// -- backend functions
+
+unsigned int _x_fake_query_tree (void* data, xcb_window_t window) {
+    return _x_fake_send((x_fake_t*)data, X_FAKE_QUERY_TREE, window, 0, 0, 0);
+}
+
+
+int _x_fake_query_tree_reply (void* data, unsigned int request,
+                              xcb_window_t** children, int* children_size) {
+    x_fake_t* fake = (x_fake_t*)data;
+    x_fake_request_t* r = _x_fake_wait(fake, request, X_FAKE_QUERY_TREE);
+    x_fake_window_t* w;
+    if (r == NULL || (w = _x_fake_live_window(fake, r->window)) == NULL) {
+        return -1;
+    }
+    *children = calloc(w->children_size, sizeof(xcb_window_t));
+    int size = 0;
+    for (int i = 0; i < w->children_size; i++) {
+        if (_x_fake_live_window(fake, w->children[i]) != NULL) {
+            (*children)[size] = w->children[i];
+            size += 1;
+        }
+    }
+    *children_size = size;
+    return 0;
+}
+
+
+unsigned int _x_fake_get_property (void* data, xcb_window_t window,
+                                   xcb_atom_t property, xcb_atom_t type,
+                                   uint32_t length) {
+    return _x_fake_send((x_fake_t*)data, X_FAKE_GET_PROPERTY, window,
+                        property, type, length);
+}
+
+
+int _x_fake_get_property_reply (void* data, unsigned int request,
+                                xcb_atom_t* type,
+                                void** value, int* value_length) {
+    x_fake_t* fake = (x_fake_t*)data;
+    x_fake_request_t* r = _x_fake_wait(fake, request, X_FAKE_GET_PROPERTY);
+    x_fake_window_t* w;
+    if (r == NULL || (w = _x_fake_live_window(fake, r->window)) == NULL) {
+        return -1;
+    }
+    x_fake_property_t* p = _x_fake_find_property(w, r->other);
+    int length = 0;
+    *type = XCB_NONE;
+    if (p != NULL) {
+        *type = p->type;
+        // as with X, a property of the wrong type has its type returned, but
+        // no value
+        if (r->type == XCB_GET_PROPERTY_TYPE_ANY || r->type == p->type) {
+            length = p->value_length;
+            if ((long long)r->length * 4 < length) length = r->length * 4;
+        }
+    }
+    *value = calloc(length + 1, 1);
+    if (length > 0) memcpy(*value, p->value, length);
+    *value_length = length;
+    return 0;
+}
+
+
+unsigned int _x_fake_get_window_attributes (void* data, xcb_window_t window) {
+    return _x_fake_send((x_fake_t*)data, X_FAKE_GET_WINDOW_ATTRIBUTES, window,
+                        0, 0, 0);
+}
+
+
+int _x_fake_get_window_attributes_reply (void* data, unsigned int request,
+                                         int* viewable,
+                                         int* override_redirect) {
+    x_fake_t* fake = (x_fake_t*)data;
+    x_fake_request_t* r = _x_fake_wait(fake, request,
+                                       X_FAKE_GET_WINDOW_ATTRIBUTES);
+    x_fake_window_t* w;
+    if (r == NULL || (w = _x_fake_live_window(fake, r->window)) == NULL) {
+        return -1;
+    }
+    *viewable = w->viewable;
+    *override_redirect = w->override_redirect;
+    return 0;
+}
+
+
+unsigned int _x_fake_get_geometry (void* data, xcb_window_t window) {
+    return _x_fake_send((x_fake_t*)data, X_FAKE_GET_GEOMETRY, window, 0, 0, 0);
+}
+
+
+int _x_fake_get_geometry_reply (void* data, unsigned int request,
+                                xcb_rectangle_t* rect, int* border_width) {
+    x_fake_t* fake = (x_fake_t*)data;
+    x_fake_request_t* r = _x_fake_wait(fake, request, X_FAKE_GET_GEOMETRY);
+    x_fake_window_t* w;
+    if (r == NULL || (w = _x_fake_live_window(fake, r->window)) == NULL) {
+        return -1;
+    }
+    *rect = w->rect;
+    *border_width = w->border_width;
+    return 0;
+}
+
+
+unsigned int _x_fake_translate_coordinates (void* data, xcb_window_t window,
+                                            xcb_window_t relative_to) {
+    return _x_fake_send((x_fake_t*)data, X_FAKE_TRANSLATE_COORDINATES, window,
+                        relative_to, 0, 0);
+}
+
+
+int _x_fake_translate_coordinates_reply (void* data, unsigned int request,
+                                         int* x, int* y) {
+    x_fake_t* fake = (x_fake_t*)data;
+    x_fake_request_t* r = _x_fake_wait(fake, request,
+                                       X_FAKE_TRANSLATE_COORDINATES);
+    if (r == NULL || _x_fake_live_window(fake, r->window) == NULL ||
+        _x_fake_live_window(fake, r->other) == NULL) {
+        return -1;
+    }
+    int wx, wy, rx, ry;
+    _x_fake_origin(fake, r->window, &wx, &wy);
+    _x_fake_origin(fake, r->other, &rx, &ry);
+    *x = wx - rx;
+    *y = wy - ry;
+    return 0;
+}
+
+
+// -- public functions
+
+int x_fake_create (int width, int height, double latency, double request_time,
+                   x_fake_t* fake) {
+    memset(fake, 0, sizeof(x_fake_t));
+    fake->latency = latency;
+    fake->request_time = request_time;
+    fake->windows = calloc(1, sizeof(x_fake_window_t));
+    if (fake->windows == NULL) return -1;
+    fake->windows_size = 1;
+    fake->windows[0].rect.width = width;
+    fake->windows[0].rect.height = height;
+    fake->windows[0].viewable = 1;
+    return 0;
+}
+
+
+void x_fake_free (x_fake_t* fake) {
+    for (int i = 0; i < fake->windows_size; i++) {
+        x_fake_window_t* w = &(fake->windows[i]);
+        for (int p = 0; p < w->properties_size; p++) {
+            free(w->properties[p].value);
+        }
+        free(w->properties);
+        free(w->children);
+    }
+    free(fake->windows);
+    free(fake->requests);
+    memset(fake, 0, sizeof(x_fake_t));
+}
+
+
+xcb_window_t x_fake_add_window (x_fake_t* fake, xcb_window_t parent,
+                                xcb_rectangle_t rect, int border_width) {
+    if (x_fake_window(fake, parent) == NULL) return XCB_NONE;
+    x_fake_window_t* windows = realloc(
+        fake->windows, (fake->windows_size + 1) * sizeof(x_fake_window_t));
+    if (windows == NULL) return XCB_NONE;
+    fake->windows = windows;
+
+    x_fake_window_t* p = x_fake_window(fake, parent);
+    xcb_window_t* children = realloc(
+        p->children, (p->children_size + 1) * sizeof(xcb_window_t));
+    if (children == NULL) return XCB_NONE;
+    xcb_window_t window = fake->windows_size + 1;
+    p->children = children;
+    p->children[p->children_size] = window;
+    p->children_size += 1;
+
+    x_fake_window_t w = {
+        parent, NULL, 0, rect, border_width, 1, 0, NULL, 0, 0
+    };
+    fake->windows[fake->windows_size] = w;
+    fake->windows_size += 1;
+    return window;
+}
+
+
+x_fake_window_t* x_fake_window (x_fake_t* fake, xcb_window_t window) {
+    if (window < 1 || window > (xcb_window_t)fake->windows_size) return NULL;
+    return &(fake->windows[window - 1]);
+}
+
+
+int x_fake_set_property (x_fake_t* fake, xcb_window_t window,
+                         xcb_atom_t atom, xcb_atom_t type,
+                         void* value, int value_length) {
+    x_fake_window_t* w = x_fake_window(fake, window);
+    if (w == NULL) return -1;
+    char* copy = calloc(value_length + 1, 1);
+    if (copy == NULL) return -1;
+    memcpy(copy, value, value_length);
+
+    x_fake_property_t* p = _x_fake_find_property(w, atom);
+    if (p == NULL) {
+        x_fake_property_t* properties = realloc(
+            w->properties, (w->properties_size + 1) * sizeof(x_fake_property_t));
+        if (properties == NULL) {
+            free(copy);
+            return -1;
+        }
+        w->properties = properties;
+        p = &(w->properties[w->properties_size]);
+        w->properties_size += 1;
+        p->value = NULL;
+    }
+    free(p->value);
+    p->atom = atom;
+    p->type = type;
+    p->value = copy;
+    p->value_length = value_length;
+    return 0;
+}
+
+
+void x_fake_backend (x_fake_t* fake, x_backend_t* backend) {
+    backend->data = fake;
+    backend->query_tree = _x_fake_query_tree;
+    backend->query_tree_reply = _x_fake_query_tree_reply;
+    backend->get_property = _x_fake_get_property;
+    backend->get_property_reply = _x_fake_get_property_reply;
+    backend->get_window_attributes = _x_fake_get_window_attributes;
+    backend->get_window_attributes_reply = _x_fake_get_window_attributes_reply;
+    backend->get_geometry = _x_fake_get_geometry;
+    backend->get_geometry_reply = _x_fake_get_geometry_reply;
+    backend->translate_coordinates = _x_fake_translate_coordinates;
+    backend->translate_coordinates_reply = _x_fake_translate_coordinates_reply;
+}
+
+
+void x_fake_count_requests (x_fake_t* fake, int* counts) {
+    memset(counts, 0, X_FAKE_KINDS_SIZE * sizeof(int));
+    for (int i = 0; i < fake->requests_size; i++) {
+        counts[fake->requests[i].kind] += 1;
+    }
+}
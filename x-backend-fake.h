@@ -0,0 +1,196 @@
+/*
+
+Licensed under the Apache License, Version 2.0 (the "License"); you may not use
+this file except in compliance with the License. You may obtain a copy of the
+License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software distributed
+under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+CONDITIONS OF ANY KIND, either express or implied. See the License for the
+specific language governing permissions and limitations under the License.
+
+*/
+
+#ifndef XCW_X_BACKEND_FAKE_H
+#define XCW_X_BACKEND_FAKE_H
+
+#include "x-backend.h"
+
+
+// -- types
+
+/**
+ * A property set on a fake window.
+ *
+ * value: `value_length` bytes, followed by a null byte
+ */
+typedef struct x_fake_property_t {
+    xcb_atom_t atom;
+    xcb_atom_t type;
+    void* value;
+    int value_length;
+} x_fake_property_t;
+
+/**
+ * A fake window.  IDs are indices into `x_fake_t.windows` plus 1.
+ *
+ * parent: XCB_NONE for the root window
+ * children: bottom first
+ * rect: outer position relative to the parent's origin, and inner size
+ * destroyed: requests about the window fail
+ */
+typedef struct x_fake_window_t {
+    xcb_window_t parent;
+    xcb_window_t* children;
+    int children_size;
+    xcb_rectangle_t rect;
+    int border_width;
+    int viewable;
+    int override_redirect;
+    x_fake_property_t* properties;
+    int properties_size;
+    int destroyed;
+} x_fake_window_t;
+
+/**
+ * A request sent to a fake server.
+ *
+ * kind: the `x_backend_t` function that sent it, as an X_FAKE_* constant
+ * window: the window the request is about
+ * other: the property for X_FAKE_GET_PROPERTY, or the window to translate
+ *     relative to for X_FAKE_TRANSLATE_COORDINATES
+ * type, length: arguments for X_FAKE_GET_PROPERTY
+ * send_time: virtual time at which the request was sent
+ * reply_time: virtual time at which the reply reaches the client
+ * replied: whether the reply has been waited for
+ */
+typedef struct x_fake_request_t {
+    int kind;
+    xcb_window_t window;
+    uint32_t other;
+    xcb_atom_t type;
+    uint32_t length;
+    double send_time;
+    double reply_time;
+    int replied;
+} x_fake_request_t;
+
+/**
+ * An in-memory X server, which answers the requests in `x_backend_t` from a
+ * window tree built by the caller, and keeps a virtual clock so that round
+ * trips can be measured deterministically.
+ *
+ * Each request takes `latency / 2` to reach the server, which handles requests
+ * one at a time, each taking `request_time`; the reply takes another
+ * `latency / 2` to come back.  Sending takes no time, and waiting for a reply
+ * that hasn't arrived moves the clock forward to when it does.  Such a wait
+ * counts as a round trip unless the request was sent before the previous wait
+ * ended (as when waiting for a batch of replies in turn).
+ *
+ * windows: windows by ID minus 1; the root window is `X_FAKE_ROOT`
+ * requests: every request sent, in order; request IDs are indices plus 1
+ * clock: current virtual time, in seconds
+ * server_time: virtual time at which the server finishes the last request
+ * round_trips: number of times the client had to wait for a reply
+ * wait_time: virtual time at which the last wait ended
+ */
+typedef struct x_fake_t {
+    x_fake_window_t* windows;
+    int windows_size;
+    x_fake_request_t* requests;
+    int requests_size;
+    int requests_capacity;
+    double latency;
+    double request_time;
+    double clock;
+    double server_time;
+    int round_trips;
+    double wait_time;
+} x_fake_t;
+
+
+// -- constants
+
+/**
+ * Kinds of request.
+ */
+#define X_FAKE_QUERY_TREE 0
+#define X_FAKE_GET_PROPERTY 1
+#define X_FAKE_GET_WINDOW_ATTRIBUTES 2
+#define X_FAKE_GET_GEOMETRY 3
+#define X_FAKE_TRANSLATE_COORDINATES 4
+#define X_FAKE_KINDS_SIZE 5
+/**
+ * ID of the root window.
+ */
+#define X_FAKE_ROOT 1
+
+
+// -- functions
+
+/**
+ * Create a fake server with only a root window, which is viewable.
+ *
+ * latency: round trip time, in seconds
+ * request_time: time the server spends on each request, in seconds
+ * fake (output): should be freed with `x_fake_free`
+ *
+ * returns: 0 on success, -1 if memory can't be allocated
+ */
+int x_fake_create (int width, int height, double latency, double request_time,
+                   x_fake_t* fake);
+
+/**
+ * Free memory used by a fake server.
+ */
+void x_fake_free (x_fake_t* fake);
+
+/**
+ * Add a window on top of its siblings.  It's viewable, and not
+ * override-redirect.
+ *
+ * rect: outer position relative to the parent's origin, and inner size
+ *
+ * returns: the new window's ID, or XCB_NONE if `parent` doesn't exist or
+ *     memory can't be allocated
+ */
+xcb_window_t x_fake_add_window (x_fake_t* fake, xcb_window_t parent,
+                                xcb_rectangle_t rect, int border_width);
+
+/**
+ * Get a window to change its attributes directly.
+ *
+ * returns: the window, or NULL if it doesn't exist
+ */
+x_fake_window_t* x_fake_window (x_fake_t* fake, xcb_window_t window);
+
+/**
+ * Set a property on a window, replacing any existing value.
+ *
+ * value: `value_length` bytes, copied
+ *
+ * returns: 0 on success, -1 if the window doesn't exist or memory can't be
+ *     allocated
+ */
+int x_fake_set_property (x_fake_t* fake, xcb_window_t window,
+                         xcb_atom_t atom, xcb_atom_t type,
+                         void* value, int value_length);
+
+/**
+ * Set up a backend that sends requests to a fake server.
+ *
+ * backend (output): the backend; doesn't need freeing
+ */
+void x_fake_backend (x_fake_t* fake, x_backend_t* backend);
+
+/**
+ * Count the requests sent so far of each kind.
+ *
+ * counts (output): indexed by X_FAKE_* kind; has size `X_FAKE_KINDS_SIZE`
+ */
+void x_fake_count_requests (x_fake_t* fake, int* counts);
+
+
+#endif
@@ -0,0 +1,155 @@
+/*
+
+Licensed under the Apache License, Version 2.0 (the "License"); you may not use
+this file except in compliance with the License. You may obtain a copy of the
+License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software distributed
+under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+CONDITIONS OF ANY KIND, either express or implied. See the License for the
+specific language governing permissions and limitations under the License.
+
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include "x-backend.h"
+
+
+// -- requests
+
+unsigned int _x_xcb_query_tree (void* data, xcb_window_t window) {
+    return xcb_query_tree((xcb_connection_t*)data, window).sequence;
+}
+
+
+int _x_xcb_query_tree_reply (void* data, unsigned int request,
+                             xcb_window_t** children, int* children_size) {
+    xcb_query_tree_cookie_t cookie = { request };
+    xcb_query_tree_reply_t* qtr;
+    if (!(qtr = xcb_query_tree_reply((xcb_connection_t*)data, cookie, NULL))) {
+        return -1;
+    }
+    int size = xcb_query_tree_children_length(qtr);
+    // copy for easier usage
+    *children = calloc(size, sizeof(xcb_window_t));
+    memcpy(*children, xcb_query_tree_children(qtr),
+           size * sizeof(xcb_window_t));
+    *children_size = size;
+    free(qtr);
+    return 0;
+}
+
+
+unsigned int _x_xcb_get_property (void* data, xcb_window_t window,
+                                  xcb_atom_t property, xcb_atom_t type,
+                                  uint32_t length) {
+    return xcb_get_property((xcb_connection_t*)data, 0, window, property, type,
+                            0, length).sequence;
+}
+
+
+int _x_xcb_get_property_reply (void* data, unsigned int request,
+                               xcb_atom_t* type,
+                               void** value, int* value_length) {
+    xcb_get_property_cookie_t cookie = { request };
+    xcb_get_property_reply_t* gpr;
+    if (!(gpr = xcb_get_property_reply((xcb_connection_t*)data, cookie,
+                                       NULL))) {
+        return -1;
+    }
+    *type = gpr->type;
+    int length = xcb_get_property_value_length(gpr);
+    // calloc'd memory is suitably aligned for 32-bit values
+    *value = calloc(length + 1, 1);
+    memcpy(*value, xcb_get_property_value(gpr), length);
+    *value_length = length;
+    free(gpr);
+    return 0;
+}
+
+
+unsigned int _x_xcb_get_window_attributes (void* data, xcb_window_t window) {
+    return xcb_get_window_attributes((xcb_connection_t*)data,
+                                     window).sequence;
+}
+
+
+int _x_xcb_get_window_attributes_reply (void* data, unsigned int request,
+                                        int* viewable, int* override_redirect) {
+    xcb_get_window_attributes_cookie_t cookie = { request };
+    xcb_get_window_attributes_reply_t* gwar;
+    if (!(gwar = xcb_get_window_attributes_reply((xcb_connection_t*)data,
+                                                 cookie, NULL))) {
+        return -1;
+    }
+    *viewable = gwar->map_state == XCB_MAP_STATE_VIEWABLE;
+    *override_redirect = gwar->override_redirect;
+    free(gwar);
+    return 0;
+}
+
+
+unsigned int _x_xcb_get_geometry (void* data, xcb_window_t window) {
+    // an xcb_window_t is an xcb_drawable_t
+    return xcb_get_geometry((xcb_connection_t*)data, window).sequence;
+}
+
+
+int _x_xcb_get_geometry_reply (void* data, unsigned int request,
+                               xcb_rectangle_t* rect, int* border_width) {
+    xcb_get_geometry_cookie_t cookie = { request };
+    xcb_get_geometry_reply_t* ggr;
+    if (!(ggr = xcb_get_geometry_reply((xcb_connection_t*)data, cookie,
+                                       NULL))) {
+        return -1;
+    }
+    rect->x = ggr->x;
+    rect->y = ggr->y;
+    rect->width = ggr->width;
+    rect->height = ggr->height;
+    *border_width = ggr->border_width;
+    free(ggr);
+    return 0;
+}
+
+
+unsigned int _x_xcb_translate_coordinates (void* data, xcb_window_t window,
+                                           xcb_window_t relative_to) {
+    return xcb_translate_coordinates((xcb_connection_t*)data, window,
+                                     relative_to, 0, 0).sequence;
+}
+
+
+int _x_xcb_translate_coordinates_reply (void* data, unsigned int request,
+                                        int* x, int* y) {
+    xcb_translate_coordinates_cookie_t cookie = { request };
+    xcb_translate_coordinates_reply_t* tcr;
+    if (!(tcr = xcb_translate_coordinates_reply((xcb_connection_t*)data,
+                                                cookie, NULL))) {
+        return -1;
+    }
+    *x = tcr->dst_x;
+    *y = tcr->dst_y;
+    free(tcr);
+    return 0;
+}
+
+
+// -- public functions
+
+void x_backend_xcb (xcb_connection_t* xcon, x_backend_t* backend) {
+    backend->data = xcon;
+    backend->query_tree = _x_xcb_query_tree;
+    backend->query_tree_reply = _x_xcb_query_tree_reply;
+    backend->get_property = _x_xcb_get_property;
+    backend->get_property_reply = _x_xcb_get_property_reply;
+    backend->get_window_attributes = _x_xcb_get_window_attributes;
+    backend->get_window_attributes_reply = _x_xcb_get_window_attributes_reply;
+    backend->get_geometry = _x_xcb_get_geometry;
+    backend->get_geometry_reply = _x_xcb_get_geometry_reply;
+    backend->translate_coordinates = _x_xcb_translate_coordinates;
+    backend->translate_coordinates_reply = _x_xcb_translate_coordinates_reply;
+}
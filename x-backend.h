@@ -0,0 +1,84 @@
+/*
+
+Licensed under the Apache License, Version 2.0 (the "License"); you may not use
+this file except in compliance with the License. You may obtain a copy of the
+License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software distributed
+under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+CONDITIONS OF ANY KIND, either express or implied. See the License for the
+specific language governing permissions and limitations under the License.
+
+*/
+
+#ifndef XCW_X_BACKEND_H
+#define XCW_X_BACKEND_H
+
+#include <stdint.h>
+#include <xcb/xcb.h>
+
+
+// -- types
+
+/**
+ * The X requests used to find windows, so that they can be sent to a real X
+ * server or simulated.  Each request is sent by one function and its reply
+ * waited for by another, so any number of requests can be in flight at once.
+ * Every request must have its reply waited for exactly once.
+ *
+ * Functions that send a request return an ID for it.  Functions that wait for
+ * a reply return 0 on success, or -1 if the request failed (for example,
+ * because the window no longer exists); outputs are only set on success, and
+ * arrays they point to should be freed.
+ *
+ * data: passed to every function
+ * query_tree: children of a window, bottom first
+ * get_property: up to `length` 32-bit units of a property's value; the reply's
+ *     `type` is XCB_NONE if the property isn't set, `value_length` is in
+ *     bytes, and `value` is followed by a null byte
+ * get_window_attributes: whether a window is viewable and whether it is
+ *     override-redirect
+ * get_geometry: a window's outer position relative to its parent, its inner
+ *     size, and its border width
+ * translate_coordinates: the position of a window's origin relative to another
+ *     window's origin
+ */
+typedef struct x_backend_t {
+    void* data;
+    unsigned int (*query_tree) (void* data, xcb_window_t window);
+    int (*query_tree_reply) (void* data, unsigned int request,
+                             xcb_window_t** children, int* children_size);
+    unsigned int (*get_property) (void* data, xcb_window_t window,
+                                  xcb_atom_t property, xcb_atom_t type,
+                                  uint32_t length);
+    int (*get_property_reply) (void* data, unsigned int request,
+                               xcb_atom_t* type,
+                               void** value, int* value_length);
+    unsigned int (*get_window_attributes) (void* data, xcb_window_t window);
+    int (*get_window_attributes_reply) (void* data, unsigned int request,
+                                        int* viewable, int* override_redirect);
+    unsigned int (*get_geometry) (void* data, xcb_window_t window);
+    int (*get_geometry_reply) (void* data, unsigned int request,
+                               xcb_rectangle_t* rect, int* border_width);
+    unsigned int (*translate_coordinates) (void* data, xcb_window_t window,
+                                           xcb_window_t relative_to);
+    int (*translate_coordinates_reply) (void* data, unsigned int request,
+                                        int* x, int* y);
+} x_backend_t;
+
+
+// -- functions
+
+/**
+ * Set up a backend that sends requests over a connection to an X server.
+ * Request IDs are sequence numbers, so requests are sent in the order they're
+ * made, and waiting for a reply flushes.
+ *
+ * backend (output): the backend; doesn't need freeing
+ */
+void x_backend_xcb (xcb_connection_t* xcon, x_backend_t* backend);
+
+
+#endif
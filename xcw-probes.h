@@ -0,0 +1,76 @@
+/*
+
+Licensed under the Apache License, Version 2.0 (the "License"); you may not use
+this file except in compliance with the License. You may obtain a copy of the
+License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software distributed
+under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+CONDITIONS OF ANY KIND, either express or implied. See the License for the
+specific language governing permissions and limitations under the License.
+
+*/
+
+#ifndef XCW_PROBES_H
+#define XCW_PROBES_H
+
+
+/*
+
+USDT probes, for tracing with perf, bpftrace or SystemTap without a debug
+build.  They're only compiled in with XCW_USDT defined (`make USDT=1`), which
+needs sys/sdt.h from SystemTap.  An enabled probe is a single nop until a
+tracer attaches to it; without XCW_USDT, probes compile to nothing.
+
+Probes are in the `xcw' provider:
+
+choose_start (): `xcw_choose_window` was called
+choose_done (status, window): choosing finished, with its result, as in xcw.h
+tracked_windows_start (): finding windows started
+tracked_windows_done (status, windows_size): finding windows finished, with
+    0 or -1, and the number of windows found
+window_setup (window, character): a setup structure was made for a window,
+    whose label ends with `character` (0 with --search)
+draw_text (window, text_length, text_width): a label was drawn on an overlay
+keypress_start (keycode, keysym, depth): a key press is being handled, with
+    the keysym it produces (0 if it isn't a key we use), and the number of
+    characters typed so far
+keypress_done (status, depth): a key press has been handled, with the status
+    of choosing (2 while still choosing), and the number of characters typed
+window_chosen (window, depth): a window was chosen, after typing `depth`
+    characters
+free_start (size), free_done (size): a batch of setup structures replaced by
+    typing or relabelling is being freed by the render thread
+
+For example, to see how long key presses take to handle:
+
+    bpftrace -e '
+        usdt:./xorg-choose-window:xcw:keypress_start { @start[tid] = nsecs; }
+        usdt:./xorg-choose-window:xcw:keypress_done /@start[tid]/ {
+            @usecs = hist((nsecs - @start[tid]) / 1000); delete(@start[tid]);
+        }'
+
+*/
+
+#ifdef XCW_USDT
+
+#include <sys/sdt.h>
+
+#define XCW_PROBE0(name) DTRACE_PROBE(xcw, name)
+#define XCW_PROBE1(name, a) DTRACE_PROBE1(xcw, name, a)
+#define XCW_PROBE2(name, a, b) DTRACE_PROBE2(xcw, name, a, b)
+#define XCW_PROBE3(name, a, b, c) DTRACE_PROBE3(xcw, name, a, b, c)
+
+#else
+
+#define XCW_PROBE0(name)
+#define XCW_PROBE1(name, a)
+#define XCW_PROBE2(name, a, b)
+#define XCW_PROBE3(name, a, b, c)
+
+#endif
+
+
+#endif
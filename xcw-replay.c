@@ -0,0 +1,247 @@
+/*
+
+Licensed under the Apache License, Version 2.0 (the "License"); you may not use
+this file except in compliance with the License. You may obtain a copy of the
+License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software distributed
+under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+CONDITIONS OF ANY KIND, either express or implied. See the License for the
+specific language governing permissions and limitations under the License.
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "window-discovery.h"
+#include "discovery-trace.h"
+#include "x-backend-fake.h"
+
+
+/*
+
+Replays a trace recorded with --record: finds windows again using the recorded
+replies, with each reply taking as long as it did when recorded, and types the
+recorded keys against the recorded labels.  Prints what happened, and exits
+with status 1 if the result differs from the recording (such as after
+changing how windows are found), or 2 if the trace can't be read.
+
+*/
+
+
+// -- constants
+
+/**
+ * Results of choosing, as in xcw.h, which this doesn't depend on.
+ */
+int STATUS_CHOSEN = 0;
+int STATUS_NO_MATCH = 1;
+int STATUS_ERROR = -1;
+
+
+// -- replaying
+
+/**
+ * Determine whether the recorded run asked for window names, which changes
+ * the requests sent.
+ */
+int trace_wants_names (trace_t* trace) {
+    for (int i = 0; i < trace->requests_size; i++) {
+        trace_request_t* r = &(trace->requests[i]);
+        if (r->kind == X_FAKE_GET_PROPERTY &&
+            r->other == trace->discovery.name) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+
+/**
+ * Find windows using the recorded replies, and compare them with the windows
+ * that were labelled.
+ *
+ * returns: 0 if the same windows were found, 1 otherwise
+ */
+int replay_discovery (trace_t* trace) {
+    trace_replay_t replay;
+    x_backend_t backend;
+    trace_replay_backend(trace, &replay, &backend);
+    discovery_t discovery = trace->discovery;
+    discovery.backend = &backend;
+    discovery.filter = trace->has_filter ? &(trace->filter) : NULL;
+
+    xcb_window_t* windows;
+    xcb_window_t* tops;
+    xcb_rectangle_t* rects;
+    char** names = NULL;
+    int size;
+    int status = discovery_find_windows(
+        &discovery, &windows, &tops, &rects,
+        trace_wants_names(trace) ? &names : NULL, &size);
+
+    double recorded_start = 0;
+    double recorded_end = 0;
+    for (int i = 0; i < trace->requests_size; i++) {
+        trace_request_t* r = &(trace->requests[i]);
+        if (i == 0 || r->sent < recorded_start) recorded_start = r->sent;
+        if (r->replied > recorded_end) recorded_end = r->replied;
+    }
+    printf("requests: %d replayed, %d recorded, %d not recorded\n",
+           replay.pending_size, trace->requests_size, replay.unrecorded);
+    printf("finding windows: %.2f ms in %d round trips replayed, "
+           "%.2f ms recorded\n", replay.clock * 1e3, replay.round_trips,
+           (recorded_end - recorded_start) * 1e3);
+    trace_replay_free(&replay);
+    if (status != 0) {
+        printf("finding windows failed: %s\n", discovery.error);
+        return 1;
+    }
+
+    int missing = 0;
+    for (int i = 0; i < trace->labels_size; i++) {
+        int found = 0;
+        for (int j = 0; j < size && !found; j++) {
+            found = windows[j] == trace->labelled[i];
+        }
+        if (!found) {
+            printf("missing window: 0x%x\n", trace->labelled[i]);
+            missing += 1;
+        }
+    }
+    printf("windows: %d found, %d recorded\n", size, trace->labels_size);
+    if (names != NULL) {
+        for (int i = 0; i < size; i++) free(names[i]);
+        free(names);
+    }
+    free(windows);
+    free(tops);
+    free(rects);
+    return missing == 0 && size == trace->labels_size ? 0 : 1;
+}
+
+
+/**
+ * Find how the typed characters match the recorded labels.
+ *
+ * typed: the characters typed so far
+ * match (output): the index of the label equal to `typed`, if any
+ *
+ * returns: 2 if a label is `typed`, 1 if labels only start with it, 0 if none
+ *     do
+ */
+int replay_match (trace_t* trace, char* typed, int* match) {
+    size_t typed_size = strlen(typed);
+    int prefix = 0;
+    for (int i = 0; i < trace->labels_size; i++) {
+        if (strncmp(trace->labels[i], typed, typed_size) != 0) continue;
+        if (trace->labels[i][typed_size] == '\0') {
+            *match = i;
+            return 2;
+        }
+        prefix = 1;
+    }
+    return prefix;
+}
+
+
+/**
+ * Type the recorded keys against the recorded labels, as choosing does: a
+ * window is only chosen once its whole label is typed, even if no other label
+ * starts the same way, as happens with stable labels.
+ *
+ * chosen (output): the window chosen, with STATUS_CHOSEN
+ *
+ * returns: the result: STATUS_CHOSEN or STATUS_NO_MATCH, or STATUS_ERROR if
+ *     the keys ran out first
+ */
+int replay_keys (trace_t* trace, xcb_window_t* chosen) {
+    if (trace->labels_size == 0) return STATUS_NO_MATCH;
+    char* typed = calloc(trace->keys_size + 2, sizeof(char));
+    int depth = 0;
+    int match;
+    if (trace->labels_size == 1) {
+        // the only window is chosen, or its first character typed, at once
+        if (trace->labels[0][0] == '\0' || trace->labels[0][1] == '\0') {
+            free(typed);
+            *chosen = trace->labelled[0];
+            return STATUS_CHOSEN;
+        }
+        typed[depth] = trace->labels[0][0];
+        depth += 1;
+    }
+    int status = STATUS_ERROR;
+    for (int k = 0; k < trace->keys_size && status == STATUS_ERROR; k++) {
+        char key = trace->keys[k];
+        if (key == '\b') {
+            if (depth > 0) depth -= 1;
+            typed[depth] = '\0';
+            continue;
+        } else if (key == '\0') {
+            status = STATUS_NO_MATCH;
+            break;
+        }
+        typed[depth] = key;
+        int matched = replay_match(trace, typed, &match);
+        if (matched == 0) {
+            status = STATUS_NO_MATCH;
+        } else if (matched == 2) {
+            *chosen = trace->labelled[match];
+            status = STATUS_CHOSEN;
+        } else {
+            depth += 1;
+        }
+    }
+    free(typed);
+    return status;
+}
+
+
+/**
+ * Print a result of choosing.
+ */
+void print_result (char* prefix, int status, xcb_window_t chosen) {
+    if (status == STATUS_CHOSEN) printf("%s: chose 0x%x\n", prefix, chosen);
+    else if (status == STATUS_NO_MATCH) printf("%s: no match\n", prefix);
+    else printf("%s: failed or unfinished\n", prefix);
+}
+
+
+int main (int argc, char** argv) {
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s TRACE\n", argv[0]);
+        return 2;
+    }
+    trace_t trace;
+    char* error;
+    if (trace_read(argv[1], &trace, &error) != 0) {
+        fprintf(stderr, "%s: %s\n", argv[1], error);
+        return 2;
+    }
+
+    int failures = replay_discovery(&trace);
+    int searched = trace.labels_size > 0 && trace.labels[0][0] == '\0';
+    if (trace.keys_size > 0) {
+        printf("keys: %d typed over %.1f ms\n", trace.keys_size,
+               (trace.key_times[trace.keys_size - 1] -
+                trace.key_times[0]) * 1e3);
+    }
+    print_result("recorded", trace.status, trace.chosen);
+    if (searched) {
+        // choosing by name depends on the search index, which isn't replayed
+        printf("replayed: not replayed, since windows were searched\n");
+    } else if (trace.status != STATUS_ERROR) {
+        xcb_window_t chosen = XCB_NONE;
+        int status = replay_keys(&trace, &chosen);
+        print_result("replayed", status, chosen);
+        if (status != trace.status ||
+            (status == STATUS_CHOSEN && chosen != trace.chosen)) {
+            failures += 1;
+        }
+    }
+    trace_free(&trace);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,4646 @@
+/*
+
+Licensed under the Apache License, Version 2.0 (the "License"); you may not use
+this file except in compliance with the License. You may obtain a copy of the
+License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software distributed
+under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+CONDITIONS OF ANY KIND, either express or implied. See the License for the
+specific language governing permissions and limitations under the License.
+
+*/
+
+#include <time.h>
+#include <unistd.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <xcb/xcb.h>
+#include <xcb/xcbext.h>
+#include <xcb/xcb_icccm.h>
+#include <xcb/xcb_ewmh.h>
+#include <xcb/randr.h>
+#include "label-plan.h"
+#include "label-store.h"
+#include "x-backend.h"
+#include "window-filter.h"
+#include "window-discovery.h"
+#include "title-index.h"
+#include "discovery-trace.h"
+#include "xcw-probes.h"
+#include "xcw.h"
+
+
+// TODO (fixes)
+// mask usages (x3): what should the order be?  doc says just pass in one
+// structure for wsetup.overlay_*, wsetup.window
+
+// TODO (improvements)
+// larger default font
+// configurable font/text size/colours
+// manpage
+//  - mention in readme
+//  - move exit status info from --help
+
+
+// -- types
+
+/**
+ * Part of a keysym lookup, used to translate between keysyms and characters.
+ *
+ * character: the ASCII character
+ * keysym: the Xorg keysym to interpret the character as
+ */
+typedef struct keysyms_lookup_t {
+    char character;
+    xcb_keysym_t keysym;
+} keysyms_lookup_t;
+
+/**
+ * A recursive structure holding data about windows, used to track the windows
+ * we care about.  At most one of `window` (paired with `overlay_*`) and
+ * `children` is non-NULL; if both are NULL, the item is an empty slot for a
+ * key no label uses at that point, which only happens with stable labels.
+ * Items in an array of these structures are in the same order as `ksl` in
+ * `xcw_input_t`, so that the item at index `i` has the character at index `i`
+ * in `ksl`.
+ *
+ * ?overlay_window: the window we created over the top of the tracked window
+ * ?overlay_font_gc: for drawing the text on `overlay_window`
+ * ?overlay_bg_gc: for drawing the background on `overlay_window`
+ * ?overlay_rect: the on-screen area covered by `overlay_window`
+ * ?overlay_text: the text currently drawn on `overlay_window` (a suffix of
+ *     `label`), or NULL if it needs to be redrawn
+ * overlay_shown: the render thread's generation when `overlay_window` was last
+ *     shown, or 0 if it's unmapped
+ * ?window: the pre-existing tracked window
+ * ?label: the full string that must be typed to select `window`, in
+ *     `labels` in `xcw_state_t`
+ * character: the character that must be typed to select `window`, or to descend
+ *     into `children`
+ * ?children: the continuation of the structure
+ * children_size: size of `children` (0 if `children` is NULL)
+ */
+typedef struct window_setup_t {
+    xcb_window_t* overlay_window;
+    xcb_gcontext_t* overlay_font_gc;
+    xcb_gcontext_t* overlay_bg_gc;
+    xcb_rectangle_t* overlay_rect;
+    char* overlay_text;
+    int overlay_shown;
+    xcb_window_t* window;
+    char* label;
+    char character;
+    struct window_setup_t* children;
+    int children_size;
+} window_setup_t;
+
+/**
+ * Part of an anchor lookup, used to translate between names and positions.
+ *
+ * name: the name used in command-line arguments
+ * x, y: position along each axis: ANCHOR_START, ANCHOR_CENTRE or ANCHOR_END
+ */
+typedef struct anchor_lookup_t {
+    char* name;
+    short x;
+    short y;
+} anchor_lookup_t;
+
+/**
+ * A tracked window with information used to order tracked windows by position.
+ *
+ * window: the tracked window
+ * top: the child of the root window containing `window`
+ * rect: absolute area to cover for `window`
+ * monitor: index of the monitor containing `window`
+ * cx, cy: centre of `rect`
+ * name: the name of `window` from `discovery_find_windows`, or NULL
+ */
+typedef struct window_place_t {
+    xcb_window_t window;
+    xcb_window_t top;
+    xcb_rectangle_t rect;
+    int monitor;
+    int cx;
+    int cy;
+    char* name;
+} window_place_t;
+
+/**
+ * A tracked window's priority for drawing its overlay window.
+ *
+ * index: index of the window in label order
+ * away: 0 if the window is on the monitor under the pointer, otherwise 1
+ * distance: squared distance from the focused window
+ */
+typedef struct window_paint_t {
+    int index;
+    int away;
+    long long distance;
+} window_paint_t;
+
+/**
+ * A tracked window, with what's needed to follow changes to its geometry.
+ *
+ * window: the tracked window
+ * top: the child of the root window containing `window` (may be `window`)
+ * rect: absolute area to cover for `window`
+ * top_x, top_y: position of `top`, used to move `rect` when `top` moves (only
+ *     set if `top` isn't `window`)
+ * name: the name of `window` from `discovery_find_windows`, used to rebuild
+ *     the search index, or to find its remembered label (only set with
+ *     `--search` or stable labels)
+ */
+typedef struct tracked_window_t {
+    xcb_window_t window;
+    xcb_window_t top;
+    xcb_rectangle_t rect;
+    int top_x;
+    int top_y;
+    char* name;
+} tracked_window_t;
+
+/**
+ * An overlay window that isn't in use, kept so it can be reused instead of
+ * creating another.
+ *
+ * window: the unmapped overlay window
+ * font_gc, bg_gc: graphics contexts for drawing on `window`, or XCB_NONE if
+ *     they haven't been created
+ */
+typedef struct pooled_overlay_t {
+    xcb_window_t window;
+    xcb_gcontext_t font_gc;
+    xcb_gcontext_t bg_gc;
+} pooled_overlay_t;
+
+/**
+ * Overlay windows that aren't in use.  When it runs out, the pool grows by the
+ * number of overlay windows created so far.  The pool is kept across choices
+ * with the connection its windows belong to, so that choosing again on a
+ * similar screen creates no windows.
+ *
+ * idle: overlay windows available for use
+ * idle_size: number of items in `idle`
+ * idle_capacity: allocated size of `idle`
+ * created_size: number of overlay windows created so far, in use or not
+ * idle_max: maximum number of unused windows to keep; any more are destroyed
+ *     as they're given back.  This is `OVERLAY_POOL_IDLE_MAX` while choosing,
+ *     and raised when a choice finishes, so that every window is kept for the
+ *     next one.
+ */
+typedef struct overlay_pool_t {
+    pooled_overlay_t* idle;
+    int idle_size;
+    int idle_capacity;
+    int created_size;
+    int idle_max;
+} overlay_pool_t;
+
+/**
+ * Options for choosing a window (`xcw_options_t` in xcw.h), and atoms and
+ * overlay windows remembered from the last time they were used.
+ *
+ * ksl: keys available for use, or NULL if none were given
+ * blacklist: windows which should be ignored
+ * whitelist: windows which should be included
+ * visible_only: whether to ignore windows covered by other windows, and only
+ *     cover the visible part of each window
+ * overlay_size: OVERLAY_SIZE_FULL or OVERLAY_SIZE_LABEL
+ * anchor: where to place overlays with OVERLAY_SIZE_LABEL
+ * action: what to do to the chosen window: ACTION_NONE, ACTION_FOCUS,
+ *     ACTION_CLOSE, ACTION_RAISE, ACTION_MINIMIZE or ACTION_DESKTOP
+ * action_desktop: desktop index to move the chosen window to, with
+ *     ACTION_DESKTOP
+ * filter: windows must match this to be included, or NULL
+ * filter_sources: the expressions `filter` was compiled from, for recording
+ * search: whether windows are chosen by typing part of their names instead of
+ *     their labels
+ * label_store: labels remembered across runs, or NULL to label windows by
+ *     position
+ * record_path: file to record each choice to (see discovery-trace.h), or
+ *     NULL
+ * instance: what to do when another chooser is running on the display:
+ *     INSTANCE_WAIT, INSTANCE_REPLACE or INSTANCE_IGNORE
+ * click: whether clicking an overlay window chooses its window
+ * display: name of the display `render_xcon` is opened on, or NULL for
+ *     $DISPLAY; must be the display choosing uses
+ * event_handler: called with events received while choosing, or NULL
+ * event_handler_data: passed to `event_handler`
+ * paint_handler: called when overlays have been drawn, or NULL
+ * paint_handler_data: passed to `paint_handler`
+ * atoms_xcon: the connection `ewmh`, `wm_state` and `wm_change_state` were
+ *     interned on, or NULL if they haven't been
+ * ewmh: EWMH atoms, and the state for `xcb_ewmh`
+ * wm_state: the WM_STATE atom
+ * wm_change_state: the WM_CHANGE_STATE atom, or XCB_NONE if it hasn't been
+ *     needed
+ * instance_atoms: atoms named by `INSTANCE_ATOM_NAMES`, or XCB_NONE if they
+ *     haven't been needed; has size `INSTANCE_ATOMS_SIZE`
+ * render_xcon: the render thread's connection, or NULL if it hasn't been
+ *     opened
+ * render_xcon_for: the connection passed to `xcw_choose_window` that
+ *     `render_xcon` was opened alongside; choosing on another connection
+ *     opens it again
+ * overlay_pool: unused overlay windows created on `render_xcon`
+ */
+typedef struct xcw_input_t {
+    keysyms_lookup_t* ksl;
+    int ksl_size;
+    xcb_window_t* blacklist;
+    int blacklist_size;
+    xcb_window_t* whitelist;
+    int whitelist_size;
+    short visible_only;
+    short overlay_size;
+    anchor_lookup_t* anchor;
+    short action;
+    uint32_t action_desktop;
+    filter_t* filter;
+    char** filter_sources;
+    int filter_sources_size;
+    short search;
+    label_store_t* label_store;
+    char* record_path;
+    short instance;
+    short click;
+    char* display;
+    xcw_event_handler_t event_handler;
+    void* event_handler_data;
+    xcw_paint_handler_t paint_handler;
+    void* paint_handler_data;
+    xcb_connection_t* atoms_xcon;
+    xcb_ewmh_connection_t ewmh;
+    xcb_atom_t wm_state;
+    xcb_atom_t wm_change_state;
+    xcb_atom_t instance_atoms[3];
+    xcb_connection_t* render_xcon;
+    xcb_connection_t* render_xcon_for;
+    overlay_pool_t overlay_pool;
+} xcw_input_t;
+
+
+/**
+ * Requests sent to the X server at startup whose replies haven't been used yet.
+ * Every request that doesn't depend on another reply is sent before waiting
+ * for anything, and each reply is only waited for when it's needed, so that
+ * round trips overlap; with coordination, the requests for choosing wait until
+ * we own the instance selection (see `initialise_requests`).  A cookie's
+ * sequence number is 0 if the request wasn't sent or its reply has been used,
+ * so that replies left unused when giving up can be discarded.
+ *
+ * ewmh: interning EWMH atoms, for `xcb_ewmh_init_atoms_replies` (NULL if they
+ *     were already interned)
+ * wm_state: interning WM_STATE (not sent if already interned)
+ * keyboard_mapping: the keyboard mapping, used by `initialise_keycodes`
+ * open_font: opening `overlay_font` (not sent when listing windows)
+ * query_font: metrics for `overlay_font` (not sent when listing windows)
+ * grab_keyboard: the first attempt at grabbing the keyboard (not sent when
+ *     listing windows)
+ * wm_change_state: interning WM_CHANGE_STATE (only sent with ACTION_MINIMIZE,
+ *     if not already interned)
+ * root_attributes: the root window's attributes, for the event mask we
+ *     already selected (not sent when listing windows)
+ * query_pointer: the pointer's position, used by `initialise_paint_order` (not
+ *     sent when listing windows)
+ * input_focus: the focused window, used by `initialise_paint_order` (not sent
+ *     when listing windows)
+ * instance_atoms: interning `INSTANCE_ATOM_NAMES` (only sent when choosing
+ *     with coordination, if not already interned)
+ * instance_owner: the owner of the instance selection, used by
+ *     `initialise_instance` (only sent here if its atom was already interned)
+ */
+typedef struct xcw_cookies_t {
+    xcb_intern_atom_cookie_t* ewmh;
+    xcb_intern_atom_cookie_t wm_state;
+    xcb_get_keyboard_mapping_cookie_t keyboard_mapping;
+    xcb_void_cookie_t open_font;
+    xcb_query_font_cookie_t query_font;
+    xcb_grab_keyboard_cookie_t grab_keyboard;
+    xcb_intern_atom_cookie_t wm_change_state;
+    xcb_get_window_attributes_cookie_t root_attributes;
+    xcb_query_pointer_cookie_t query_pointer;
+    xcb_get_input_focus_cookie_t input_focus;
+    xcb_intern_atom_cookie_t instance_atoms[3];
+    xcb_get_selection_owner_cookie_t instance_owner;
+} xcw_cookies_t;
+
+/**
+ * A window whose event mask we changed, so that it can be restored.
+ *
+ * window: the window
+ * event_mask: the event mask we had selected before
+ */
+typedef struct masked_window_t {
+    xcb_window_t window;
+    uint32_t event_mask;
+} masked_window_t;
+
+/**
+ * An entry in `overlay_owners_t`, also passed to the input thread when its
+ * overlay window is clicked.
+ *
+ * overlay: an overlay window in use, or XCB_NONE for an empty slot
+ * window: the tracked window it covers
+ * index: the position of `window` in `state->tracked`, which is the position
+ *     of its leaf among the leaves of `wsetups_root`
+ */
+typedef struct overlay_owner_t {
+    xcb_window_t overlay;
+    xcb_window_t window;
+    int index;
+} overlay_owner_t;
+
+/**
+ * Hash table from overlay windows in use to the tracked windows they cover,
+ * kept up to date as overlay windows are taken from the pool, given back and
+ * moved by relabelling, so that a click on an overlay window is resolved
+ * without walking the setup structure.  Collisions are resolved by linear
+ * probing.
+ *
+ * slots: the table; has size `capacity`
+ * capacity: a power of two, at least twice `size`, or 0 before the first entry
+ * size: number of slots in use
+ */
+typedef struct overlay_owners_t {
+    overlay_owner_t* slots;
+    int capacity;
+    int size;
+} overlay_owners_t;
+
+/**
+ * A level of the setup structure: the state after typing some characters.
+ * Handed from the input thread to the render thread, and used to remember
+ * earlier states for BackSpace.
+ *
+ * wsetups: array of setup structures reachable by typing
+ * depth: number of characters typed to reach `wsetups`
+ * wsetups_root: the top level of the structure containing `wsetups`
+ */
+typedef struct xcw_level_t {
+    window_setup_t* wsetups;
+    int wsetups_size;
+    int depth;
+    window_setup_t* wsetups_root;
+    int wsetups_root_size;
+} xcw_level_t;
+
+/**
+ * A setup structure replaced by relabelling, handed from the input thread to
+ * the render thread to be freed.  Its overlay windows are reused for the same
+ * windows in the new structure.  Forms a stack.
+ *
+ * wsetups: top level of the replaced structure
+ * labels: label pool used by `wsetups`
+ * next: the next item in the stack, or NULL
+ */
+typedef struct xcw_garbage_t {
+    window_setup_t* wsetups;
+    int wsetups_size;
+    char* labels;
+    struct xcw_garbage_t* next;
+} xcw_garbage_t;
+
+/**
+ * A new position for a tracked window, handed from the input thread to the
+ * render thread.  Forms a stack.
+ *
+ * window: the tracked window
+ * rect: absolute area to cover for `window`
+ * next: the next item in the stack, or NULL
+ */
+typedef struct xcw_move_t {
+    xcb_window_t window;
+    xcb_rectangle_t rect;
+    struct xcw_move_t* next;
+} xcw_move_t;
+
+/**
+ * State of a search with `--search`.  Typing narrows down the tracked windows
+ * to those whose names contain the typed text, and each step is kept so that
+ * BackSpace can undo it.  Only used by the input thread.
+ *
+ * index: names of the tracked windows, in the same order as `wsetups_root`
+ * query: characters typed so far, null-terminated, or NULL if none
+ * query_size: number of characters in `query`
+ * matches: for each length of `query` from 1, indices in `wsetups_root` of the
+ *     windows whose names contain that much of `query`, in ascending order
+ * matches_sizes: size of each item in `matches`
+ * levels: for each item in `matches`, a setup structure for each matching
+ *     window, with the window's structure in `wsetups_root` as its only child;
+ *     these are published to the render thread as levels
+ * retired: levels undone by BackSpace, to be discarded once the level
+ *     replacing them is published
+ */
+typedef struct xcw_search_t {
+    title_index_t index;
+    char* query;
+    int query_size;
+    int** matches;
+    int* matches_sizes;
+    window_setup_t** levels;
+    window_setup_t** retired;
+    int retired_size;
+} xcw_search_t;
+
+struct xcw_render_t;
+
+/**
+ * Collection of data needed while choosing a window.
+ *
+ * status: XCW_RUNNING until a window is chosen (XCW_CHOSEN), no window can be
+ *     (XCW_NO_MATCH) or something fails (XCW_ERROR)
+ * error: with XCW_ERROR, a description of the problem (see `xcw_state_fail`)
+ * chosen: the chosen window, with XCW_CHOSEN
+ * list: whether windows are only being listed, so nothing is drawn
+ * started: when choosing started, for `input->paint_handler`
+ * xcon: the connection to the X server, owned by the caller
+ * xroot: the root window
+ * ewmh: the state for `xcb_ewmh`, owned by `input` (not initialised until
+ *     `initialise_atoms`)
+ * wm_change_state: the WM_CHANGE_STATE atom (only initialised by
+ *     `initialise_atoms` with ACTION_MINIMIZE)
+ * cookies: requests sent at startup
+ * root_event_mask: the event mask we had selected on the root window before
+ *     selecting substructure events (only set if `root_events_selected`)
+ * root_events_selected: whether the root window's event mask was changed
+ * masked: windows inside frames whose event masks were changed
+ * backend: sends the requests used to find windows over `xcon`, through
+ *     `recorder` if there is one
+ * recorder: records the choice, with `input->record_path`, or NULL
+ * discovery: settings for finding windows with `backend`; atoms are not
+ *     initialised until `initialise_atoms`
+ * monitors: absolute area of each monitor, if RandR knows them, in the order
+ *     used by `order_windows`
+ * ksl: keys available for use: `input->ksl`, or all of `ALL_KEYSYMS_LOOKUP`
+ *     with `--search` if none were given
+ * keycodes_ksl: for each keycode, the index of the item in `ksl` it produces,
+ *     KEYCODES_KSL_BACKSPACE if it produces BackSpace, or -1 if it doesn't
+ *     produce either; has size `KEYCODES_SIZE`
+ * overlay_font: font used to render text on overlays
+ * overlay_char_width: maximum width of a character in `overlay_font`
+ * overlay_char_widths: width of each character in `overlay_font`; has size 256
+ * overlay_font_ascent, overlay_font_descent: vertical extents of
+ *     `overlay_font`
+ * input: options for choosing
+ * overlay_pool: unused overlay windows created on `xcon`, kept in `input`
+ *     (only used by the render thread)
+ * overlay_owners: tracked windows covered by overlay windows in use (only
+ *     used by the render thread)
+ * labels: null-terminated labels of all tracked windows, concatenated
+ * wsetups: array of setup structures
+ * wsetups_root: the top level of the setup structure, which is kept whole so
+ *     that typed characters can be undone
+ * depth: number of characters typed so far
+ * history: the levels above `wsetups`, top first, with size `depth` (only kept
+ *     by the input thread)
+ * level_changed: whether typing has changed the current level since it was
+ *     last published to the render thread (only kept by the input thread)
+ * tracked: tracked windows, in label order (only kept up to date by the input
+ *     thread)
+ * search: with `--search`, the search so far (only kept by the input thread)
+ * instance_window: an unmapped window owning the instance selection while
+ *     choosing, or asking the chooser that does for its result; XCB_NONE if
+ *     there's no coordination
+ * instance_requests: requests for the result of choosing from other
+ *     instances, answered by `instance_release`
+ * render: data shared with the render thread (NULL when listing windows, and
+ *     in the render thread's copy of the state)
+ */
+typedef struct xcw_state_t {
+    int status;
+    char* error;
+    xcb_window_t chosen;
+    int list;
+    struct timespec started;
+    xcb_connection_t* xcon;
+    xcb_window_t xroot;
+    xcb_ewmh_connection_t ewmh;
+    xcb_atom_t wm_change_state;
+    xcw_cookies_t cookies;
+    uint32_t root_event_mask;
+    int root_events_selected;
+    masked_window_t* masked;
+    int masked_size;
+    x_backend_t backend;
+    trace_recorder_t* recorder;
+    discovery_t discovery;
+    xcb_rectangle_t* monitors;
+    int monitors_size;
+    keysyms_lookup_t* ksl;
+    int ksl_size;
+    int* keycodes_ksl;
+    xcb_font_t overlay_font;
+    int overlay_char_width;
+    int* overlay_char_widths;
+    int overlay_font_ascent;
+    int overlay_font_descent;
+    xcw_input_t* input;
+    overlay_pool_t* overlay_pool;
+    overlay_owners_t overlay_owners;
+    char* labels;
+    window_setup_t* wsetups;
+    int wsetups_size;
+    window_setup_t* wsetups_root;
+    int wsetups_root_size;
+    int depth;
+    xcw_level_t* history;
+    int level_changed;
+    tracked_window_t* tracked;
+    int tracked_size;
+    xcw_search_t search;
+    xcb_window_t instance_window;
+    xcb_selection_request_event_t* instance_requests;
+    int instance_requests_size;
+    struct xcw_render_t* render;
+} xcw_state_t;
+
+/**
+ * Data shared between the input thread, which reads key presses and chooses
+ * windows, and the render thread, which draws and destroys overlay windows.
+ * Each thread has its own connection to the X server, so that drawing never
+ * delays reading input.  Only the input thread walks the setup structure to
+ * handle input, and only the render thread touches overlay windows and frees
+ * the structure.
+ *
+ * state: the render thread's copy of the program state, with its own
+ *     connection; overlay windows are created on this connection, so Expose
+ *     events arrive on it; `wsetups`, `wsetups_root` and `depth` follow
+ *     `level`
+ * generation: incremented whenever the overlay windows shown change
+ * level: the most recent level published by the input thread that the render
+ *     thread hasn't taken yet, or NULL; owned by whichever thread removes it
+ * garbage: stack of structures replaced by relabelling, for the render thread
+ *     to free
+ * moves: stack of tracked windows whose overlay windows need moving
+ * quit: set by the input thread to stop the render thread
+ * wake_fds: pipe written to by the input thread after handing anything over
+ * stop_fds: pipe whose writing end is closed (and set to -1) by the render
+ *     thread if it stops because something failed, which wakes the input
+ *     thread; the failure is in `state`
+ * click_fds: pipe the render thread writes an `overlay_owner_t` to when its
+ *     overlay window is clicked, which wakes the input thread
+ * started: whether `thread` was started
+ * thread: the render thread
+ */
+typedef struct xcw_render_t {
+    xcw_state_t state;
+    int generation;
+    _Atomic(xcw_level_t*) level;
+    _Atomic(xcw_garbage_t*) garbage;
+    _Atomic(xcw_move_t*) moves;
+    atomic_int quit;
+    int wake_fds[2];
+    int stop_fds[2];
+    int click_fds[2];
+    int started;
+    pthread_t thread;
+} xcw_render_t;
+
+
+// -- constants
+
+/**
+ * Text colour for overlay windows.
+ */
+int FG_COLOUR = 0xffffffff;
+/**
+ * Name of the font used to render text on overlay windows.
+ */
+char* OVERLAY_FONT_NAME = "fixed";
+/**
+ * Background colour for overlay windows.
+ */
+int BG_COLOUR = 0xff333333;
+/**
+ * Space between the text and the edge of overlay windows, with
+ * OVERLAY_SIZE_LABEL.
+ */
+int LABEL_BOX_PADDING = 4;
+/**
+ * Minimum number of overlay windows to create when the pool runs out.
+ */
+int OVERLAY_POOL_MIN_GROWTH = 16;
+/**
+ * Maximum number of unused overlay windows to keep in the pool; any more are
+ * destroyed.
+ */
+int OVERLAY_POOL_IDLE_MAX = 64;
+/**
+ * Number of overlay windows created and drawn between flushes when they're
+ * first shown, so that the first labels don't wait for the rest.
+ */
+int OVERLAY_CHUNK_SIZE = 16;
+/**
+ * Window class set on overlay windows.
+ */
+#define OVERLAY_WINDOW_CLASS "overlay\0xorg-choose-window"
+/**
+ * Number of possible keycodes.
+ */
+#define KEYCODES_SIZE 256
+/**
+ * Value in `keycodes_ksl` for keycodes that produce BackSpace, which undoes the
+ * last typed character.
+ */
+#define KEYCODES_KSL_BACKSPACE -2
+/**
+ * The BackSpace keysym.
+ */
+xcb_keysym_t BACKSPACE_KEYSYM = 0xff08;
+/**
+ * Value of `status` in `xcw_state_t` while choosing, alongside the results in
+ * xcw.h.
+ */
+#define XCW_RUNNING 2
+/**
+ * Name of the ICCCM property set on client windows by the window manager.
+ */
+char* WM_STATE_NAME = "WM_STATE";
+/**
+ * Name of the ICCCM client message used to ask the window manager to iconify a
+ * window.
+ */
+char* WM_CHANGE_STATE_NAME = "WM_CHANGE_STATE";
+/**
+ * Maximum number of characters of a window's title drawn with `--search`.
+ */
+#define SEARCH_LABEL_MAX 40
+/**
+ * Number of windows requested from _NET_CLIENT_LIST.
+ */
+int MAX_WINDOWS = 1024;
+/*
+ * Overlay size options: cover the whole window, or just enough to show the
+ * label.
+ */
+short OVERLAY_SIZE_FULL = 0;
+short OVERLAY_SIZE_LABEL = 1;
+/*
+ * Actions performed on the chosen window before exiting.
+ */
+short ACTION_NONE = 0;
+short ACTION_FOCUS = 1;
+short ACTION_CLOSE = 2;
+short ACTION_RAISE = 3;
+short ACTION_MINIMIZE = 4;
+short ACTION_DESKTOP = 5;
+/*
+ * What to do when another chooser is already running on the display: wait for
+ * it to finish and take its result, ask it to stop and take over, or run
+ * alongside it (the keyboard grab then fails until it finishes).
+ */
+short INSTANCE_WAIT = 0;
+short INSTANCE_REPLACE = 1;
+short INSTANCE_IGNORE = 2;
+/**
+ * Names of atoms used to coordinate choosers: the selection owned by the
+ * running chooser, and the targets other instances convert it to, to ask for
+ * its result or to ask it to stop.  Indexed by the INSTANCE_ATOM_* constants.
+ */
+char* INSTANCE_ATOM_NAMES[] = { "_XCW_INSTANCE", "_XCW_RESULT", "_XCW_CANCEL" };
+#define INSTANCE_ATOM_SELECTION 0
+#define INSTANCE_ATOM_RESULT 1
+#define INSTANCE_ATOM_CANCEL 2
+#define INSTANCE_ATOMS_SIZE 3
+/*
+ * Positions along an axis, used for anchors.
+ */
+#define ANCHOR_START 0
+#define ANCHOR_CENTRE 1
+#define ANCHOR_END 2
+
+/**
+ * Allowed anchors for overlay windows.  The first item is the default.
+ */
+anchor_lookup_t ALL_ANCHORS_LOOKUP[] = {
+    {"centre", ANCHOR_CENTRE, ANCHOR_CENTRE},
+    {"top-left", ANCHOR_START, ANCHOR_START},
+    {"top", ANCHOR_CENTRE, ANCHOR_START},
+    {"top-right", ANCHOR_END, ANCHOR_START},
+    {"left", ANCHOR_START, ANCHOR_CENTRE},
+    {"right", ANCHOR_END, ANCHOR_CENTRE},
+    {"bottom-left", ANCHOR_START, ANCHOR_END},
+    {"bottom", ANCHOR_CENTRE, ANCHOR_END},
+    {"bottom-right", ANCHOR_END, ANCHOR_END}
+};
+/**
+ * Size of `ALL_ANCHORS_LOOKUP`.
+ */
+int ALL_ANCHORS_LOOKUP_SIZE = (
+    sizeof(ALL_ANCHORS_LOOKUP) / sizeof(*ALL_ANCHORS_LOOKUP));
+
+/**
+ * Keysyms with an obvious 1-character representation.  Only these characters
+ * may be used as input.
+ */
+keysyms_lookup_t ALL_KEYSYMS_LOOKUP[] = {
+    {'0', 0x0030},
+    {'1', 0x0031},
+    {'2', 0x0032},
+    {'3', 0x0033},
+    {'4', 0x0034},
+    {'5', 0x0035},
+    {'6', 0x0036},
+    {'7', 0x0037},
+    {'8', 0x0038},
+    {'9', 0x0039},
+    {'a', 0x0061},
+    {'b', 0x0062},
+    {'c', 0x0063},
+    {'d', 0x0064},
+    {'e', 0x0065},
+    {'f', 0x0066},
+    {'g', 0x0067},
+    {'h', 0x0068},
+    {'i', 0x0069},
+    {'j', 0x006a},
+    {'k', 0x006b},
+    {'l', 0x006c},
+    {'m', 0x006d},
+    {'n', 0x006e},
+    {'o', 0x006f},
+    {'p', 0x0070},
+    {'q', 0x0071},
+    {'r', 0x0072},
+    {'s', 0x0073},
+    {'t', 0x0074},
+    {'u', 0x0075},
+    {'v', 0x0076},
+    {'w', 0x0077},
+    {'x', 0x0078},
+    {'y', 0x0079},
+    {'z', 0x007a}
+};
+/**
+ * Size of `ALL_KEYSYMS_LOOKUP`.
+ */
+int ALL_KEYSYMS_LOOKUP_SIZE = (
+    sizeof(ALL_KEYSYMS_LOOKUP) / sizeof(*ALL_KEYSYMS_LOOKUP));
+
+
+// -- utilities
+
+/**
+ * Compute the smaller of two numbers.
+ */
+int min (int a, int b) {
+    return a < b ? a : b;
+}
+
+
+/**
+ * Compute the larger of two numbers.
+ */
+int max (int a, int b) {
+    return a < b ? b : a;
+}
+
+
+/**
+ * Determine whether a point is inside a rectangle.
+ */
+int rect_contains (xcb_rectangle_t* rect, int x, int y) {
+    return (x >= rect->x && x < rect->x + rect->width &&
+            y >= rect->y && y < rect->y + rect->height);
+}
+
+
+/**
+ * Get the time since choosing started, in seconds.
+ */
+double xcw_state_elapsed (xcw_state_t* state) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - state->started.tv_sec +
+            (now.tv_nsec - state->started.tv_nsec) / 1e9);
+}
+
+
+/**
+ * Describe a problem, unless one has already been described, since later
+ * problems are usually caused by the first.
+ *
+ * error: set to the allocated description, if NULL (left NULL if memory can't
+ *     be allocated)
+ * fmt, va_list: arguments as taken by `vprintf`
+ *
+ * returns: -1
+ */
+int xcw_verror (char** error, char* fmt, va_list args) {
+    if (*error != NULL) return -1;
+    va_list size_args;
+    va_copy(size_args, args);
+    int size = vsnprintf(NULL, 0, fmt, size_args);
+    va_end(size_args);
+    *error = malloc(size + 1);
+    if (*error != NULL) vsnprintf(*error, size + 1, fmt, args);
+    return -1;
+}
+
+
+/**
+ * See `xcw_verror`.
+ *
+ * fmt, ...: arguments as taken by `*printf`
+ */
+int xcw_error (char** error, char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    xcw_verror(error, fmt, args);
+    va_end(args);
+    return -1;
+}
+
+
+/**
+ * Stop choosing because something failed.  Functions that can fail return -1
+ * after calling this, or leave it to their callers to check `state->status`.
+ *
+ * fmt, ...: arguments as taken by `*printf`, describing the problem
+ *
+ * returns: -1
+ */
+int xcw_state_fail (xcw_state_t* state, char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    xcw_verror(&(state->error), fmt, args);
+    va_end(args);
+    state->status = XCW_ERROR;
+    return -1;
+}
+
+
+// -- xorg utilities
+
+/**
+ * Perform the check for a checked, reply-less xcb request, on `state->xcon`.
+ *
+ * cookie: corresponding to the request
+ * msg: describes the request in case of error
+ *
+ * returns: 0 on success, -1 if the request failed (see `xcw_state_fail`)
+ */
+int xorg_check_request (xcw_state_t* state,
+                        xcb_void_cookie_t cookie, char *msg) {
+    xcb_generic_error_t *error = xcb_request_check(state->xcon, cookie);
+    if (error == NULL) return 0;
+    xcw_state_fail(state, "%s (%d)", msg, error->error_code);
+    free(error);
+    return -1;
+}
+
+
+/**
+ * Move and resize a window.
+ *
+ * x, y: new absolute screen location
+ */
+void xorg_window_move_resize (xcb_connection_t* xcon, xcb_window_t window,
+                              int x, int y, int w, int h) {
+    int mask = (XCB_CONFIG_WINDOW_X | XCB_CONFIG_WINDOW_Y |
+                XCB_CONFIG_WINDOW_WIDTH | XCB_CONFIG_WINDOW_HEIGHT);
+    uint32_t values[] = { x, y, w, h };
+    xcb_configure_window(xcon, window, mask, values);
+}
+
+
+/**
+ * Render text centred on a window.
+ *
+ * win_rect: rectangle covering window with ID `win`
+ * gc: graphics context for rendering the text
+ * text: text to render (at most 255 characters)
+ * text_width: rendered width of `text`
+ * font_ascent, font_descent: vertical extents of the font used by `gc`
+ */
+void xorg_draw_text_centred (
+    xcb_connection_t* xcon, xcb_window_t win, xcb_rectangle_t* win_rect,
+    xcb_gcontext_t gc, char* text, int text_width,
+    int font_ascent, int font_descent
+) {
+    int x = (win_rect->width - text_width) / 2;
+    int y = (win_rect->height - font_ascent - font_descent) / 2;
+    int length = min(strlen(text), 255);
+    XCW_PROBE3(draw_text, win, length, text_width);
+    xcb_image_text_8(xcon, length, win, gc, x, y + font_ascent, text);
+}
+
+
+/**
+ * Ask the window manager to perform `input->action` on a window.  The requests
+ * are flushed, but not waited for.
+ *
+ * window: a client window
+ */
+void ewmh_window_act (xcw_state_t* state, xcb_window_t window) {
+    short action = state->input->action;
+    // pagers and tools like this one identify themselves as 'other' sources
+    xcb_ewmh_client_source_type_t source = XCB_EWMH_CLIENT_SOURCE_TYPE_OTHER;
+    if (action == ACTION_NONE) return;
+
+    // the window manager may ignore focus changes while the keyboard is grabbed
+    xcb_ungrab_keyboard(state->xcon, XCB_CURRENT_TIME);
+    if (action == ACTION_FOCUS) {
+        xcb_ewmh_request_change_active_window(
+            &(state->ewmh), 0, window, source, XCB_CURRENT_TIME, XCB_NONE);
+    } else if (action == ACTION_CLOSE) {
+        xcb_ewmh_request_close_window(
+            &(state->ewmh), 0, window, XCB_CURRENT_TIME, source);
+    } else if (action == ACTION_RAISE) {
+        xcb_ewmh_request_restack_window(
+            &(state->ewmh), 0, window, XCB_NONE, XCB_STACK_MODE_ABOVE);
+    } else if (action == ACTION_MINIMIZE) {
+        // EWMH defers to ICCCM for iconifying windows
+        uint32_t data[] = { XCB_ICCCM_WM_STATE_ICONIC };
+        xcb_ewmh_send_client_message(state->xcon, window, state->xroot,
+                                     state->wm_change_state, 1, data);
+    } else if (action == ACTION_DESKTOP) {
+        xcb_ewmh_request_change_wm_desktop(
+            &(state->ewmh), 0, window, state->input->action_desktop, source);
+    }
+    xcb_flush(state->xcon);
+}
+
+
+/**
+ * Close the render thread's connection kept in the options, which destroys the
+ * overlay windows in the pool.
+ */
+void xorg_render_disconnect (xcw_input_t* input) {
+    if (input->render_xcon == NULL) return;
+    xcb_disconnect(input->render_xcon);
+    free(input->overlay_pool.idle);
+    memset(&(input->overlay_pool), 0, sizeof(overlay_pool_t));
+    input->render_xcon = NULL;
+    input->render_xcon_for = NULL;
+}
+
+
+/**
+ * Determine whether two connections are to the same display, as far as their
+ * setup data shows.  This can't tell apart servers started the same way, but
+ * catches connecting to the wrong one in most cases.
+ */
+int xorg_same_display (xcb_connection_t* a, xcb_connection_t* b) {
+    const xcb_setup_t* sa = xcb_get_setup(a);
+    const xcb_setup_t* sb = xcb_get_setup(b);
+    if (sa->release_number != sb->release_number ||
+        sa->vendor_len != sb->vendor_len ||
+        memcmp(xcb_setup_vendor(sa), xcb_setup_vendor(sb),
+               sa->vendor_len) != 0 ||
+        sa->roots_len != sb->roots_len) {
+        return 0;
+    }
+    xcb_screen_iterator_t ia = xcb_setup_roots_iterator(sa);
+    xcb_screen_iterator_t ib = xcb_setup_roots_iterator(sb);
+    for (; ia.rem > 0; xcb_screen_next(&ia), xcb_screen_next(&ib)) {
+        if (ia.data->root != ib.data->root ||
+            ia.data->root_visual != ib.data->root_visual ||
+            ia.data->width_in_pixels != ib.data->width_in_pixels ||
+            ia.data->height_in_pixels != ib.data->height_in_pixels) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+
+/**
+ * Get the render thread's connection, opening it unless the last choice on the
+ * same connection left one, in which case its pool of overlay windows is
+ * reused too.  Events left over from the last choice are dropped.
+ *
+ * xcon: the connection passed to `xcw_choose_window`
+ *
+ * returns: the connection, which may have an error
+ */
+xcb_connection_t* xorg_render_connection (xcw_input_t* input,
+                                          xcb_connection_t* xcon) {
+    if (input->render_xcon != NULL &&
+        (input->render_xcon_for != xcon ||
+         xcb_connection_has_error(input->render_xcon))) {
+        xorg_render_disconnect(input);
+    }
+    if (input->render_xcon == NULL) {
+        input->render_xcon = xcb_connect(input->display, NULL);
+        input->render_xcon_for = xcon;
+    } else {
+        xcb_generic_event_t* event;
+        while ((event = xcb_poll_for_event(input->render_xcon))) free(event);
+    }
+    return input->render_xcon;
+}
+
+
+/**
+ * Send the requests for finding windows and drawing overlays, and open the
+ * render thread's connection while the server handles them.  Nothing is
+ * waited for; see `xcw_cookies_t`.
+ *
+ * returns: 0 on success, -1 on failure (see `xcw_state_fail`)
+ */
+int initialise_requests (xcw_state_t* state) {
+    xcb_connection_t* xcon = state->xcon;
+    xcw_input_t* input = state->input;
+    xcw_cookies_t* cookies = &(state->cookies);
+    // grab first, since it's the most likely to need retrying
+    if (!state->list) {
+        cookies->grab_keyboard = xcb_grab_keyboard(
+            xcon, 0, state->xroot, XCB_CURRENT_TIME,
+            XCB_GRAB_MODE_ASYNC, XCB_GRAB_MODE_ASYNC);
+    }
+    discovery_request_tree(&(state->discovery));
+    xcb_prefetch_extension_data(xcon, &xcb_randr_id);
+    if (state->list) {
+        xcb_flush(xcon);
+        return 0;
+    }
+    const xcb_setup_t* setup = xcb_get_setup(xcon);
+    cookies->keyboard_mapping = xcb_get_keyboard_mapping(
+        xcon, setup->min_keycode, setup->max_keycode - setup->min_keycode + 1);
+    state->overlay_font = xcb_generate_id(xcon);
+    cookies->open_font = xcb_open_font_checked(
+        xcon, state->overlay_font,
+        strlen(OVERLAY_FONT_NAME), OVERLAY_FONT_NAME);
+    cookies->query_font = xcb_query_font(xcon, state->overlay_font);
+    // the connection may be shared, so our event mask on the root window is
+    // added to, not replaced; see `initialise_root_events`
+    cookies->root_attributes = xcb_get_window_attributes(xcon, state->xroot);
+    cookies->query_pointer = xcb_query_pointer(xcon, state->xroot);
+    cookies->input_focus = xcb_get_input_focus(xcon);
+    xcb_flush(xcon);
+
+    state->render = calloc(1, sizeof(xcw_render_t));
+    xcw_render_t* render = state->render;
+    for (int i = 0; i < 2; i++) render->wake_fds[i] = -1;
+    for (int i = 0; i < 2; i++) render->stop_fds[i] = -1;
+    for (int i = 0; i < 2; i++) render->click_fds[i] = -1;
+    render->state.xcon = xorg_render_connection(input, xcon);
+    if (xcb_connection_has_error(render->state.xcon)) {
+        return xcw_state_fail(state, "connect");
+    }
+    if (!xorg_same_display(xcon, render->state.xcon)) {
+        return xcw_state_fail(
+            state, "connected to a different display from %s",
+            input->display == NULL ? "$DISPLAY" : input->display);
+    }
+    return 0;
+}
+
+
+/**
+ * Set up the program state for a connection to the X server, and send all
+ * requests that don't depend on any replies.  With coordination, only the
+ * instance selection is asked about, and `initialise_instance` sends the rest
+ * once we own it.  Nothing is waited for; see `xcw_cookies_t`.
+ *
+ * xcon: the connection to use
+ * input: options for choosing
+ * list: whether windows are only being listed
+ * state (output): pointer to program state, which should be freed with
+ *     `xcw_state_free` even on failure; `keycodes_ksl`, `overlay_font` metrics
+ *     and `wsetups` are not initialised
+ *
+ * returns: 0 on success, -1 on failure (see `xcw_state_fail`)
+ */
+int initialise_xorg (xcb_connection_t* xcon, xcw_input_t* input, int list,
+                     xcw_state_t** state) {
+    *state = calloc(1, sizeof(xcw_state_t));
+    (*state)->status = XCW_RUNNING;
+    (*state)->list = list;
+    clock_gettime(CLOCK_MONOTONIC, &((*state)->started));
+    (*state)->xcon = xcon;
+    (*state)->input = input;
+    (*state)->overlay_pool = &(input->overlay_pool);
+    if (xcb_connection_has_error(xcon)) {
+        return xcw_state_fail(*state, "connection");
+    }
+    if (input->ksl == NULL && !input->search) {
+        return xcw_state_fail(*state, "no characters to type were given");
+    }
+    (*state)->ksl = input->ksl == NULL ? ALL_KEYSYMS_LOOKUP : input->ksl;
+    (*state)->ksl_size = (
+        input->ksl == NULL ? ALL_KEYSYMS_LOOKUP_SIZE : input->ksl_size);
+
+    const xcb_setup_t* setup = xcb_get_setup(xcon);
+    xcb_screen_t* screen = xcb_setup_roots_iterator(setup).data;
+    if (screen == NULL) return xcw_state_fail(*state, "no screens");
+    xcb_window_t xroot = screen->root;
+    (*state)->xroot = xroot;
+    xcw_cookies_t* cookies = &((*state)->cookies);
+    x_backend_xcb(xcon, &((*state)->backend));
+    if (input->record_path != NULL) {
+        trace_recorder_t* recorder = malloc(sizeof(trace_recorder_t));
+        if (trace_recorder_open(input->record_path, &((*state)->backend),
+                                recorder) != 0) {
+            free(recorder);
+            return xcw_state_fail(*state, "can't record to %s: %s",
+                                  input->record_path, strerror(errno));
+        }
+        trace_recorder_backend(recorder, &((*state)->backend));
+        (*state)->recorder = recorder;
+    }
+    discovery_t* discovery = &((*state)->discovery);
+    discovery->backend = &((*state)->backend);
+    discovery->root = xroot;
+    discovery->max_windows = MAX_WINDOWS;
+    discovery->whitelist = input->whitelist;
+    discovery->whitelist_size = input->whitelist_size;
+    discovery->blacklist = input->blacklist;
+    discovery->blacklist_size = input->blacklist_size;
+    discovery->visible_only = input->visible_only;
+    discovery->filter = input->filter;
+
+    // atoms are kept for the next choice on the same connection
+    if (input->atoms_xcon != xcon) {
+        if (input->atoms_xcon != NULL) {
+            xcb_ewmh_connection_wipe(&(input->ewmh));
+            input->atoms_xcon = NULL;
+        }
+        input->wm_change_state = XCB_NONE;
+        for (int i = 0; i < INSTANCE_ATOMS_SIZE; i++) {
+            input->instance_atoms[i] = XCB_NONE;
+        }
+        cookies->wm_state = xcb_intern_atom(
+            xcon, 0, strlen(WM_STATE_NAME), WM_STATE_NAME);
+        cookies->ewmh = xcb_ewmh_init_atoms(xcon, &(input->ewmh));
+    }
+    if (!list && input->action == ACTION_MINIMIZE &&
+        input->wm_change_state == XCB_NONE) {
+        cookies->wm_change_state = xcb_intern_atom(
+            xcon, 0, strlen(WM_CHANGE_STATE_NAME), WM_CHANGE_STATE_NAME);
+    }
+    // with coordination, the windows aren't looked at until we know no other
+    // chooser is running; see `initialise_instance`
+    if (list || input->instance == INSTANCE_IGNORE) {
+        return initialise_requests(*state);
+    }
+    xcb_atom_t selection = input->instance_atoms[INSTANCE_ATOM_SELECTION];
+    if (selection == XCB_NONE) {
+        for (int i = 0; i < INSTANCE_ATOMS_SIZE; i++) {
+            cookies->instance_atoms[i] = xcb_intern_atom(
+                xcon, 0, strlen(INSTANCE_ATOM_NAMES[i]),
+                INSTANCE_ATOM_NAMES[i]);
+        }
+    } else {
+        cookies->instance_owner = xcb_get_selection_owner(xcon, selection);
+    }
+    xcb_flush(xcon);
+    return 0;
+}
+
+
+/**
+ * Wait for interned atoms requested by `initialise_xorg`, unless they were
+ * interned by an earlier choice.
+ *
+ * returns: 0 on success, -1 on failure (see `xcw_state_fail`)
+ */
+int initialise_atoms (xcw_state_t* state) {
+    xcw_input_t* input = state->input;
+    if (state->cookies.ewmh != NULL) {
+        int ewmh_status = xcb_ewmh_init_atoms_replies(
+            &(input->ewmh), state->cookies.ewmh, NULL);
+        state->cookies.ewmh = NULL;
+        xcb_intern_atom_reply_t* wsr = xcb_intern_atom_reply(
+            state->xcon, state->cookies.wm_state, NULL);
+        state->cookies.wm_state.sequence = 0;
+        // on failure, `xcb_ewmh_init_atoms_replies` frees the EWMH state
+        if (!ewmh_status) {
+            free(wsr);
+            return xcw_state_fail(state, "ewmh init");
+        } else if (wsr == NULL) {
+            xcb_ewmh_connection_wipe(&(input->ewmh));
+            return xcw_state_fail(state, "intern_atom WM_STATE");
+        }
+        input->wm_state = wsr->atom;
+        input->atoms_xcon = state->xcon;
+        free(wsr);
+    }
+    state->ewmh = input->ewmh;
+
+    xcb_ewmh_connection_t* ewmh = &(state->ewmh);
+    discovery_t* discovery = &(state->discovery);
+    discovery->wm_state = input->wm_state;
+    discovery->client_list = ewmh->_NET_CLIENT_LIST;
+    discovery->desktop = ewmh->_NET_WM_DESKTOP;
+    discovery->current_desktop = ewmh->_NET_CURRENT_DESKTOP;
+    discovery->state = ewmh->_NET_WM_STATE;
+    discovery->window_type = ewmh->_NET_WM_WINDOW_TYPE;
+    discovery->name = ewmh->_NET_WM_NAME;
+    discovery->utf8_string = ewmh->UTF8_STRING;
+    xcb_atom_t normal_types[] = {
+        ewmh->_NET_WM_WINDOW_TYPE_TOOLBAR, ewmh->_NET_WM_WINDOW_TYPE_MENU,
+        ewmh->_NET_WM_WINDOW_TYPE_UTILITY, ewmh->_NET_WM_WINDOW_TYPE_SPLASH,
+        ewmh->_NET_WM_WINDOW_TYPE_DIALOG, ewmh->_NET_WM_WINDOW_TYPE_NORMAL
+    };
+    discovery->normal_types_size = sizeof(normal_types) / sizeof(xcb_atom_t);
+    discovery->normal_types = calloc(discovery->normal_types_size,
+                                     sizeof(xcb_atom_t));
+    memcpy(discovery->normal_types, normal_types, sizeof(normal_types));
+
+    filter_t* filter = input->filter;
+    if (filter != NULL) {
+        xcb_atom_t* sa = filter->state_atoms;
+        sa[FILTER_STATE_HIDDEN] = ewmh->_NET_WM_STATE_HIDDEN;
+        sa[FILTER_STATE_SHADED] = ewmh->_NET_WM_STATE_SHADED;
+        sa[FILTER_STATE_SKIP_PAGER] = ewmh->_NET_WM_STATE_SKIP_PAGER;
+        sa[FILTER_STATE_SKIP_TASKBAR] = ewmh->_NET_WM_STATE_SKIP_TASKBAR;
+        sa[FILTER_STATE_STICKY] = ewmh->_NET_WM_STATE_STICKY;
+        sa[FILTER_STATE_FULLSCREEN] = ewmh->_NET_WM_STATE_FULLSCREEN;
+        sa[FILTER_STATE_ABOVE] = ewmh->_NET_WM_STATE_ABOVE;
+        sa[FILTER_STATE_BELOW] = ewmh->_NET_WM_STATE_BELOW;
+        sa[FILTER_STATE_MODAL] = ewmh->_NET_WM_STATE_MODAL;
+        sa[FILTER_STATE_DEMANDS_ATTENTION] = (
+            ewmh->_NET_WM_STATE_DEMANDS_ATTENTION);
+        xcb_atom_t* ta = filter->type_atoms;
+        ta[FILTER_TYPE_NORMAL] = ewmh->_NET_WM_WINDOW_TYPE_NORMAL;
+        ta[FILTER_TYPE_DIALOG] = ewmh->_NET_WM_WINDOW_TYPE_DIALOG;
+        ta[FILTER_TYPE_UTILITY] = ewmh->_NET_WM_WINDOW_TYPE_UTILITY;
+        ta[FILTER_TYPE_TOOLBAR] = ewmh->_NET_WM_WINDOW_TYPE_TOOLBAR;
+        ta[FILTER_TYPE_MENU] = ewmh->_NET_WM_WINDOW_TYPE_MENU;
+        ta[FILTER_TYPE_SPLASH] = ewmh->_NET_WM_WINDOW_TYPE_SPLASH;
+        ta[FILTER_TYPE_DOCK] = ewmh->_NET_WM_WINDOW_TYPE_DOCK;
+        ta[FILTER_TYPE_DESKTOP] = ewmh->_NET_WM_WINDOW_TYPE_DESKTOP;
+    }
+    if (state->recorder != NULL) {
+        char* characters = calloc(state->ksl_size + 1, sizeof(char));
+        for (int i = 0; i < state->ksl_size; i++) {
+            characters[i] = state->ksl[i].character;
+        }
+        trace_recorder_settings(state->recorder, discovery,
+                                input->filter_sources,
+                                input->filter_sources_size, characters);
+        free(characters);
+    }
+
+    if (state->cookies.wm_change_state.sequence != 0) {
+        xcb_intern_atom_reply_t* wcsr = xcb_intern_atom_reply(
+            state->xcon, state->cookies.wm_change_state, NULL);
+        state->cookies.wm_change_state.sequence = 0;
+        if (wcsr == NULL) {
+            return xcw_state_fail(state, "intern_atom WM_CHANGE_STATE");
+        }
+        input->wm_change_state = wcsr->atom;
+        free(wcsr);
+    }
+    state->wm_change_state = input->wm_change_state;
+    return 0;
+}
+
+
+/**
+ * Select substructure events on the root window, to follow top-level windows,
+ * keeping any events already selected on our connection.  This is done before
+ * any windows are looked at, so no changes are missed.
+ *
+ * returns: 0 on success, -1 on failure (see `xcw_state_fail`)
+ */
+int initialise_root_events (xcw_state_t* state) {
+    xcb_get_window_attributes_reply_t* gwar = xcb_get_window_attributes_reply(
+        state->xcon, state->cookies.root_attributes, NULL);
+    state->cookies.root_attributes.sequence = 0;
+    if (gwar == NULL) return xcw_state_fail(state, "get_window_attributes");
+    state->root_event_mask = gwar->your_event_mask;
+    free(gwar);
+
+    uint32_t root_mask[] = {
+        state->root_event_mask | XCB_EVENT_MASK_SUBSTRUCTURE_NOTIFY
+    };
+    xcb_change_window_attributes(state->xcon, state->xroot,
+                                 XCB_CW_EVENT_MASK, root_mask);
+    state->root_events_selected = 1;
+    return 0;
+}
+
+
+/**
+ * Wait for the font used to render text on overlay windows to be opened by
+ * `initialise_xorg`, and get its metrics so that text can be measured without
+ * asking the X server.
+ *
+ * returns: 0 on success, -1 on failure (see `xcw_state_fail`)
+ */
+int initialise_font (xcw_state_t* state) {
+    int open_status = xorg_check_request(state, state->cookies.open_font,
+                                         "open_font");
+    state->cookies.open_font.sequence = 0;
+    xcb_query_font_reply_t* qfr = xcb_query_font_reply(
+        state->xcon, state->cookies.query_font, NULL);
+    state->cookies.query_font.sequence = 0;
+    if (open_status != 0) {
+        state->overlay_font = XCB_NONE;
+        free(qfr);
+        return -1;
+    } else if (qfr == NULL) {
+        return xcw_state_fail(state, "query_font");
+    }
+    state->overlay_char_width = qfr->max_bounds.character_width;
+    state->overlay_font_ascent = qfr->font_ascent;
+    state->overlay_font_descent = qfr->font_descent;
+
+    // if there is no per-character information, every character has the
+    // maximum width
+    xcb_charinfo_t* char_infos = xcb_query_font_char_infos(qfr);
+    int char_infos_size = xcb_query_font_char_infos_length(qfr);
+    state->overlay_char_widths = calloc(256, sizeof(int));
+    for (int c = 0; c < 256; c++) {
+        int i = c - qfr->min_char_or_byte2;
+        state->overlay_char_widths[c] = (
+            char_infos_size == 0 ? qfr->max_bounds.character_width :
+            i >= 0 && i < char_infos_size ? char_infos[i].character_width :
+            0);
+    }
+    free(qfr);
+    return 0;
+}
+
+
+// -- input handling
+
+/**
+ * Find an item in a keysym lookup given its character.
+ *
+ * ksl: keysym lookup to search
+ * c: character to search for
+ *
+ * returns: found item, NULL if no matching items were found
+ */
+keysyms_lookup_t* keysyms_lookup_find_char (
+    keysyms_lookup_t* ksl, int ksl_size, char c
+) {
+    for (int i = 0; i < ksl_size; i++) {
+        if (ksl[i].character == c) {
+            return &(ksl[i]);
+        }
+    }
+    return NULL;
+}
+
+
+/**
+ * Find an item in a keysym lookup given its keysym.
+ *
+ * ksl: keysym lookup to search
+ * ksym: keysym to search for
+ *
+ * returns: index of the found item, -1 if no matching items were found
+ */
+int keysyms_lookup_find_keysym (
+    keysyms_lookup_t* ksl, int ksl_size, xcb_keysym_t ksym
+) {
+    for (int i = 0; i < ksl_size; i++) {
+        if (ksl[i].keysym == ksym) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+
+/**
+ * Build the table used to translate keycodes into characters, from the reply to
+ * the keyboard mapping request sent by `initialise_xorg`.  Only the first keysym
+ * for each keycode is used.
+ *
+ * returns: 0 on success, -1 on failure (see `xcw_state_fail`)
+ */
+int initialise_keycodes (xcw_state_t* state) {
+    xcb_get_keyboard_mapping_reply_t* gkmr = xcb_get_keyboard_mapping_reply(
+        state->xcon, state->cookies.keyboard_mapping, NULL);
+    state->cookies.keyboard_mapping.sequence = 0;
+    if (gkmr == NULL) return xcw_state_fail(state, "get_keyboard_mapping");
+    xcb_keysym_t* keysyms = xcb_get_keyboard_mapping_keysyms(gkmr);
+    int keysyms_size = xcb_get_keyboard_mapping_keysyms_length(gkmr);
+    int per_keycode = gkmr->keysyms_per_keycode;
+    int min_keycode = xcb_get_setup(state->xcon)->min_keycode;
+
+    state->keycodes_ksl = calloc(KEYCODES_SIZE, sizeof(int));
+    for (int k = 0; k < KEYCODES_SIZE; k++) {
+        int i = (k - min_keycode) * per_keycode;
+        if (k < min_keycode || per_keycode == 0 || i >= keysyms_size) {
+            state->keycodes_ksl[k] = -1;
+        } else if (keysyms[i] == BACKSPACE_KEYSYM) {
+            state->keycodes_ksl[k] = KEYCODES_KSL_BACKSPACE;
+        } else {
+            state->keycodes_ksl[k] = keysyms_lookup_find_keysym(
+                state->ksl, state->ksl_size, keysyms[i]);
+        }
+    }
+    free(gkmr);
+    return 0;
+}
+
+
+/**
+ * Acquire a Xorg keyboard grab on the root window, starting with the request
+ * sent by `initialise_xorg`.
+ *
+ * returns: 0 on success, -1 on failure (see `xcw_state_fail`)
+ */
+int initialise_input (xcw_state_t* state) {
+    // wait a little for other programs to release the keyboard
+    // since this program is likely to be launched from a hotkey daemon
+    struct timespec ts = { 0, 1000000 }; // 1ms
+    int status;
+    xcb_grab_keyboard_cookie_t gkc = state->cookies.grab_keyboard;
+    for (int s = 0; s < 1000; s++) { // up to 1s total
+        if (s > 0) {
+            gkc = xcb_grab_keyboard(
+                state->xcon, 0, state->xroot, XCB_CURRENT_TIME,
+                XCB_GRAB_MODE_ASYNC, XCB_GRAB_MODE_ASYNC);
+        }
+        xcb_grab_keyboard_reply_t* gkr;
+
+        gkr = xcb_grab_keyboard_reply(state->xcon, gkc, NULL);
+        state->cookies.grab_keyboard.sequence = 0;
+        if (gkr) {
+            status = gkr->status;
+            free(gkr);
+            if (status == XCB_GRAB_STATUS_ALREADY_GRABBED) {
+                nanosleep(&ts, NULL);
+                continue;
+            } else if (status == XCB_GRAB_STATUS_SUCCESS) {
+                break;
+            } else {
+                return xcw_state_fail(state, "grab_keyboard: %d", status);
+            }
+        } else {
+            return xcw_state_fail(state, "grab_keyboard");
+        }
+    }
+
+    if (status == XCB_GRAB_STATUS_ALREADY_GRABBED) {
+        return xcw_state_fail(state, "grab_keyboard: already grabbed");
+    }
+    return 0;
+}
+
+
+// -- overlay windows
+
+/**
+ * Get the slot an overlay window is looked for from first.
+ */
+int overlay_owners_home (overlay_owners_t* owners, xcb_window_t overlay) {
+    // window IDs are mostly sequential, which an odd multiplier spreads out
+    return (overlay * 2654435761u) & (owners->capacity - 1);
+}
+
+
+/**
+ * Find the slot for an overlay window, in a table with at least one empty
+ * slot.
+ *
+ * returns: the index of the overlay window's slot, or of the empty slot it
+ *     would go in
+ */
+int overlay_owners_find (overlay_owners_t* owners, xcb_window_t overlay) {
+    int i = overlay_owners_home(owners, overlay);
+    while (owners->slots[i].overlay != XCB_NONE &&
+           owners->slots[i].overlay != overlay) {
+        i = (i + 1) & (owners->capacity - 1);
+    }
+    return i;
+}
+
+
+/**
+ * Get the tracked window an overlay window covers.
+ *
+ * returns: the entry for `overlay`, with `overlay` XCB_NONE if it isn't in use
+ */
+overlay_owner_t overlay_owners_get (xcw_state_t* state, xcb_window_t overlay) {
+    overlay_owners_t* owners = &(state->overlay_owners);
+    if (owners->size == 0) {
+        overlay_owner_t none = { XCB_NONE, XCB_NONE, 0 };
+        return none;
+    }
+    return owners->slots[overlay_owners_find(owners, overlay)];
+}
+
+
+/**
+ * Record the tracked window an overlay window covers, replacing any recorded
+ * before.
+ *
+ * index: the position of `window` in `state->tracked`
+ */
+void overlay_owners_set (xcw_state_t* state, xcb_window_t overlay,
+                         xcb_window_t window, int index) {
+    overlay_owners_t* owners = &(state->overlay_owners);
+    if (2 * (owners->size + 1) > owners->capacity) {
+        overlay_owners_t old = *owners;
+        owners->capacity = max(16, 2 * old.capacity);
+        owners->slots = calloc(owners->capacity, sizeof(overlay_owner_t));
+        for (int i = 0; i < old.capacity; i++) {
+            if (old.slots[i].overlay == XCB_NONE) continue;
+            owners->slots[overlay_owners_find(owners, old.slots[i].overlay)] =
+                old.slots[i];
+        }
+        free(old.slots);
+    }
+    int i = overlay_owners_find(owners, overlay);
+    if (owners->slots[i].overlay == XCB_NONE) owners->size += 1;
+    overlay_owner_t owner = { overlay, window, index };
+    owners->slots[i] = owner;
+}
+
+
+/**
+ * Forget the tracked window an overlay window covers, if any.
+ */
+void overlay_owners_remove (xcw_state_t* state, xcb_window_t overlay) {
+    overlay_owners_t* owners = &(state->overlay_owners);
+    if (owners->size == 0) return;
+    int mask = owners->capacity - 1;
+    int i = overlay_owners_find(owners, overlay);
+    if (owners->slots[i].overlay == XCB_NONE) return;
+    owners->size -= 1;
+
+    // move later entries back into the gap, so that probing for them never
+    // stops early at an empty slot
+    for (int j = (i + 1) & mask; owners->slots[j].overlay != XCB_NONE;
+         j = (j + 1) & mask) {
+        int home = overlay_owners_home(owners, owners->slots[j].overlay);
+        // whether `home` is cyclically in (i, j], where the entry can stay
+        if (i <= j ? (i < home && home <= j) : (i < home || home <= j)) {
+            continue;
+        }
+        owners->slots[i] = owners->slots[j];
+        i = j;
+    }
+    owners->slots[i].overlay = XCB_NONE;
+    owners->slots[i].window = XCB_NONE;
+    owners->slots[i].index = 0;
+}
+
+/**
+ * Create unmapped overlay windows and add them to the pool.  The requests
+ * aren't checked; errors are reported by the render thread's event loop.
+ *
+ * n: number of windows to create
+ */
+void overlay_pool_grow (xcw_state_t* state, int n) {
+    overlay_pool_t* pool = state->overlay_pool;
+    if (pool->idle_size + n > pool->idle_capacity) {
+        pool->idle_capacity = pool->idle_size + n;
+        pool->idle = realloc(pool->idle,
+                             pool->idle_capacity * sizeof(pooled_overlay_t));
+    }
+
+    uint32_t mask = (XCB_CW_BACK_PIXEL | XCB_CW_OVERRIDE_REDIRECT |
+                     XCB_CW_SAVE_UNDER | XCB_CW_EVENT_MASK);
+    // overlay windows belong to this connection, so clicks arrive on it;
+    // they're ignored without `input->click`, since windows are kept for
+    // later choices
+    uint32_t values[] = {
+        BG_COLOUR, 1, 1, XCB_EVENT_MASK_EXPOSURE | XCB_EVENT_MASK_KEY_PRESS |
+        XCB_EVENT_MASK_BUTTON_PRESS
+    };
+    for (int i = 0; i < n; i++) {
+        xcb_window_t win = xcb_generate_id(state->xcon);
+        xcb_create_window(
+            state->xcon, XCB_COPY_FROM_PARENT, win, state->xroot, 0, 0, 1, 1,
+            0, XCB_WINDOW_CLASS_INPUT_OUTPUT, XCB_COPY_FROM_PARENT, mask,
+            values);
+        xcb_icccm_set_wm_class(
+            state->xcon, win, sizeof(OVERLAY_WINDOW_CLASS),
+            OVERLAY_WINDOW_CLASS);
+        pooled_overlay_t overlay = { win, XCB_NONE, XCB_NONE };
+        pool->idle[pool->idle_size] = overlay;
+        pool->idle_size += 1;
+    }
+    pool->created_size += n;
+}
+
+
+/**
+ * Make sure the pool has at least some number of unused overlay windows, so
+ * that they can be created together.
+ *
+ * n: number of windows needed
+ */
+void overlay_pool_reserve (xcw_state_t* state, int n) {
+    overlay_pool_t* pool = state->overlay_pool;
+    if (pool->idle_size < n) {
+        overlay_pool_grow(state, max(n - pool->idle_size, pool->created_size));
+    }
+}
+
+
+/**
+ * Take an overlay window from the pool, move it and map it.  The pool grows if
+ * it's empty.
+ *
+ * x, y: absolute screen location
+ * w, h: window size
+ * overlay (output): the overlay window, and its graphics contexts if it has
+ *     them
+ */
+void overlay_pool_take (xcw_state_t* state, int x, int y, int w, int h,
+                        pooled_overlay_t* overlay) {
+    overlay_pool_t* pool = state->overlay_pool;
+    if (pool->idle_size == 0) {
+        overlay_pool_grow(state, max(OVERLAY_POOL_MIN_GROWTH,
+                                     pool->created_size));
+    }
+    pool->idle_size -= 1;
+    *overlay = pool->idle[pool->idle_size];
+    xorg_window_move_resize(state->xcon, overlay->window, x, y, w, h);
+    xcb_map_window(state->xcon, overlay->window);
+}
+
+
+/**
+ * Unmap an overlay window and return it to the pool, or destroy it if the pool
+ * is full.
+ *
+ * overlay: the overlay window, and its graphics contexts (XCB_NONE if not
+ *     created)
+ */
+void overlay_pool_give (xcw_state_t* state, pooled_overlay_t overlay) {
+    overlay_pool_t* pool = state->overlay_pool;
+    if (pool->idle_size < pool->idle_max) {
+        xcb_unmap_window(state->xcon, overlay.window);
+        if (pool->idle_size == pool->idle_capacity) {
+            pool->idle_capacity = max(1, 2 * pool->idle_capacity);
+            pool->idle = realloc(
+                pool->idle, pool->idle_capacity * sizeof(pooled_overlay_t));
+        }
+        pool->idle[pool->idle_size] = overlay;
+        pool->idle_size += 1;
+    } else {
+        xcb_destroy_window(state->xcon, overlay.window);
+        if (overlay.font_gc != XCB_NONE) {
+            xcb_free_gc(state->xcon, overlay.font_gc);
+        }
+        if (overlay.bg_gc != XCB_NONE) xcb_free_gc(state->xcon, overlay.bg_gc);
+        pool->created_size -= 1;
+    }
+}
+
+
+/**
+ * Create a graphics context for drawing the background of an overlay window.
+ *
+ * win: the overlay window
+ *
+ * returns: the graphics context, or NULL on failure (see `xcw_state_fail`)
+ */
+xcb_gcontext_t* overlay_get_bg_gc (xcw_state_t* state, xcb_window_t win) {
+    xcb_gcontext_t* gc = malloc(sizeof(xcb_gcontext_t));
+    *gc = xcb_generate_id(state->xcon);
+    uint32_t mask = XCB_GC_FOREGROUND;
+    uint32_t value_list[] = { BG_COLOUR };
+    xcb_void_cookie_t cgc = (
+        xcb_create_gc_checked(state->xcon, *gc, win, mask, value_list));
+    if (xorg_check_request(state, cgc, "create_gc") != 0) {
+        free(gc);
+        return NULL;
+    }
+    return gc;
+}
+
+
+/**
+ * Create a graphics context for drawing the text of an overlay window.
+ *
+ * win: the overlay window
+ *
+ * returns: the graphics context, or NULL on failure (see `xcw_state_fail`)
+ */
+xcb_gcontext_t* overlay_get_font_gc (xcw_state_t* state, xcb_window_t win) {
+    xcb_gcontext_t* gc = malloc(sizeof(xcb_gcontext_t));
+    *gc = xcb_generate_id(state->xcon);
+    uint32_t mask = XCB_GC_FOREGROUND | XCB_GC_BACKGROUND | XCB_GC_FONT;
+    uint32_t value_list[] = { FG_COLOUR, BG_COLOUR, state->overlay_font };
+    xcb_void_cookie_t cgc = (
+        xcb_create_gc_checked(state->xcon, *gc, win, mask, value_list));
+    if (xorg_check_request(state, cgc, "create_gc") != 0) {
+        free(gc);
+        return NULL;
+    }
+    return gc;
+}
+
+
+/**
+ * Compute the rendered width of text in the overlay font.
+ */
+int overlay_text_width (xcw_state_t* state, char* text) {
+    int width = 0;
+    for (char* c = text; *c != '\0'; c++) {
+        width += state->overlay_char_widths[(unsigned char)*c];
+    }
+    return width;
+}
+
+
+/**
+ * Set the text on an overlay window, if it's different from the text already
+ * drawn.  `xcb_flush` should be called after calling this function.
+ *
+ * wsetup: containing the overlay window (if there is no overlay window, this
+ *     function does nothing)
+ * text: text to render (a suffix of `wsetup->label`)
+ */
+void overlay_set_text (xcw_state_t* state,
+                       window_setup_t* wsetup, char* text) {
+    if (wsetup->overlay_window == NULL) return;
+    // suffixes of the label are distinct pointers
+    if (wsetup->overlay_text == text) return;
+    xcb_window_t win = *(wsetup->overlay_window);
+
+    if (wsetup->overlay_bg_gc == NULL) {
+        wsetup->overlay_bg_gc = overlay_get_bg_gc(state, win);
+    }
+    if (wsetup->overlay_font_gc == NULL) {
+        wsetup->overlay_font_gc = overlay_get_font_gc(state, win);
+    }
+    if (wsetup->overlay_bg_gc == NULL || wsetup->overlay_font_gc == NULL) {
+        return;
+    }
+
+    xcb_poly_fill_rectangle(state->xcon, win, *(wsetup->overlay_bg_gc), 1,
+                            wsetup->overlay_rect);
+    xorg_draw_text_centred(state->xcon, win, wsetup->overlay_rect,
+                           *(wsetup->overlay_font_gc), text,
+                           overlay_text_width(state, text),
+                           state->overlay_font_ascent,
+                           state->overlay_font_descent);
+    wsetup->overlay_text = text;
+}
+
+
+/**
+ * See `overlays_set_text`.  `xcb_flush` should be called after calling this
+ * function.
+ *
+ * wsetups: array of setup structures containing overlay windows to render text
+ *     on (recursively)
+ */
+void _overlays_set_text (xcw_state_t* state, window_setup_t* wsetups,
+                         int wsetups_size) {
+    for (int i = 0; i < wsetups_size; i++) {
+        window_setup_t* wsetup = &(wsetups[i]);
+        if (wsetup->children != NULL) {
+            _overlays_set_text(state, wsetup->children, wsetup->children_size);
+        } else if (wsetup->window != NULL) {
+            // the typed characters are no longer shown
+            overlay_set_text(state, wsetup, wsetup->label + state->depth);
+        }
+    }
+}
+
+
+/**
+ * Update text on all overlay windows which need it.
+ */
+void overlays_set_text (xcw_state_t* state) {
+    _overlays_set_text(state, state->wsetups, state->wsetups_size);
+    xcb_flush(state->xcon);
+}
+
+
+/**
+ * See `overlays_invalidate`.
+ *
+ * returns: whether the overlay window was found
+ */
+int _overlays_invalidate (window_setup_t* wsetups, int wsetups_size,
+                          xcb_window_t win) {
+    for (int i = 0; i < wsetups_size; i++) {
+        window_setup_t* wsetup = &(wsetups[i]);
+        if (wsetup->children != NULL) {
+            if (_overlays_invalidate(wsetup->children, wsetup->children_size,
+                                     win)) {
+                return 1;
+            }
+        } else if (wsetup->overlay_window != NULL &&
+                   *(wsetup->overlay_window) == win) {
+            wsetup->overlay_text = NULL;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+
+/**
+ * Mark an overlay window as needing to be redrawn by `overlays_set_text`.
+ *
+ * win: the overlay window
+ */
+void overlays_invalidate (xcw_state_t* state, xcb_window_t win) {
+    _overlays_invalidate(state->wsetups, state->wsetups_size, win);
+}
+
+
+// -- wsetup utilities
+
+
+/**
+ * Create a bottom-level `wsetup_t`.  The overlay window is not created; see
+ * `wsetup_create_overlay`.
+ *
+ * window: the window to track
+ * label: full window label (not copied)
+ * character: bottom-level character in the window label
+ */
+window_setup_t initialise_window_setup (xcb_window_t window, char* label,
+                                        char character) {
+    XCW_PROBE2(window_setup, window, character);
+    xcb_window_t* window_p = malloc(sizeof(xcb_window_t));
+    *window_p = window;
+
+    window_setup_t wsetup = {
+        NULL, NULL, NULL, NULL, NULL, 0, window_p, label, character, NULL, 0
+    };
+    return wsetup;
+}
+
+
+/**
+ * Create the overlay window for a bottom-level `wsetup_t`.
+ *
+ * rect: absolute screen area to cover
+ * index: the position of the window in `state->tracked`
+ */
+void wsetup_create_overlay (xcw_state_t* state, window_setup_t* wsetup,
+                            xcb_rectangle_t* rect, int index) {
+    xcb_rectangle_t overlay_rect = { 0, 0, rect->width, rect->height };
+    wsetup->overlay_rect = malloc(sizeof(xcb_rectangle_t));
+    *(wsetup->overlay_rect) = overlay_rect;
+
+    pooled_overlay_t overlay;
+    overlay_pool_take(state, rect->x, rect->y, rect->width, rect->height,
+                      &overlay);
+    wsetup->overlay_window = malloc(sizeof(xcb_window_t));
+    *(wsetup->overlay_window) = overlay.window;
+    overlay_owners_set(state, overlay.window, *(wsetup->window), index);
+    if (overlay.font_gc != XCB_NONE) {
+        wsetup->overlay_font_gc = malloc(sizeof(xcb_gcontext_t));
+        *(wsetup->overlay_font_gc) = overlay.font_gc;
+    }
+    if (overlay.bg_gc != XCB_NONE) {
+        wsetup->overlay_bg_gc = malloc(sizeof(xcb_gcontext_t));
+        *(wsetup->overlay_bg_gc) = overlay.bg_gc;
+    }
+    // the render thread starts at generation 1
+    wsetup->overlay_shown = 1;
+}
+
+
+/**
+ * See `initialise_window_tracking`.
+ *
+ * plan: labels for `windows`
+ * labels: labels for `windows` as strings
+ * start, end: range in `plan->order` of windows whose labels share a prefix
+ * depth: length of the shared prefix
+ */
+void _initialise_window_tracking (xcw_state_t* state, label_plan_t* plan,
+                                  xcb_window_t* windows, char** labels,
+                                  int start, int end, int depth,
+                                  window_setup_t** wsetups, int* wsetups_size) {
+    // labels are sorted, so the last has the highest key; remembered labels
+    // may skip keys, which leaves empty slots
+    int n = label_plan_label(plan, plan->order[end - 1])[depth] + 1;
+    *wsetups = calloc(n, sizeof(window_setup_t));
+    *wsetups_size = n;
+    int group_start = start;
+
+    while (group_start < end) {
+        int key = label_plan_label(plan, plan->order[group_start])[depth];
+        int group_end = group_start;
+        while (group_end < end && label_plan_label(
+            plan, plan->order[group_end]
+        )[depth] == key) {
+            group_end += 1;
+        }
+        int window = plan->order[group_start];
+        // keys are indices into `ksl`
+        char character = state->ksl[key].character;
+
+        if (group_end - group_start == 1 &&
+            plan->lengths[window] == depth + 1) {
+            (*wsetups)[key] = initialise_window_setup(
+                windows[window], labels[window], character);
+        } else {
+            window_setup_t* children = NULL;
+            int children_size;
+            _initialise_window_tracking(state, plan, windows, labels,
+                                        group_start, group_end, depth + 1,
+                                        &children, &children_size);
+            window_setup_t wsetup = {
+                NULL, NULL, NULL, NULL, NULL, 0, NULL, NULL, character,
+                children, children_size
+            };
+            (*wsetups)[key] = wsetup;
+        }
+
+        group_start = group_end;
+    }
+}
+
+
+/**
+ * Assign windows the labels remembered for them, or the labels of windows of
+ * the same application that have gone, and remember the result.
+ *
+ * names: names of `windows`, as returned by `discovery_find_windows`
+ * save: whether to remember the result
+ * plan (output): as for `label_store_assign`
+ *
+ * returns: 0 on success, -1 on failure (see `xcw_state_fail`)
+ */
+int window_tracking_remembered_labels (xcw_state_t* state,
+                                       xcb_window_t* windows, char** names,
+                                       int windows_size, int save,
+                                       label_plan_t* plan) {
+    uint32_t* classes = calloc(windows_size, sizeof(uint32_t));
+    char* alphabet = calloc(state->ksl_size, sizeof(char));
+    for (int i = 0; i < windows_size; i++) {
+        // WM_CLASS follows the title, as instance and class
+        char* instance = names[i] + strlen(names[i]) + 1;
+        char* class = instance + strlen(instance) + 1;
+        classes[i] = label_store_hash(instance,
+                                      (class + strlen(class)) - instance);
+    }
+    for (int i = 0; i < state->ksl_size; i++) {
+        alphabet[i] = state->ksl[i].character;
+    }
+    int status = label_store_assign(state->input->label_store,
+                                    windows, classes, windows_size,
+                                    alphabet, state->ksl_size, save, plan);
+    free(alphabet);
+    free(classes);
+    if (status != 0) return xcw_state_fail(state, "label_store_assign");
+    return 0;
+}
+
+
+/**
+ * Reorder an array in place.
+ *
+ * items: `size` items of `item_size` bytes
+ * order: for each new position, the index in `items` of the item to put there
+ */
+void reorder_items (void* items, size_t item_size, int* order, int size) {
+    unsigned char* copy = malloc(size * item_size);
+    memcpy(copy, items, size * item_size);
+    for (int i = 0; i < size; i++) {
+        memcpy((unsigned char*)items + i * item_size,
+               copy + order[i] * item_size, item_size);
+    }
+    free(copy);
+}
+
+
+/**
+ * Construct data for tracked windows in a nested structure matching the
+ * characters that need to be typed to choose them.  Labels are assigned in
+ * window order, or remembered with stable labels.  Overlay windows are not
+ * created; see `initialise_overlays`.
+ *
+ * state: the result is stored in here; unchanged on failure
+ * windows: tracked windows
+ * names: names of `windows` with stable labels, or NULL
+ * save: with stable labels, whether to remember the result
+ * order (output): with stable labels, indices in `windows` in label order,
+ *     which should be freed and used to reorder anything in window order with
+ *     `reorder_items`; otherwise, set to NULL, since labels are in window order
+ *
+ * returns: 0 on success, -1 on failure (see `xcw_state_fail`)
+ */
+int initialise_window_tracking (xcw_state_t* state,
+                                xcb_window_t* windows, char** names,
+                                int windows_size, int save, int** order) {
+    *order = NULL;
+    if (windows_size == 0) {
+        if (save && state->recorder != NULL) {
+            trace_recorder_labels(state->recorder, windows, NULL, 0);
+        }
+        state->wsetups = state->wsetups_root = NULL;
+        state->wsetups_size = state->wsetups_root_size = 0;
+        state->labels = NULL;
+        return 0;
+    }
+
+    label_plan_t plan;
+    if (state->input->label_store != NULL && names != NULL) {
+        if (window_tracking_remembered_labels(state, windows, names,
+                                              windows_size, save,
+                                              &plan) != 0) {
+            return -1;
+        }
+        *order = malloc(windows_size * sizeof(int));
+        memcpy(*order, plan.order, windows_size * sizeof(int));
+    } else if (label_plan_create(windows_size, state->ksl_size, NULL,
+                                 &plan) != 0) {
+        return xcw_state_fail(state, "label_plan_create");
+    }
+
+    // build every label string once, so rendering needs no allocation
+    int labels_size = 0;
+    for (int i = 0; i < windows_size; i++) labels_size += plan.lengths[i] + 1;
+    state->labels = calloc(labels_size, sizeof(char));
+    char** labels = calloc(windows_size, sizeof(char*));
+    char* label = state->labels;
+    for (int i = 0; i < windows_size; i++) {
+        labels[i] = label;
+        unsigned char* keys = label_plan_label(&plan, i);
+        for (int d = 0; d < plan.lengths[i]; d++) {
+            label[d] = state->ksl[keys[d]].character;
+        }
+        label += plan.lengths[i] + 1;
+    }
+
+    _initialise_window_tracking(state, &plan, windows, labels,
+                                0, windows_size, 0,
+                                &(state->wsetups), &(state->wsetups_size));
+    state->wsetups_root = state->wsetups;
+    state->wsetups_root_size = state->wsetups_size;
+    // relabelling isn't recorded, since it depends on events
+    if (save && state->recorder != NULL) {
+        trace_recorder_labels(state->recorder, windows, labels, windows_size);
+    }
+    free(labels);
+    label_plan_free(&plan);
+    return 0;
+}
+
+
+/**
+ * See `wsetups_get_leaves`.
+ *
+ * depth: current depth in the structure, starting at 0
+ * leaves: array to add to
+ * leaves_size: size of `leaves`, updated as items are added
+ * label_sizes: array to add to in parallel with `leaves`, or NULL
+ */
+void _wsetups_get_leaves (window_setup_t* wsetups, int wsetups_size, int depth,
+                          window_setup_t** leaves, int* leaves_size,
+                          int* label_sizes) {
+    for (int i = 0; i < wsetups_size; i++) {
+        window_setup_t* wsetup = &(wsetups[i]);
+        if (wsetup->children != NULL) {
+            _wsetups_get_leaves(wsetup->children, wsetup->children_size,
+                                depth + 1, leaves, leaves_size, label_sizes);
+        } else if (wsetup->window != NULL) {
+            leaves[*leaves_size] = wsetup;
+            if (label_sizes != NULL) label_sizes[*leaves_size] = depth + 1;
+            *leaves_size += 1;
+        }
+    }
+}
+
+
+/**
+ * Get the bottom-level setup structures, in label order.
+ *
+ * windows_size: number of tracked windows in `wsetups`
+ * leaves (output): array of pointers into `wsetups`, of size `windows_size`
+ * label_sizes (output): lengths of the labels of `leaves`; not set if NULL
+ */
+void wsetups_get_leaves (window_setup_t* wsetups, int wsetups_size,
+                         int windows_size, window_setup_t*** leaves,
+                         int** label_sizes) {
+    int leaves_size = 0;
+    *leaves = calloc(windows_size, sizeof(window_setup_t*));
+    int* sizes = NULL;
+    if (label_sizes != NULL) {
+        sizes = *label_sizes = calloc(windows_size, sizeof(int));
+    }
+    _wsetups_get_leaves(wsetups, wsetups_size, 0, *leaves, &leaves_size, sizes);
+}
+
+
+/**
+ * Count the bottom-level setup structures.
+ */
+int wsetups_count_leaves (window_setup_t* wsetups, int wsetups_size) {
+    int count = 0;
+    for (int i = 0; i < wsetups_size; i++) {
+        if (wsetups[i].children != NULL) {
+            count += wsetups_count_leaves(wsetups[i].children,
+                                          wsetups[i].children_size);
+        } else if (wsetups[i].window != NULL) {
+            count += 1;
+        }
+    }
+    return count;
+}
+
+
+/**
+ * Find the bottom-level setup structure for a tracked window.
+ *
+ * returns: the setup structure, or NULL if not found
+ */
+window_setup_t* wsetups_find_window (window_setup_t* wsetups, int wsetups_size,
+                                     xcb_window_t window) {
+    for (int i = 0; i < wsetups_size; i++) {
+        window_setup_t* wsetup = &(wsetups[i]);
+        if (wsetup->children != NULL) {
+            window_setup_t* found = wsetups_find_window(
+                wsetup->children, wsetup->children_size, window);
+            if (found != NULL) return found;
+        } else if (wsetup->window != NULL && *(wsetup->window) == window) {
+            return wsetup;
+        }
+    }
+    return NULL;
+}
+
+
+/**
+ * Get the area an overlay window covers when only showing a label.
+ *
+ * rect: absolute area covered by the tracked window
+ * label_size: number of characters in the label
+ */
+xcb_rectangle_t overlay_label_rect (xcw_state_t* state, xcb_rectangle_t* rect,
+                                    int label_size) {
+    int w = min(state->overlay_char_width * label_size + 2 * LABEL_BOX_PADDING,
+                rect->width);
+    int h = min(state->overlay_font_ascent + state->overlay_font_descent +
+                2 * LABEL_BOX_PADDING,
+                rect->height);
+    // ANCHOR_* values are 0, 1 or 2 halves of the remaining space
+    xcb_rectangle_t label_rect = {
+        rect->x + (rect->width - w) * state->input->anchor->x / 2,
+        rect->y + (rect->height - h) * state->input->anchor->y / 2,
+        w, h
+    };
+    return label_rect;
+}
+
+
+/**
+ * Get the area an overlay window covers, according to `input->overlay_size`.
+ *
+ * rect: absolute area covered by the tracked window
+ * label_size: number of characters in the label
+ */
+xcb_rectangle_t overlay_area (xcw_state_t* state, xcb_rectangle_t* rect,
+                              int label_size) {
+    if (state->input->overlay_size == OVERLAY_SIZE_LABEL) {
+        return overlay_label_rect(state, rect, label_size);
+    } else {
+        return *rect;
+    }
+}
+
+
+/**
+ * Compare window paint priorities, for use with `qsort`.
+ */
+int compare_paints (const void* a, const void* b) {
+    const window_paint_t* pa = a;
+    const window_paint_t* pb = b;
+    if (pa->away != pb->away) return pa->away - pb->away;
+    if (pa->distance != pb->distance) {
+        return pa->distance < pb->distance ? -1 : 1;
+    }
+    return pa->index - pb->index;
+}
+
+
+/**
+ * Decide the order to draw overlay windows in, so that the labels most likely
+ * to be typed appear first: those on the monitor under the pointer, then the
+ * focused window and its neighbours, then the rest by distance from it.  Uses
+ * the replies to the `query_pointer` and `input_focus` requests.
+ *
+ * windows, tops, rects: tracked windows, as passed to `initialise_tracking`
+ * order (output): indices in `windows` in the order to draw them; has size
+ *     `windows_size`
+ */
+void initialise_paint_order (xcw_state_t* state, xcb_window_t* windows,
+                             xcb_window_t* tops, xcb_rectangle_t* rects,
+                             int windows_size, int* order) {
+    xcb_query_pointer_reply_t* qpr = xcb_query_pointer_reply(
+        state->xcon, state->cookies.query_pointer, NULL);
+    state->cookies.query_pointer.sequence = 0;
+    xcb_get_input_focus_reply_t* gifr = xcb_get_input_focus_reply(
+        state->xcon, state->cookies.input_focus, NULL);
+    state->cookies.input_focus.sequence = 0;
+
+    xcb_rectangle_t* monitor = NULL;
+    int focus_x = 0, focus_y = 0;
+    int focus_known = 0;
+    if (qpr != NULL && qpr->same_screen) {
+        for (int i = 0; i < state->monitors_size; i++) {
+            if (rect_contains(&(state->monitors[i]),
+                              qpr->root_x, qpr->root_y)) {
+                monitor = &(state->monitors[i]);
+            }
+        }
+        focus_x = qpr->root_x;
+        focus_y = qpr->root_y;
+        focus_known = 1;
+    }
+    // focus may be on the client window or its frame
+    for (int i = 0; gifr != NULL && i < windows_size; i++) {
+        if (windows[i] == gifr->focus || tops[i] == gifr->focus) {
+            focus_x = rects[i].x + rects[i].width / 2;
+            focus_y = rects[i].y + rects[i].height / 2;
+            focus_known = 1;
+            break;
+        }
+    }
+    free(qpr);
+    free(gifr);
+
+    window_paint_t* paints = calloc(windows_size, sizeof(window_paint_t));
+    for (int i = 0; i < windows_size; i++) {
+        long long dx = rects[i].x + rects[i].width / 2 - focus_x;
+        long long dy = rects[i].y + rects[i].height / 2 - focus_y;
+        window_paint_t paint = {
+            i,
+            monitor != NULL && !rect_contains(
+                monitor, rects[i].x + rects[i].width / 2,
+                rects[i].y + rects[i].height / 2),
+            focus_known ? dx * dx + dy * dy : 0
+        };
+        paints[i] = paint;
+    }
+    qsort(paints, windows_size, sizeof(window_paint_t), compare_paints);
+    for (int i = 0; i < windows_size; i++) order[i] = paints[i].index;
+    free(paints);
+}
+
+
+/**
+ * Report the time taken to draw some overlay windows to `input->paint_handler`
+ * once the X server has handled the requests drawing them.
+ *
+ * cookie: a request sent after the requests drawing the windows
+ * wait: whether to wait for the reply; otherwise, nothing is reported if it
+ *     hasn't arrived yet
+ * drawn, total: as passed to `input->paint_handler`
+ *
+ * returns: whether the time was reported (or can't be)
+ */
+int overlays_report_paint (xcw_state_t* state,
+                           xcb_get_input_focus_cookie_t cookie, int wait,
+                           int drawn, int total) {
+    void* reply = NULL;
+    xcb_generic_error_t* error = NULL;
+    if (wait) {
+        reply = xcb_get_input_focus_reply(state->xcon, cookie, &error);
+    } else if (!xcb_poll_for_reply(state->xcon, cookie.sequence,
+                                   &reply, &error)) {
+        return 0;
+    }
+    if (reply != NULL) {
+        xcw_input_t* input = state->input;
+        input->paint_handler(drawn, total, xcw_state_elapsed(state),
+                             input->paint_handler_data);
+    }
+    free(reply);
+    free(error);
+    return 1;
+}
+
+
+/**
+ * Create overlay windows for all tracked windows and draw their labels, a
+ * chunk of OVERLAY_CHUNK_SIZE at a time with a flush after each, so that the
+ * first labels appear within a round trip or two however many windows there
+ * are.  With `input->paint_handler`, the times taken to draw the first chunk
+ * and all of them are reported.
+ *
+ * rects: areas to cover for the tracked windows, in label order
+ * rects_size: number of tracked windows
+ * order: indices in `rects` in the order to draw them (see
+ *     `initialise_paint_order`)
+ */
+void initialise_overlays (xcw_state_t* state, xcb_rectangle_t* rects,
+                          int rects_size, int* order) {
+    overlay_pool_t* pool = state->overlay_pool;
+    window_setup_t** leaves;
+    // `rects` are in label order, like leaves
+    wsetups_get_leaves(state->wsetups, state->wsetups_size, rects_size,
+                       &leaves, NULL);
+    int timed = state->input->paint_handler != NULL;
+    int first_size = min(OVERLAY_CHUNK_SIZE, rects_size);
+    xcb_get_input_focus_cookie_t first_drawn = { 0 };
+
+    for (int start = 0; start < rects_size; start += OVERLAY_CHUNK_SIZE) {
+        int end = min(start + OVERLAY_CHUNK_SIZE, rects_size);
+        // only create what this chunk needs, so the first isn't held up
+        if (pool->idle_size < end - start) {
+            overlay_pool_grow(state, end - start - pool->idle_size);
+        }
+        for (int i = start; i < end; i++) {
+            window_setup_t* leaf = leaves[order[i]];
+            // with --search, labels are titles, not paths in the structure
+            xcb_rectangle_t rect = overlay_area(state, &(rects[order[i]]),
+                                                strlen(leaf->label));
+            wsetup_create_overlay(state, leaf, &rect, order[i]);
+            // drawn straight away; the Expose event would take a round trip
+            overlay_set_text(state, leaf, leaf->label);
+        }
+        if (timed && start == 0 && end < rects_size) {
+            first_drawn = xcb_get_input_focus(state->xcon);
+        }
+        xcb_flush(state->xcon);
+        if (first_drawn.sequence != 0 && overlays_report_paint(
+            state, first_drawn, 0, first_size, rects_size
+        )) {
+            first_drawn.sequence = 0;
+        }
+    }
+
+    if (timed && rects_size > 0) {
+        if (first_drawn.sequence != 0) {
+            overlays_report_paint(state, first_drawn, 1, first_size,
+                                  rects_size);
+        }
+        overlays_report_paint(state, xcb_get_input_focus(state->xcon), 1,
+                              rects_size, rects_size);
+    }
+    free(leaves);
+}
+
+
+/**
+ * See `wsetups_list`.
+ *
+ * rects: remaining areas of tracked windows, in label order; updated to point
+ *     past the windows listed
+ * windows: remaining items to fill in; updated to point past the windows
+ *     listed
+ */
+void _wsetups_list (window_setup_t* wsetups, int wsetups_size,
+                    xcb_rectangle_t** rects, xcw_listed_window_t** windows) {
+    for (int i = 0; i < wsetups_size; i++) {
+        window_setup_t* wsetup = &(wsetups[i]);
+        if (wsetup->children != NULL) {
+            _wsetups_list(wsetup->children, wsetup->children_size, rects,
+                          windows);
+        } else if (wsetup->window != NULL) {
+            xcw_listed_window_t listed = {
+                *(wsetup->window), strdup(wsetup->label), **rects
+            };
+            **windows = listed;
+            *rects += 1;
+            *windows += 1;
+        }
+    }
+}
+
+
+/**
+ * Get every tracked window with its label and geometry.
+ *
+ * rects: areas of the tracked windows, in label order
+ * windows (output): the tracked windows, in label order; has room for every
+ *     tracked window
+ */
+void wsetups_list (xcw_state_t* state, xcb_rectangle_t* rects,
+                   xcw_listed_window_t* windows) {
+    // `rects` are in label order
+    _wsetups_list(state->wsetups, state->wsetups_size, &rects, &windows);
+}
+
+
+/**
+ * See `wsetup_debug_print`.
+ *
+ * depth: current depth in the structure, starting at 0, used for indentation
+ */
+void _wsetup_debug_print (window_setup_t* wsetup, int depth) {
+    printf("[wsetup] ");
+    for (int i = 0; i < depth; i++) printf("  ");
+    printf("%c", wsetup->character);
+    if (wsetup->window == NULL) printf("\n");
+    else printf(" %x\n", *(wsetup->window));
+
+    if (wsetup->children != NULL) {
+        for (int i = 0; i < wsetup->children_size; i++) {
+            _wsetup_debug_print(&(wsetup->children[i]), depth + 1);
+        }
+    }
+}
+
+
+/**
+ * Print a setup structure to stdout.
+ */
+void wsetup_debug_print (window_setup_t* wsetup) {
+    _wsetup_debug_print(wsetup, 0);
+}
+
+
+/**
+ * Return all overlay windows in a setup structure to the pool and free the
+ * structure's used memory.  `xcb_flush` should be called after calling this
+ * function.
+ */
+void wsetup_free (xcw_state_t* state, window_setup_t* wsetup) {
+    free(wsetup->window);
+    if (wsetup->overlay_window != NULL) {
+        pooled_overlay_t overlay = {
+            *(wsetup->overlay_window),
+            wsetup->overlay_font_gc == NULL ? XCB_NONE :
+                                              *(wsetup->overlay_font_gc),
+            wsetup->overlay_bg_gc == NULL ? XCB_NONE : *(wsetup->overlay_bg_gc)
+        };
+        overlay_owners_remove(state, overlay.window);
+        overlay_pool_give(state, overlay);
+        free(wsetup->overlay_window);
+        free(wsetup->overlay_rect);
+        free(wsetup->overlay_font_gc);
+        free(wsetup->overlay_bg_gc);
+    }
+
+    if (wsetup->children != NULL) {
+        for (int i = 0; i < wsetup->children_size; i++) {
+            window_setup_t* child = &(wsetup->children[i]);
+            wsetup_free(state, child);
+        }
+        free(wsetup->children);
+    }
+}
+
+
+
+// -- threads
+
+/**
+ * Wake the render thread after handing something over to it.  Called by the
+ * input thread.
+ */
+void render_wake (xcw_state_t* state) {
+    char c = 0;
+    // the pipe only fills up if the render thread already has work to do
+    if (write(state->render->wake_fds[1], &c, 1) < 0 && errno != EAGAIN) {
+        xcw_state_fail(state, "write: %s", strerror(errno));
+    }
+}
+
+
+/**
+ * Hand a setup structure replaced by relabelling to the render thread to be
+ * freed.  Called by the input thread, after publishing a level of the new
+ * structure.
+ *
+ * wsetups, labels: as in `xcw_garbage_t`
+ */
+void render_discard (xcw_state_t* state, window_setup_t* wsetups,
+                     int wsetups_size, char* labels) {
+    xcw_render_t* render = state->render;
+    xcw_garbage_t* garbage = malloc(sizeof(xcw_garbage_t));
+    garbage->wsetups = wsetups;
+    garbage->wsetups_size = wsetups_size;
+    garbage->labels = labels;
+    garbage->next = atomic_load(&(render->garbage));
+    while (!atomic_compare_exchange_weak(&(render->garbage), &(garbage->next),
+                                         garbage));
+    render_wake(state);
+}
+
+
+/**
+ * Hand a level made by searching to the render thread to be freed, once it's
+ * no longer shown.  Called by the input thread, after publishing the level
+ * replacing it.
+ *
+ * wsetups: the level's array of setup structures; the structures they point to
+ *     are not freed
+ */
+void render_discard_level (xcw_state_t* state, window_setup_t* wsetups) {
+    // with no items, nothing in the array is freed or has overlays to move
+    render_discard(state, wsetups, 0, NULL);
+}
+
+
+/**
+ * Hand the current level of the setup structure to the render thread.  Called
+ * by the input thread.  If the render thread hasn't taken the previous level,
+ * it is replaced, since only the latest one needs drawing.  Levels undone by
+ * searching are discarded afterwards, since they've now been replaced.
+ */
+void render_publish_level (xcw_state_t* state) {
+    xcw_level_t* level = malloc(sizeof(xcw_level_t));
+    level->wsetups = state->wsetups;
+    level->wsetups_size = state->wsetups_size;
+    level->depth = state->depth;
+    level->wsetups_root = state->wsetups_root;
+    level->wsetups_root_size = state->wsetups_root_size;
+    xcw_level_t* old_level = atomic_exchange(&(state->render->level), level);
+    free(old_level);
+    render_wake(state);
+    state->level_changed = 0;
+
+    xcw_search_t* search = &(state->search);
+    for (int i = 0; i < search->retired_size; i++) {
+        render_discard_level(state, search->retired[i]);
+    }
+    search->retired_size = 0;
+}
+
+
+/**
+ * Publish the current level if typing has changed it.  Called by the input
+ * thread once it has handled every event it has received, so that when keys
+ * are typed faster than they're handled, the render thread only draws the
+ * level they lead to, and isn't woken for levels already passed.
+ */
+void render_publish_typing (xcw_state_t* state) {
+    if (state->level_changed) render_publish_level(state);
+}
+
+
+/**
+ * Ask the render thread to move the overlay window for a tracked window.
+ * Called by the input thread.
+ *
+ * rect: absolute area to cover for `window`
+ */
+void render_move (xcw_state_t* state, xcb_window_t window,
+                  xcb_rectangle_t rect) {
+    xcw_render_t* render = state->render;
+    xcw_move_t* move = malloc(sizeof(xcw_move_t));
+    move->window = window;
+    move->rect = rect;
+    move->next = atomic_load(&(render->moves));
+    while (!atomic_compare_exchange_weak(&(render->moves), &(move->next),
+                                         move));
+    render_wake(state);
+}
+
+
+/**
+ * Move overlay windows from a setup structure replaced by relabelling to the
+ * structures for the same windows in the current structure, and mark them for
+ * redrawing.  Called by the render thread.
+ *
+ * garbage: the replaced structure
+ */
+void render_transfer_overlays (xcw_state_t* state, xcw_garbage_t* garbage) {
+    window_setup_t** old_leaves;
+    window_setup_t** new_leaves;
+    int old_size = wsetups_count_leaves(garbage->wsetups,
+                                        garbage->wsetups_size);
+    int new_size = wsetups_count_leaves(state->wsetups_root,
+                                        state->wsetups_root_size);
+    wsetups_get_leaves(garbage->wsetups, garbage->wsetups_size, old_size,
+                       &old_leaves, NULL);
+    wsetups_get_leaves(state->wsetups_root, state->wsetups_root_size,
+                       new_size, &new_leaves, NULL);
+
+    // relabelling keeps windows in the same order
+    int o = 0;
+    for (int n = 0; n < new_size; n++) {
+        window_setup_t* new_leaf = new_leaves[n];
+        while (o < old_size &&
+               *(old_leaves[o]->window) != *(new_leaf->window)) {
+            o += 1;
+        }
+        if (o == old_size) break;
+        window_setup_t* old_leaf = old_leaves[o];
+        // an intermediate structure whose overlays were never transferred
+        if (old_leaf->overlay_window == NULL) continue;
+
+        new_leaf->overlay_window = old_leaf->overlay_window;
+        new_leaf->overlay_font_gc = old_leaf->overlay_font_gc;
+        new_leaf->overlay_bg_gc = old_leaf->overlay_bg_gc;
+        new_leaf->overlay_rect = old_leaf->overlay_rect;
+        new_leaf->overlay_shown = old_leaf->overlay_shown;
+        new_leaf->overlay_text = NULL;
+        old_leaf->overlay_window = NULL;
+        old_leaf->overlay_font_gc = NULL;
+        old_leaf->overlay_bg_gc = NULL;
+        old_leaf->overlay_rect = NULL;
+        overlay_owners_set(state, *(new_leaf->overlay_window),
+                           *(new_leaf->window), n);
+    }
+
+    free(new_leaves);
+    free(old_leaves);
+}
+
+
+/**
+ * Move the overlay window for a tracked window.  Called by the render thread.
+ */
+void render_apply_move (xcw_state_t* state, xcw_move_t* move) {
+    // hidden overlays are moved too, in case they're shown again
+    window_setup_t* wsetup = wsetups_find_window(
+        state->wsetups_root, state->wsetups_root_size, move->window);
+    if (wsetup == NULL || wsetup->overlay_window == NULL) return;
+
+    xcb_rectangle_t area = overlay_area(state, &(move->rect),
+                                        strlen(wsetup->label));
+    xorg_window_move_resize(state->xcon, *(wsetup->overlay_window),
+                            area.x, area.y, area.width, area.height);
+    wsetup->overlay_rect->width = area.width;
+    wsetup->overlay_rect->height = area.height;
+    wsetup->overlay_text = NULL;
+}
+
+
+/**
+ * See `render_show_level`.  Map overlay windows in a structure that aren't
+ * shown, and mark all of them as shown in the current generation.
+ */
+void _render_show_wsetups (xcw_state_t* state, window_setup_t* wsetups,
+                           int wsetups_size, int generation) {
+    for (int i = 0; i < wsetups_size; i++) {
+        window_setup_t* wsetup = &(wsetups[i]);
+        if (wsetup->children != NULL) {
+            _render_show_wsetups(state, wsetup->children,
+                                 wsetup->children_size, generation);
+        } else if (wsetup->overlay_window != NULL) {
+            // drawn when the Expose event arrives
+            if (wsetup->overlay_shown == 0) {
+                xcb_map_window(state->xcon, *(wsetup->overlay_window));
+            }
+            wsetup->overlay_shown = generation;
+        }
+    }
+}
+
+
+/**
+ * See `render_show_level`.  Unmap overlay windows in a structure that are
+ * shown, but not in the current generation.
+ */
+void _render_hide_wsetups (xcw_state_t* state, window_setup_t* wsetups,
+                           int wsetups_size, int generation) {
+    for (int i = 0; i < wsetups_size; i++) {
+        window_setup_t* wsetup = &(wsetups[i]);
+        if (wsetup->children != NULL) {
+            _render_hide_wsetups(state, wsetup->children,
+                                 wsetup->children_size, generation);
+        } else if (wsetup->overlay_window != NULL &&
+                   wsetup->overlay_shown != 0 &&
+                   wsetup->overlay_shown != generation) {
+            xcb_unmap_window(state->xcon, *(wsetup->overlay_window));
+            wsetup->overlay_shown = 0;
+        }
+    }
+}
+
+
+/**
+ * Show exactly the overlay windows in the current level, by mapping and
+ * unmapping only those that change.  `xcb_flush` should be called after
+ * calling this function.  Called by the render thread.
+ */
+void render_show_level (xcw_render_t* render) {
+    xcw_state_t* state = &(render->state);
+    render->generation += 1;
+    _render_show_wsetups(state, state->wsetups, state->wsetups_size,
+                         render->generation);
+    _render_hide_wsetups(state, state->wsetups_root, state->wsetups_root_size,
+                         render->generation);
+}
+
+
+/**
+ * Handle an event on the render thread's connection.  A click on an overlay
+ * window is handed to the input thread, which chooses its window.
+ *
+ * returns: whether overlay windows need to be redrawn
+ */
+int render_handle_event (xcw_render_t* render, xcb_generic_event_t* event) {
+    xcw_state_t* state = &(render->state);
+    switch (event->response_type & ~0x80) {
+        case 0: {
+            xcb_generic_error_t* evterr = (xcb_generic_error_t*) event;
+            xcw_state_fail(state, "render event loop error: %d",
+                           evterr->error_code);
+            break;
+        }
+        case XCB_EXPOSE: {
+            xcb_expose_event_t* expose = (xcb_expose_event_t*)event;
+            overlays_invalidate(state, expose->window);
+            // more events follow for the same window if count > 0
+            return expose->count == 0;
+        }
+        case XCB_BUTTON_PRESS: {
+            xcb_button_press_event_t* bp = (xcb_button_press_event_t*)event;
+            overlay_owner_t owner = overlay_owners_get(state, bp->event);
+            // a single write this small is never split up
+            if (state->input->click && owner.overlay != XCB_NONE &&
+                write(render->click_fds[1], &owner, sizeof(owner)) < 0 &&
+                errno != EAGAIN) {
+                xcw_state_fail(state, "write: %s", strerror(errno));
+            }
+            break;
+        }
+    }
+    return 0;
+}
+
+
+/**
+ * Main loop of the render thread: show and redraw overlay windows for the
+ * latest level published by the input thread and on Expose events, and
+ * destroy overlay windows of removed windows.  Returns when `render->quit` is
+ * set, or when something fails.
+ *
+ * data: `xcw_render_t*`
+ */
+void* render_run (void* data) {
+    xcw_render_t* render = (xcw_render_t*)data;
+    xcw_state_t* state = &(render->state);
+    struct pollfd fds[] = {
+        { xcb_get_file_descriptor(state->xcon), POLLIN, 0 },
+        { render->wake_fds[0], POLLIN, 0 }
+    };
+    int dirty = 1;
+
+    while (!atomic_load(&(render->quit)) && state->status == XCW_RUNNING) {
+        xcb_generic_event_t* event;
+        while ((event = xcb_poll_for_event(state->xcon))) {
+            if (render_handle_event(render, event)) dirty = 1;
+            free(event);
+        }
+        if (xcb_connection_has_error(state->xcon)) {
+            xcw_state_fail(state, "render connection");
+            break;
+        }
+
+        // garbage is only discarded after a level of the structure replacing
+        // it is published, so taking garbage first means we always have that
+        // structure; moves are looked up in it, so are taken last
+        xcw_garbage_t* garbage = atomic_exchange(&(render->garbage), NULL);
+        xcw_level_t* level = atomic_exchange(&(render->level), NULL);
+        xcw_move_t* move = atomic_exchange(&(render->moves), NULL);
+        if (level != NULL) {
+            state->wsetups = level->wsetups;
+            state->wsetups_size = level->wsetups_size;
+            state->depth = level->depth;
+            state->wsetups_root = level->wsetups_root;
+            state->wsetups_root_size = level->wsetups_root_size;
+            free(level);
+        }
+        for (xcw_garbage_t* g = garbage; g != NULL; g = g->next) {
+            render_transfer_overlays(state, g);
+        }
+        if (level != NULL || garbage != NULL) {
+            render_show_level(render);
+            dirty = 1;
+        }
+        // the stack is newest first, and only the newest move for each window
+        // matters
+        while (move != NULL) {
+            if (move->window != XCB_NONE) {
+                render_apply_move(state, move);
+                dirty = 1;
+                for (xcw_move_t* m = move->next; m != NULL; m = m->next) {
+                    if (m->window == move->window) m->window = XCB_NONE;
+                }
+            }
+            xcw_move_t* next = move->next;
+            free(move);
+            move = next;
+        }
+
+        // draw before tearing down, so the typed character is shown sooner
+        if (dirty) {
+            overlays_set_text(state);
+            dirty = 0;
+        }
+        while (garbage != NULL) {
+            XCW_PROBE1(free_start, garbage->wsetups_size);
+            for (int i = 0; i < garbage->wsetups_size; i++) {
+                wsetup_free(state, &(garbage->wsetups[i]));
+            }
+            XCW_PROBE1(free_done, garbage->wsetups_size);
+            free(garbage->wsetups);
+            free(garbage->labels);
+            xcw_garbage_t* next = garbage->next;
+            free(garbage);
+            garbage = next;
+        }
+        xcb_flush(state->xcon);
+
+        // flushing may read events, which then won't wake `poll`
+        if ((event = xcb_poll_for_queued_event(state->xcon))) {
+            if (render_handle_event(render, event)) dirty = 1;
+            free(event);
+            continue;
+        }
+        if (poll(fds, 2, -1) < 0 && errno != EINTR) {
+            xcw_state_fail(state, "poll: %s", strerror(errno));
+        }
+        char buf[64];
+        while (read(render->wake_fds[0], buf, sizeof(buf)) > 0);
+    }
+
+    if (state->status == XCW_ERROR) {
+        close(render->stop_fds[1]);
+        render->stop_fds[1] = -1;
+    }
+    return NULL;
+}
+
+
+/**
+ * Set up the render thread's copy of the program state, using the connection
+ * opened by `initialise_xorg`.  Should be called once the rest of the state is
+ * initialised, and before `initialise_overlays`.
+ *
+ * returns: 0 on success, -1 on failure (see `xcw_state_fail`)
+ */
+int initialise_render (xcw_state_t* state) {
+    xcw_render_t* render = state->render;
+    xcb_connection_t* render_xcon = render->state.xcon;
+    render->state = *state;
+    render->state.xcon = render_xcon;
+    render->state.render = NULL;
+    render->generation = 1;
+    state->overlay_pool->idle_max = OVERLAY_POOL_IDLE_MAX;
+    atomic_init(&(render->level), NULL);
+    atomic_init(&(render->garbage), NULL);
+    atomic_init(&(render->moves), NULL);
+    atomic_init(&(render->quit), 0);
+
+    if (pipe(render->wake_fds) != 0 || pipe(render->stop_fds) != 0 ||
+        pipe(render->click_fds) != 0) {
+        return xcw_state_fail(state, "pipe: %s", strerror(errno));
+    }
+    for (int i = 0; i < 2; i++) {
+        int flags = fcntl(render->wake_fds[i], F_GETFL);
+        fcntl(render->wake_fds[i], F_SETFL, flags | O_NONBLOCK);
+        flags = fcntl(render->click_fds[i], F_GETFL);
+        fcntl(render->click_fds[i], F_SETFL, flags | O_NONBLOCK);
+    }
+    return 0;
+}
+
+
+/**
+ * Start the render thread, which draws the current level of the setup
+ * structure straight away.
+ *
+ * returns: 0 on success, -1 on failure (see `xcw_state_fail`)
+ */
+int render_start (xcw_state_t* state) {
+    xcw_render_t* render = state->render;
+    int err = pthread_create(&(render->thread), NULL, render_run, render);
+    if (err != 0) return xcw_state_fail(state, "pthread_create: %s",
+                                        strerror(err));
+    render->started = 1;
+    return 0;
+}
+
+
+/**
+ * Stop the render thread, if it was started, and free everything handed to it
+ * that it hasn't taken.  Called by the input thread.  If the render thread
+ * failed, its error becomes the input thread's, unless that has one already.
+ */
+void render_stop (xcw_state_t* state) {
+    xcw_render_t* render = state->render;
+    if (render->started) {
+        char c = 0;
+        atomic_store(&(render->quit), 1);
+        // if the pipe is full, the render thread is already awake
+        if (write(render->wake_fds[1], &c, 1) < 0) {}
+        pthread_join(render->thread, NULL);
+        render->started = 0;
+    }
+    if (render->state.status == XCW_ERROR && state->error == NULL) {
+        state->status = XCW_ERROR;
+        state->error = render->state.error;
+        render->state.error = NULL;
+    }
+    free(render->state.error);
+    render->state.error = NULL;
+
+    free(atomic_exchange(&(render->level), NULL));
+    xcw_move_t* move = atomic_exchange(&(render->moves), NULL);
+    while (move != NULL) {
+        xcw_move_t* next = move->next;
+        free(move);
+        move = next;
+    }
+    xcw_garbage_t* garbage = atomic_exchange(&(render->garbage), NULL);
+    while (garbage != NULL) {
+        for (int i = 0; i < garbage->wsetups_size; i++) {
+            wsetup_free(&(render->state), &(garbage->wsetups[i]));
+        }
+        free(garbage->wsetups);
+        free(garbage->labels);
+        xcw_garbage_t* next = garbage->next;
+        free(garbage);
+        garbage = next;
+    }
+}
+
+
+/**
+ * Choose a tracked window, which finishes choosing (see `state->status`).
+ */
+void tracking_choose (xcw_state_t* state, xcb_window_t window) {
+    XCW_PROBE2(window_chosen, window, state->depth);
+    ewmh_window_act(state, window);
+    state->chosen = window;
+    state->status = XCW_CHOSEN;
+}
+
+
+/**
+ * Choose the window in a setup structure or replace the current array of setup
+ * structures with its children.  If a window is chosen, this finishes choosing
+ * (see `state->status`); otherwise, the new level is published by
+ * `render_publish_typing`.
+ */
+void wsetup_choose (xcw_state_t* state, window_setup_t* wsetup) {
+    if (wsetup->window != NULL && wsetup->children_size == 0) {
+        tracking_choose(state, *(wsetup->window));
+    } else {
+        state->history = realloc(state->history,
+                                 (state->depth + 1) * sizeof(xcw_level_t));
+        xcw_level_t level = {
+            state->wsetups, state->wsetups_size, state->depth,
+            state->wsetups_root, state->wsetups_root_size
+        };
+        state->history[state->depth] = level;
+        state->wsetups = wsetup->children;
+        state->wsetups_size = wsetup->children_size;
+        state->depth += 1;
+        state->level_changed = 1;
+    }
+}
+
+
+/**
+ * Narrow down the setup structure by choosing an item.  The rest of the
+ * structure is kept, so that this can be undone by `wsetups_ascend`.
+ *
+ * index: array index in `wsetups` to choose
+ *
+ * returns: 0 on success, -1 if there's no item at `index`
+ */
+int wsetups_descend_by_index (xcw_state_t* state, int index) {
+    if (index >= state->wsetups_size) return -1;
+    window_setup_t* wsetup = &(state->wsetups[index]);
+    if (wsetup->window == NULL && wsetup->children == NULL) return -1;
+    wsetup_choose(state, wsetup);
+    return 0;
+}
+
+
+/**
+ * Undo the last call to `wsetups_descend_by_index`, if any.
+ */
+void wsetups_ascend (xcw_state_t* state) {
+    if (state->depth == 0) return;
+    state->depth -= 1;
+    state->wsetups = state->history[state->depth].wsetups;
+    state->wsetups_size = state->history[state->depth].wsetups_size;
+    state->level_changed = 1;
+}
+
+
+
+// -- searching
+
+/**
+ * Make the label drawn over a window with `--search`: its title, or its class
+ * if it has no title.  The overlay font only has single-byte characters, so
+ * each multi-byte UTF-8 character becomes '?', and control characters become
+ * spaces.  Long titles are cut short.
+ *
+ * name: as returned by `discovery_find_windows`
+ * label (output): null-terminated label; has room for `SEARCH_LABEL_MAX + 1`
+ *     characters
+ */
+void search_make_label (char* name, char* label) {
+    char* text = name;
+    if (*text == '\0') {
+        // skip the title and instance
+        text += strlen(text) + 1;
+        text += strlen(text) + 1;
+    }
+    int size = 0;
+    for (unsigned char* c = (unsigned char*)text;
+         *c != '\0' && size < SEARCH_LABEL_MAX; c++) {
+        // continuation bytes of multi-byte characters are skipped
+        if ((*c & 0xc0) == 0x80) continue;
+        label[size] = *c >= 0x80 ? '?' : *c < 0x20 ? ' ' : *c;
+        size += 1;
+    }
+    label[size] = '\0';
+}
+
+
+/**
+ * Construct data for tracked windows with `--search`: one setup structure for
+ * each window, labelled with its title, and an index of the windows' names.
+ * Any search so far is forgotten.  Overlay windows are not created; see
+ * `initialise_overlays`.
+ *
+ * state: the result is stored in here
+ * windows: tracked windows
+ * names: for each of `windows`, its name from `discovery_find_windows`
+ *
+ * returns: 0 on success, -1 on failure (see `xcw_state_fail`); on failure, the
+ *     index is empty, but the rest of the data is stored
+ */
+int initialise_search_tracking (xcw_state_t* state, xcb_window_t* windows,
+                                char** names, int windows_size) {
+    state->labels = calloc(windows_size * (SEARCH_LABEL_MAX + 1) + 1, 1);
+    state->wsetups = calloc(windows_size, sizeof(window_setup_t));
+    state->wsetups_size = windows_size;
+    state->wsetups_root = state->wsetups;
+    state->wsetups_root_size = state->wsetups_size;
+
+    // the title, instance and class are searched, but a query can't span more
+    // than one of them, since newlines can't be typed
+    char** texts = calloc(windows_size, sizeof(char*));
+    for (int i = 0; i < windows_size; i++) {
+        char* label = state->labels + i * (SEARCH_LABEL_MAX + 1);
+        search_make_label(names[i], label);
+        state->wsetups[i] = initialise_window_setup(windows[i], label, 0);
+
+        char* instance = names[i] + strlen(names[i]) + 1;
+        char* class = instance + strlen(instance) + 1;
+        int size = (class + strlen(class)) - names[i];
+        texts[i] = malloc(size + 1);
+        memcpy(texts[i], names[i], size + 1);
+        texts[i][instance - names[i] - 1] = '\n';
+        texts[i][class - names[i] - 1] = '\n';
+    }
+
+    xcw_search_t empty = {
+        { 0 }, NULL, 0, NULL, NULL, NULL,
+        state->search.retired, state->search.retired_size
+    };
+    state->search = empty;
+    int status = title_index_create(texts, windows_size,
+                                    &(state->search.index));
+    if (state->recorder != NULL) {
+        trace_recorder_labels(state->recorder, windows, NULL, windows_size);
+    }
+    for (int i = 0; i < windows_size; i++) free(texts[i]);
+    free(texts);
+    if (status != 0) return xcw_state_fail(state, "title_index_create");
+    return 0;
+}
+
+
+/**
+ * Add a character to the search, if any windows match the result, and make a
+ * level of the setup structure for the matching windows.  The level isn't
+ * published; see `search_type`.
+ *
+ * returns: the number of matching windows; if 0, the search is unchanged
+ */
+int search_narrow (xcw_state_t* state, char c) {
+    xcw_search_t* search = &(state->search);
+    int n = search->query_size;
+    search->query = realloc(search->query, n + 2);
+    search->query[n] = c;
+    search->query[n + 1] = '\0';
+
+    // a window matching the longer query also matched the shorter one
+    int* candidates = n == 0 ? NULL : search->matches[n - 1];
+    int candidates_size = (
+        n == 0 ? state->wsetups_root_size : search->matches_sizes[n - 1]);
+    int* matches = calloc(candidates_size, sizeof(int));
+    int size = title_index_search(&(search->index), search->query,
+                                  candidates, candidates_size, matches);
+    if (size == 0) {
+        search->query[n] = '\0';
+        free(matches);
+        return 0;
+    }
+
+    window_setup_t* level = calloc(size, sizeof(window_setup_t));
+    for (int i = 0; i < size; i++) {
+        window_setup_t wsetup = {
+            NULL, NULL, NULL, NULL, NULL, 0, NULL, NULL, 0,
+            &(state->wsetups_root[matches[i]]), 1
+        };
+        level[i] = wsetup;
+    }
+    search->matches = realloc(search->matches, (n + 1) * sizeof(int*));
+    search->matches_sizes = realloc(search->matches_sizes,
+                                    (n + 1) * sizeof(int));
+    search->levels = realloc(search->levels, (n + 1) * sizeof(window_setup_t*));
+    search->matches[n] = matches;
+    search->matches_sizes[n] = size;
+    search->levels[n] = level;
+    search->query_size = n + 1;
+    return size;
+}
+
+
+/**
+ * Make the last level made by searching the current level of the setup
+ * structure, or the top level if nothing has been typed.
+ */
+void search_set_level (xcw_state_t* state) {
+    xcw_search_t* search = &(state->search);
+    if (search->query_size == 0) {
+        state->wsetups = state->wsetups_root;
+        state->wsetups_size = state->wsetups_root_size;
+    } else {
+        state->wsetups = search->levels[search->query_size - 1];
+        state->wsetups_size = search->matches_sizes[search->query_size - 1];
+    }
+}
+
+
+/**
+ * Handle a character typed with `--search`.  Finishes choosing if only one
+ * window matches; otherwise, the new level hiding windows that no longer
+ * match is published by `render_publish_typing`.  Characters that no window
+ * matches are ignored.
+ */
+void search_type (xcw_state_t* state, char c) {
+    int size = search_narrow(state, c);
+    if (size == 0) return;
+    search_set_level(state);
+    if (size == 1) wsetup_choose(state, state->wsetups[0].children);
+    state->level_changed = 1;
+}
+
+
+/**
+ * Undo the last call to `search_type` that changed the search, if any.
+ */
+void search_erase (xcw_state_t* state) {
+    xcw_search_t* search = &(state->search);
+    if (search->query_size == 0) return;
+    search->query_size -= 1;
+    search->query[search->query_size] = '\0';
+    search_set_level(state);
+    state->level_changed = 1;
+
+    // the render thread may still be showing the old level
+    free(search->matches[search->query_size]);
+    search->retired = realloc(search->retired, (search->retired_size + 1) *
+                                               sizeof(window_setup_t*));
+    search->retired[search->retired_size] = search->levels[search->query_size];
+    search->retired_size += 1;
+}
+
+
+/**
+ * Rebuild the search for a new set of tracked windows, keeping as much of the
+ * typed text as still matches any window.  The new level isn't published, and
+ * the old structure isn't discarded.  If the index can't be built, choosing
+ * fails, and the search is left empty.
+ *
+ * windows, names: as taken by `initialise_search_tracking`
+ * old_levels (output): levels made by searching the old structure, to be
+ *     discarded with `render_discard_level`
+ * old_levels_size (output): size of `old_levels`
+ */
+void search_rebuild (xcw_state_t* state, xcb_window_t* windows, char** names,
+                     int windows_size, window_setup_t*** old_levels,
+                     int* old_levels_size) {
+    xcw_search_t old = state->search;
+    *old_levels = old.levels;
+    *old_levels_size = old.query_size;
+    for (int i = 0; i < old.query_size; i++) free(old.matches[i]);
+    free(old.matches);
+    free(old.matches_sizes);
+    title_index_free(&(old.index));
+
+    if (initialise_search_tracking(state, windows, names, windows_size) == 0) {
+        for (int i = 0; i < old.query_size; i++) {
+            if (search_narrow(state, old.query[i]) == 0) break;
+        }
+    }
+    free(old.query);
+    search_set_level(state);
+}
+
+
+// -- live tracking
+
+/**
+ * Record tracked windows so that changes to them can be followed, and ask for
+ * events about windows inside frames (events about children of the root
+ * window are selected by `initialise_root_events`).  Events already selected
+ * by the client on those windows are kept, and restored by `xcw_state_free`.
+ *
+ * windows: tracked windows, in label order
+ * tops: for each of `windows`, the child of the root window containing it
+ * rects: absolute areas covered by `windows`
+ * names: names of `windows` with `--search` or stable labels, or NULL; kept
+ *     by the tracked windows
+ */
+void initialise_tracking (xcw_state_t* state, xcb_window_t* windows,
+                          xcb_window_t* tops, xcb_rectangle_t* rects,
+                          char** names, int windows_size) {
+    state->tracked = calloc(windows_size, sizeof(tracked_window_t));
+    state->tracked_size = windows_size;
+    state->masked = calloc(windows_size, sizeof(masked_window_t));
+    xcb_get_geometry_cookie_t* ggcs = calloc(
+        windows_size, sizeof(xcb_get_geometry_cookie_t));
+    xcb_get_window_attributes_cookie_t* gwacs = calloc(
+        windows_size, sizeof(xcb_get_window_attributes_cookie_t));
+
+    for (int i = 0; i < windows_size; i++) {
+        tracked_window_t tracked = {
+            windows[i], tops[i], rects[i], 0, 0,
+            names == NULL ? NULL : names[i]
+        };
+        state->tracked[i] = tracked;
+        if (windows[i] != tops[i]) {
+            ggcs[i] = xcb_get_geometry(state->xcon, tops[i]);
+            gwacs[i] = xcb_get_window_attributes(state->xcon, windows[i]);
+        }
+    }
+
+    for (int i = 0; i < windows_size; i++) {
+        if (windows[i] != tops[i]) {
+            xcb_get_geometry_reply_t* ggr = xcb_get_geometry_reply(
+                state->xcon, ggcs[i], NULL);
+            if (ggr != NULL) {
+                state->tracked[i].top_x = ggr->x;
+                state->tracked[i].top_y = ggr->y;
+                free(ggr);
+            }
+            // the window may already be gone; we'll be told about its frame
+            xcb_get_window_attributes_reply_t* gwar =
+                xcb_get_window_attributes_reply(state->xcon, gwacs[i], NULL);
+            if (gwar == NULL) continue;
+            masked_window_t masked = { windows[i], gwar->your_event_mask };
+            free(gwar);
+            uint32_t mask[] = {
+                masked.event_mask | XCB_EVENT_MASK_STRUCTURE_NOTIFY
+            };
+            xcb_void_cookie_t cwac = xcb_change_window_attributes_checked(
+                state->xcon, windows[i], XCB_CW_EVENT_MASK, mask);
+            xcb_discard_reply(state->xcon, cwac.sequence);
+            state->masked[state->masked_size] = masked;
+            state->masked_size += 1;
+        }
+    }
+    free(ggcs);
+    free(gwacs);
+}
+
+
+/**
+ * Determine whether a window is one of our overlay windows, whose events
+ * should be ignored.
+ */
+int tracking_is_overlay (xcw_state_t* state, xcb_window_t window) {
+    // overlay windows are created on the render thread's connection
+    const xcb_setup_t* setup = xcb_get_setup(state->render->state.xcon);
+    return (window & ~(setup->resource_id_mask)) == setup->resource_id_base;
+}
+
+
+/**
+ * Assign new labels to the remaining tracked windows, after a window is
+ * removed.  Characters typed so far are discarded, since the new labels don't
+ * share their prefix; with `--search`, they're kept as far as any window still
+ * matches them.  Finishes choosing with XCW_NO_MATCH if no windows remain.
+ *
+ * removed: a tracked window, or the child of the root window containing
+ *     tracked windows
+ */
+void tracking_relabel (xcw_state_t* state, xcb_window_t removed) {
+    xcb_window_t* windows = calloc(state->tracked_size, sizeof(xcb_window_t));
+    char** names = calloc(state->tracked_size, sizeof(char*));
+    int size = 0;
+    for (int i = 0; i < state->tracked_size; i++) {
+        tracked_window_t* tracked = &(state->tracked[i]);
+        if (tracked->window != removed && tracked->top != removed) {
+            windows[size] = tracked->window;
+            names[size] = tracked->name;
+            state->tracked[size] = *tracked;
+            size += 1;
+        } else {
+            free(tracked->name);
+        }
+    }
+    state->tracked_size = size;
+    if (size == 0) {
+        state->status = XCW_NO_MATCH;
+        free(names);
+        free(windows);
+        return;
+    }
+
+    window_setup_t* old_wsetups = state->wsetups_root;
+    int old_wsetups_size = state->wsetups_root_size;
+    char* old_labels = state->labels;
+    window_setup_t** old_levels = NULL;
+    int old_levels_size = 0;
+    int* order = NULL;
+    if (state->input->search) {
+        search_rebuild(state, windows, names, size,
+                       &old_levels, &old_levels_size);
+    } else if (initialise_window_tracking(state, windows, names, size, 0,
+                                          &order) != 0) {
+        free(names);
+        free(windows);
+        return;
+    }
+    if (order != NULL) {
+        // remembered labels aren't in window order
+        reorder_items(state->tracked, sizeof(tracked_window_t), order, size);
+        free(order);
+    }
+    state->depth = 0;
+    free(names);
+    free(windows);
+    render_publish_level(state);
+    render_discard(state, old_wsetups, old_wsetups_size, old_labels);
+    for (int i = 0; i < old_levels_size; i++) {
+        render_discard_level(state, old_levels[i]);
+    }
+    free(old_levels);
+
+    // overlay windows sized to fit the label need resizing
+    if (state->input->overlay_size == OVERLAY_SIZE_LABEL) {
+        for (int i = 0; i < state->tracked_size; i++) {
+            render_move(state, state->tracked[i].window,
+                        state->tracked[i].rect);
+        }
+    }
+}
+
+
+/**
+ * Follow a tracked window, or a child of the root window containing tracked
+ * windows, being moved or resized.  Each affected overlay window is moved
+ * once.
+ */
+void tracking_handle_configure (xcw_state_t* state,
+                                xcb_configure_notify_event_t* cn) {
+    // sent by the window manager, with coordinates relative to the root
+    int synthetic = cn->response_type & 0x80;
+    for (int i = 0; i < state->tracked_size; i++) {
+        tracked_window_t* tracked = &(state->tracked[i]);
+        xcb_rectangle_t rect = tracked->rect;
+
+        if (tracked->window == cn->window) {
+            if (tracked->top == tracked->window || synthetic) {
+                rect.x = cn->x + cn->border_width;
+                rect.y = cn->y + cn->border_width;
+            }
+            // otherwise the position is relative to the frame, which we
+            // follow separately
+            rect.width = cn->width;
+            rect.height = cn->height;
+        } else if (tracked->top == cn->window) {
+            rect.x += cn->x - tracked->top_x;
+            rect.y += cn->y - tracked->top_y;
+            tracked->top_x = cn->x;
+            tracked->top_y = cn->y;
+        } else {
+            continue;
+        }
+
+        if (rect.x != tracked->rect.x || rect.y != tracked->rect.y ||
+            rect.width != tracked->rect.width ||
+            rect.height != tracked->rect.height) {
+            tracked->rect = rect;
+            render_move(state, tracked->window, rect);
+        }
+    }
+}
+
+
+/**
+ * Follow a tracked window, or a child of the root window containing tracked
+ * windows, being unmapped or destroyed.  Relabels windows if any tracked window
+ * is affected.
+ */
+void tracking_handle_removal (xcw_state_t* state, xcb_window_t window) {
+    for (int i = 0; i < state->tracked_size; i++) {
+        if (state->tracked[i].window == window ||
+            state->tracked[i].top == window) {
+            tracking_relabel(state, window);
+            return;
+        }
+    }
+}
+
+
+// -- window ordering
+
+/**
+ * Compare monitors by position, for use with `qsort`: left to right, then top
+ * to bottom.
+ */
+int compare_monitors (const void* a, const void* b) {
+    const xcb_rectangle_t* ma = a;
+    const xcb_rectangle_t* mb = b;
+    if (ma->x != mb->x) return ma->x - mb->x;
+    return ma->y - mb->y;
+}
+
+
+/**
+ * Compare window places by monitor, for use with `qsort`.
+ */
+int compare_places_monitor (const void* a, const void* b) {
+    const window_place_t* pa = a;
+    const window_place_t* pb = b;
+    return pa->monitor - pb->monitor;
+}
+
+
+/**
+ * Compare window places by horizontal position, for use with `qsort`.
+ */
+int compare_places_x (const void* a, const void* b) {
+    const window_place_t* pa = a;
+    const window_place_t* pb = b;
+    if (pa->cx != pb->cx) return pa->cx - pb->cx;
+    return pa->cy - pb->cy;
+}
+
+
+/**
+ * Compare window places by vertical position, for use with `qsort`.
+ */
+int compare_places_y (const void* a, const void* b) {
+    const window_place_t* pa = a;
+    const window_place_t* pb = b;
+    if (pa->cy != pb->cy) return pa->cy - pb->cy;
+    return pa->cx - pb->cx;
+}
+
+
+/**
+ * Request the layout of monitors, if the X server supports it.  The reply is
+ * used by `order_windows`.
+ *
+ * returns: whether the request was sent
+ */
+int xorg_request_monitors (xcw_state_t* state,
+                           xcb_randr_get_monitors_cookie_t* cookie) {
+    const xcb_query_extension_reply_t* qer = (
+        xcb_get_extension_data(state->xcon, &xcb_randr_id));
+    if (qer == NULL || !qer->present) return 0;
+    *cookie = xcb_randr_get_monitors(state->xcon, state->xroot, 1);
+    return 1;
+}
+
+
+/**
+ * Get the layout of monitors from a request sent by `xorg_request_monitors`.
+ * If the request failed (RandR is older than 1.5), there are no monitors.
+ *
+ * monitors (output): absolute area of each monitor
+ * monitors_size (output): size of `monitors`
+ */
+void xorg_get_monitors (xcw_state_t* state,
+                        xcb_randr_get_monitors_cookie_t cookie,
+                        xcb_rectangle_t** monitors, int* monitors_size) {
+    xcb_randr_get_monitors_reply_t* gmr;
+    xcb_generic_error_t* error = NULL;
+    if (!(gmr = xcb_randr_get_monitors_reply(state->xcon, cookie, &error))) {
+        free(error);
+        *monitors = NULL;
+        *monitors_size = 0;
+        return;
+    }
+
+    *monitors = calloc(gmr->nMonitors, sizeof(xcb_rectangle_t));
+    int size = 0;
+    xcb_randr_monitor_info_iterator_t iter = (
+        xcb_randr_get_monitors_monitors_iterator(gmr));
+    for (; iter.rem; xcb_randr_monitor_info_next(&iter)) {
+        xcb_rectangle_t rect = {
+            iter.data->x, iter.data->y, iter.data->width, iter.data->height
+        };
+        (*monitors)[size] = rect;
+        size += 1;
+    }
+    *monitors_size = size;
+    free(gmr);
+}
+
+
+/**
+ * Get the monitor containing the centre of a window place.
+ *
+ * returns: index in `monitors`, or `monitors_size` if no monitor contains it
+ */
+int window_place_monitor (window_place_t* place,
+                          xcb_rectangle_t* monitors, int monitors_size) {
+    for (int i = 0; i < monitors_size; i++) {
+        if (rect_contains(&(monitors[i]), place->cx, place->cy)) return i;
+    }
+    return monitors_size;
+}
+
+
+/**
+ * Order window places so that every contiguous range is as close together on
+ * the screen as possible, by recursively splitting at the median along the
+ * axis with the largest spread.  Halves are in reading order: top before
+ * bottom, left before right.
+ */
+void order_window_places (window_place_t* places, int places_size) {
+    if (places_size <= 2) {
+        if (places_size == 2) {
+            qsort(places, places_size, sizeof(window_place_t),
+                  compare_places_y);
+        }
+        return;
+    }
+
+    int min_x = places[0].cx, max_x = places[0].cx;
+    int min_y = places[0].cy, max_y = places[0].cy;
+    for (int i = 1; i < places_size; i++) {
+        min_x = min(min_x, places[i].cx);
+        max_x = max(max_x, places[i].cx);
+        min_y = min(min_y, places[i].cy);
+        max_y = max(max_y, places[i].cy);
+    }
+    qsort(places, places_size, sizeof(window_place_t),
+          max_x - min_x > max_y - min_y ? compare_places_x : compare_places_y);
+
+    int half = places_size / 2;
+    order_window_places(places, half);
+    order_window_places(places + half, places_size - half);
+}
+
+
+/**
+ * Order tracked windows by position, so that labels sharing a prefix are on the
+ * same monitor and close together.  Monitors are ordered left to right, and
+ * windows not on any monitor come last.  Monitors are kept in `state`.
+ *
+ * monitors_requested: result of `xorg_request_monitors`
+ * monitors_cookie: set by `xorg_request_monitors`
+ * windows: tracked windows; reordered in place
+ * tops: for each of `windows`, the child of the root window containing it;
+ *     reordered in place
+ * rects: absolute areas to cover for `windows`; reordered in place
+ * names: names of `windows`, or NULL; reordered in place
+ */
+void order_windows (xcw_state_t* state, int monitors_requested,
+                    xcb_randr_get_monitors_cookie_t monitors_cookie,
+                    xcb_window_t* windows, xcb_window_t* tops,
+                    xcb_rectangle_t* rects, char** names, int windows_size) {
+    xcb_rectangle_t* monitors = NULL;
+    int monitors_size = 0;
+    if (monitors_requested) {
+        xorg_get_monitors(state, monitors_cookie, &monitors, &monitors_size);
+        qsort(monitors, monitors_size, sizeof(xcb_rectangle_t),
+              compare_monitors);
+    }
+
+    window_place_t* places = calloc(windows_size, sizeof(window_place_t));
+    for (int i = 0; i < windows_size; i++) {
+        window_place_t place = {
+            windows[i], tops[i], rects[i], 0,
+            rects[i].x + rects[i].width / 2, rects[i].y + rects[i].height / 2,
+            names == NULL ? NULL : names[i]
+        };
+        place.monitor = window_place_monitor(&place, monitors, monitors_size);
+        places[i] = place;
+    }
+
+    qsort(places, windows_size, sizeof(window_place_t),
+          compare_places_monitor);
+    int group_start = 0;
+    for (int i = 1; i <= windows_size; i++) {
+        if (i == windows_size || places[i].monitor != places[i - 1].monitor) {
+            order_window_places(places + group_start, i - group_start);
+            group_start = i;
+        }
+    }
+
+    for (int i = 0; i < windows_size; i++) {
+        windows[i] = places[i].window;
+        tops[i] = places[i].top;
+        rects[i] = places[i].rect;
+        if (names != NULL) names[i] = places[i].name;
+    }
+    free(places);
+    state->monitors = monitors;
+    state->monitors_size = monitors_size;
+}
+
+
+// -- instances
+
+/**
+ * Handle a request from another instance for the result of choosing.  It's
+ * answered when choosing finishes, by `instance_release`; asking to cancel
+ * finishes choosing.
+ */
+void instance_handle_request (xcw_state_t* state,
+                              xcb_selection_request_event_t* sr) {
+    xcb_atom_t* atoms = state->input->instance_atoms;
+    if (sr->selection == atoms[INSTANCE_ATOM_SELECTION] &&
+        (sr->target == atoms[INSTANCE_ATOM_RESULT] ||
+         sr->target == atoms[INSTANCE_ATOM_CANCEL])) {
+        state->instance_requests = realloc(
+            state->instance_requests,
+            sizeof(xcb_selection_request_event_t) *
+            (state->instance_requests_size + 1));
+        state->instance_requests[state->instance_requests_size] = *sr;
+        state->instance_requests_size += 1;
+        if (sr->target == atoms[INSTANCE_ATOM_CANCEL]) {
+            state->status = XCW_NO_MATCH;
+        }
+        return;
+    }
+
+    // refuse anything else
+    xcb_selection_notify_event_t sn = {
+        XCB_SELECTION_NOTIFY, 0, 0, sr->time, sr->requestor, sr->selection,
+        sr->target, XCB_NONE
+    };
+    xcb_send_event(state->xcon, 0, sr->requestor, XCB_EVENT_MASK_NO_EVENT,
+                   (char*)&sn);
+    xcb_flush(state->xcon);
+}
+
+
+/**
+ * Answer requests from other instances with the result of choosing, and give
+ * up the instance selection.  Called after the keyboard is released, so that
+ * an instance taking over can grab it straight away.
+ *
+ * status: the result of choosing; on failure, other instances are refused, so
+ *     that they choose for themselves
+ */
+void instance_release (xcw_state_t* state, int status) {
+    for (int i = 0; i < state->instance_requests_size; i++) {
+        xcb_selection_request_event_t* sr = &(state->instance_requests[i]);
+        xcb_atom_t property = sr->property == XCB_NONE ?
+            sr->target : sr->property;
+        if (status == XCW_ERROR) {
+            property = XCB_NONE;
+        } else {
+            uint32_t result[] = { (uint32_t)status, state->chosen };
+            xcb_change_property(state->xcon, XCB_PROP_MODE_REPLACE,
+                                sr->requestor, property, XCB_ATOM_CARDINAL,
+                                32, 2, result);
+        }
+        xcb_selection_notify_event_t sn = {
+            XCB_SELECTION_NOTIFY, 0, 0, sr->time, sr->requestor,
+            sr->selection, sr->target, property
+        };
+        xcb_send_event(state->xcon, 0, sr->requestor, XCB_EVENT_MASK_NO_EVENT,
+                       (char*)&sn);
+    }
+    // destroying the window gives up the selection, and tells instances
+    // waiting for it to stop that it has
+    xcb_destroy_window(state->xcon, state->instance_window);
+    state->instance_window = XCB_NONE;
+}
+
+
+/**
+ * Ask the running chooser for its result, or to stop, and wait until it
+ * answers or has stopped.  Events that aren't for us are passed to
+ * `input->event_handler`, as while choosing.
+ *
+ * owner: the window owning the instance selection
+ *
+ * returns: 0 on success, with `state->status` set to the result if there was
+ *     one, or left XCW_RUNNING if we should choose; -1 on failure (see
+ *     `xcw_state_fail`)
+ */
+int instance_wait (xcw_state_t* state, xcb_window_t owner) {
+    xcw_input_t* input = state->input;
+    xcb_atom_t* atoms = input->instance_atoms;
+    // stopping is seen as the owner's window being destroyed
+    uint32_t mask[] = { XCB_EVENT_MASK_STRUCTURE_NOTIFY };
+    xcb_void_cookie_t cwac = xcb_change_window_attributes_checked(
+        state->xcon, owner, XCB_CW_EVENT_MASK, mask);
+    xcb_generic_error_t* error = xcb_request_check(state->xcon, cwac);
+    if (error != NULL) {
+        // it has stopped already
+        free(error);
+        return 0;
+    }
+    int replace = input->instance == INSTANCE_REPLACE;
+    xcb_convert_selection(
+        state->xcon, state->instance_window, atoms[INSTANCE_ATOM_SELECTION],
+        atoms[replace ? INSTANCE_ATOM_CANCEL : INSTANCE_ATOM_RESULT],
+        atoms[INSTANCE_ATOM_RESULT], XCB_CURRENT_TIME);
+    xcb_flush(state->xcon);
+
+    while (state->status == XCW_RUNNING) {
+        xcb_generic_event_t* event = xcb_wait_for_event(state->xcon);
+        if (event == NULL) return xcw_state_fail(state, "connection");
+        int type = event->response_type & ~0x80;
+        if (type == XCB_SELECTION_NOTIFY &&
+            ((xcb_selection_notify_event_t*)event)->requestor ==
+            state->instance_window) {
+            xcb_selection_notify_event_t* sn = (
+                (xcb_selection_notify_event_t*)event);
+            // a refusal means it failed, and we should choose once it stops
+            if (!replace && sn->property != XCB_NONE) {
+                xcb_get_property_cookie_t gpc = xcb_get_property(
+                    state->xcon, 1, state->instance_window, sn->property,
+                    XCB_ATOM_CARDINAL, 0, 2);
+                xcb_get_property_reply_t* gpr = xcb_get_property_reply(
+                    state->xcon, gpc, NULL);
+                if (gpr != NULL && gpr->format == 32 &&
+                    xcb_get_property_value_length(gpr) == 8) {
+                    uint32_t* result = xcb_get_property_value(gpr);
+                    state->status = (int32_t)result[0];
+                    state->chosen = result[1];
+                }
+                free(gpr);
+            }
+        } else if (type == XCB_DESTROY_NOTIFY &&
+                   ((xcb_destroy_notify_event_t*)event)->window == owner) {
+            free(event);
+            return 0;
+        } else if (type == XCB_PROPERTY_NOTIFY &&
+                   ((xcb_property_notify_event_t*)event)->window ==
+                   state->instance_window) {
+            // see `instance_timestamp`
+        } else if (input->event_handler != NULL) {
+            input->event_handler(event, input->event_handler_data);
+        }
+        free(event);
+    }
+    return 0;
+}
+
+
+/**
+ * Wait for a server timestamp, from the PropertyNotify for an empty append to
+ * `property` on `instance_window`, which selects PropertyChange events.
+ * Selection ownership can't be taken with XCB_CURRENT_TIME (ICCCM 2.1).
+ * Other events are passed to `input->event_handler`, as while choosing.
+ *
+ * property: the property that was appended to; notifications for any other
+ *     property on `instance_window` are from earlier appends, and are ignored
+ * time (output): the server time of the append
+ *
+ * returns: 0 on success, -1 on failure (see `xcw_state_fail`)
+ */
+int instance_timestamp (xcw_state_t* state, xcb_atom_t property,
+                        xcb_timestamp_t* time) {
+    xcw_input_t* input = state->input;
+    while (1) {
+        xcb_generic_event_t* event = xcb_wait_for_event(state->xcon);
+        if (event == NULL) return xcw_state_fail(state, "connection");
+        xcb_property_notify_event_t* pn = (xcb_property_notify_event_t*)event;
+        if ((event->response_type & ~0x80) == XCB_PROPERTY_NOTIFY &&
+            pn->window == state->instance_window) {
+            if (pn->atom == property) {
+                *time = pn->time;
+                free(event);
+                return 0;
+            }
+        } else if (input->event_handler != NULL) {
+            input->event_handler(event, input->event_handler_data);
+        }
+        free(event);
+    }
+}
+
+
+/**
+ * Coordinate with other instances, once `initialise_atoms` has succeeded: if
+ * another chooser is running, wait for its result or for it to stop, as
+ * `input->instance` says; then, unless we have a result, own the instance
+ * selection and send the requests for choosing (see `initialise_requests`),
+ * so that they see the windows as they are after any wait.
+ *
+ * returns: 0 on success, with `state->status` set to the result if another
+ *     chooser gave one, and `input->action` performed on a chosen window; -1
+ *     on failure (see `xcw_state_fail`)
+ */
+int initialise_instance (xcw_state_t* state) {
+    xcw_input_t* input = state->input;
+    xcw_cookies_t* cookies = &(state->cookies);
+    if (input->instance == INSTANCE_IGNORE) return 0;
+    xcb_atom_t* atoms = input->instance_atoms;
+    if (cookies->instance_atoms[0].sequence != 0) {
+        for (int i = 0; i < INSTANCE_ATOMS_SIZE; i++) {
+            xcb_intern_atom_reply_t* iar = xcb_intern_atom_reply(
+                state->xcon, cookies->instance_atoms[i], NULL);
+            cookies->instance_atoms[i].sequence = 0;
+            if (iar != NULL) atoms[i] = iar->atom;
+            free(iar);
+        }
+        for (int i = 0; i < INSTANCE_ATOMS_SIZE; i++) {
+            if (atoms[i] == XCB_NONE) {
+                return xcw_state_fail(state, "intern_atom %s",
+                                      INSTANCE_ATOM_NAMES[i]);
+            }
+        }
+        cookies->instance_owner = xcb_get_selection_owner(
+            state->xcon, atoms[INSTANCE_ATOM_SELECTION]);
+    }
+
+    state->instance_window = xcb_generate_id(state->xcon);
+    uint32_t mask[] = { XCB_EVENT_MASK_PROPERTY_CHANGE };
+    xcb_create_window(state->xcon, 0, state->instance_window, state->xroot,
+                      -1, -1, 1, 1, 0, XCB_WINDOW_CLASS_INPUT_ONLY,
+                      XCB_COPY_FROM_PARENT, XCB_CW_EVENT_MASK, mask);
+    // the timestamp for owning the selection arrives with the owner
+    xcb_atom_t property = atoms[INSTANCE_ATOM_SELECTION];
+    xcb_change_property(state->xcon, XCB_PROP_MODE_APPEND,
+                        state->instance_window, property, XCB_ATOM_CARDINAL,
+                        32, 0, NULL);
+    xcb_flush(state->xcon);
+    xcb_get_selection_owner_reply_t* gsor = xcb_get_selection_owner_reply(
+        state->xcon, cookies->instance_owner, NULL);
+    cookies->instance_owner.sequence = 0;
+    if (gsor == NULL) return xcw_state_fail(state, "get_selection_owner");
+    xcb_window_t owner = gsor->owner;
+    free(gsor);
+    if (owner != XCB_NONE) {
+        if (instance_wait(state, owner) != 0) return -1;
+        // the result is acted on as if we had chosen it
+        if (state->status == XCW_CHOSEN) ewmh_window_act(state, state->chosen);
+        if (state->status != XCW_RUNNING) return 0;
+        // another instance may have claimed it since the first timestamp, so
+        // get a new one
+        property = atoms[INSTANCE_ATOM_CANCEL];
+        xcb_change_property(state->xcon, XCB_PROP_MODE_APPEND,
+                            state->instance_window, property,
+                            XCB_ATOM_CARDINAL, 32, 0, NULL);
+        xcb_flush(state->xcon);
+    }
+    xcb_timestamp_t timestamp;
+    if (instance_timestamp(state, property, &timestamp) != 0) return -1;
+
+    // if another instance claims it at the same time, the later one wins,
+    // and the other stops when it's told it lost
+    xcb_set_selection_owner(state->xcon, state->instance_window,
+                            atoms[INSTANCE_ATOM_SELECTION], timestamp);
+    return initialise_requests(state);
+}
+
+
+// -- program
+
+/**
+ * Get the windows to track, ordered by position.
+ *
+ * windows (output): window IDs
+ * windows_size (output): size of `windows`
+ * tops (output): for each of `windows`, the child of the root window
+ *     containing it (which may be the window itself)
+ * rects (output): absolute areas to cover for `windows`
+ * names (output): with `--search` or stable labels, the names of `windows`,
+ *     as returned by `discovery_find_windows`; otherwise, set to NULL
+ *
+ * returns: 0 on success, -1 on failure (see `xcw_state_fail`); outputs are
+ *     only set on success
+ */
+int initialise_tracked_windows (xcw_state_t* state,
+                                xcb_window_t** windows, int* windows_size,
+                                xcb_window_t** tops, xcb_rectangle_t** rects,
+                                char*** names) {
+    XCW_PROBE0(tracked_windows_start);
+    xcb_randr_get_monitors_cookie_t gmc;
+    int monitors_requested = xorg_request_monitors(state, &gmc);
+    int size;
+    *names = NULL;
+    int want_names = (state->input->search && !state->list) ||
+        state->input->label_store != NULL;
+    if (discovery_find_windows(&(state->discovery), windows, tops, rects,
+                               want_names ? names : NULL, &size) != 0) {
+        if (monitors_requested) {
+            xcb_rectangle_t* monitors;
+            int monitors_size;
+            xorg_get_monitors(state, gmc, &monitors, &monitors_size);
+            free(monitors);
+        }
+        XCW_PROBE2(tracked_windows_done, -1, 0);
+        return xcw_state_fail(state, "%s", state->discovery.error);
+    }
+    order_windows(state, monitors_requested, gmc, *windows, *tops, *rects,
+                  *names, size);
+    *windows = realloc(*windows, size * sizeof(xcb_window_t));
+    *tops = realloc(*tops, size * sizeof(xcb_window_t));
+    *windows_size = size;
+    XCW_PROBE2(tracked_windows_done, 0, size);
+    return 0;
+}
+
+
+/**
+ * Make adjustments to tracking windows based on a keypress event.  Finishes
+ * choosing if this chooses a window, or if the key matches nothing.
+ */
+void handle_keypress (xcw_state_t* state, xcb_key_press_event_t* kp) {
+    int index = state->keycodes_ksl[kp->detail];
+    XCW_PROBE3(keypress_start, kp->detail,
+               index == KEYCODES_KSL_BACKSPACE ? BACKSPACE_KEYSYM :
+               index == -1 ? 0 : state->ksl[index].keysym, state->depth);
+    if (state->recorder != NULL) {
+        trace_recorder_key(
+            state->recorder, index == KEYCODES_KSL_BACKSPACE ? '\b' :
+            index == -1 ? '\0' : state->ksl[index].character);
+    }
+
+    if (state->input->search) {
+        if (index == KEYCODES_KSL_BACKSPACE) {
+            search_erase(state);
+        } else if (index == -1) {
+            state->status = XCW_NO_MATCH;
+        } else {
+            search_type(state, state->ksl[index].character);
+        }
+    } else if (index == KEYCODES_KSL_BACKSPACE) {
+        wsetups_ascend(state);
+    } else if (index == -1 || wsetups_descend_by_index(state, index) != 0) {
+        // `wsetups` is ordered like `ksl`
+        state->status = XCW_NO_MATCH;
+    }
+    XCW_PROBE2(keypress_done, state->status, state->depth);
+}
+
+
+/**
+ * Handle an event on the input thread's connection.  Finishes choosing if this
+ * chooses a window.  Events other than key presses are passed on to
+ * `input->event_handler` afterwards, since the connection may be shared.
+ */
+void handle_event (xcw_state_t* state, xcb_generic_event_t* event) {
+    xcw_input_t* input = state->input;
+    switch (event->response_type & ~0x80) {
+        case 0: {
+            // errors may be for the other user of the connection
+            if (input->event_handler != NULL) break;
+            xcb_generic_error_t* evterr = (xcb_generic_error_t*) event;
+            xcw_state_fail(state, "event loop error: %d",
+                           evterr->error_code);
+            return;
+        }
+        case XCB_KEY_PRESS: {
+            handle_keypress(state, (xcb_key_press_event_t*)event);
+            return;
+        }
+        case XCB_SELECTION_REQUEST: {
+            xcb_selection_request_event_t* sr = (
+                (xcb_selection_request_event_t*)event);
+            if (sr->owner == state->instance_window) {
+                instance_handle_request(state, sr);
+                return;
+            }
+            break;
+        }
+        case XCB_SELECTION_CLEAR: {
+            xcb_selection_clear_event_t* sc = (
+                (xcb_selection_clear_event_t*)event);
+            if (sc->owner == state->instance_window) {
+                // a newer instance took over
+                state->status = XCW_NO_MATCH;
+                return;
+            }
+            break;
+        }
+        case XCB_CONFIGURE_NOTIFY: {
+            xcb_configure_notify_event_t* cn = (
+                (xcb_configure_notify_event_t*)event);
+            if (!tracking_is_overlay(state, cn->window)) {
+                tracking_handle_configure(state, cn);
+            }
+            break;
+        }
+        case XCB_UNMAP_NOTIFY: {
+            xcb_unmap_notify_event_t* un = (xcb_unmap_notify_event_t*)event;
+            if (!tracking_is_overlay(state, un->window)) {
+                tracking_handle_removal(state, un->window);
+            }
+            break;
+        }
+        case XCB_DESTROY_NOTIFY: {
+            xcb_destroy_notify_event_t* dn = (
+                (xcb_destroy_notify_event_t*)event);
+            if (!tracking_is_overlay(state, dn->window)) {
+                tracking_handle_removal(state, dn->window);
+            }
+            break;
+        }
+    }
+    if (input->event_handler != NULL) {
+        input->event_handler(event, input->event_handler_data);
+    }
+}
+
+
+/**
+ * Choose the windows whose overlay windows were clicked, as passed on by the
+ * render thread, until one is chosen.  Clicks on windows that have gone since
+ * are ignored, as are clicks the render thread resolved before it saw the
+ * windows relabelled.
+ */
+void handle_clicks (xcw_state_t* state) {
+    overlay_owner_t owner;
+    while (state->status == XCW_RUNNING &&
+           read(state->render->click_fds[0], &owner, sizeof(owner)) ==
+           sizeof(owner)) {
+        // the overlay may have been clicked before typing hid it, so this
+        // doesn't depend on the current level
+        if (owner.index < state->tracked_size &&
+            state->tracked[owner.index].window == owner.window) {
+            tracking_choose(state, owner.window);
+        }
+    }
+}
+
+
+/**
+ * Main loop of the input thread: handle events for the keyboard grab and for
+ * tracked windows, and clicks on overlay windows, until choosing finishes, or
+ * the render thread fails.
+ */
+void input_run (xcw_state_t* state) {
+    struct pollfd fds[] = {
+        { xcb_get_file_descriptor(state->xcon), POLLIN, 0 },
+        { state->render->stop_fds[0], POLLIN, 0 },
+        { state->render->click_fds[0], POLLIN, 0 }
+    };
+
+    while (state->status == XCW_RUNNING) {
+        // keys typed ahead are all applied before anything is drawn, and if
+        // they choose a window, nothing is
+        xcb_generic_event_t* event;
+        while (state->status == XCW_RUNNING &&
+               (event = xcb_poll_for_event(state->xcon))) {
+            handle_event(state, event);
+            free(event);
+        }
+        if (state->status != XCW_RUNNING) break;
+        if (xcb_connection_has_error(state->xcon)) {
+            xcw_state_fail(state, "connection");
+            break;
+        }
+        render_publish_typing(state);
+
+        if (poll(fds, 3, -1) < 0 && errno != EINTR) {
+            xcw_state_fail(state, "poll: %s", strerror(errno));
+        } else if (fds[1].revents != 0) {
+            // the render thread's error is taken by `render_stop`
+            state->status = XCW_ERROR;
+        } else if (fds[2].revents != 0) {
+            handle_clicks(state);
+        }
+    }
+}
+
+
+/**
+ * Let the user choose a window, once `initialise_xorg`, `initialise_atoms` and
+ * `initialise_root_events` have succeeded.  Returns when choosing finishes
+ * (see `state->status`).
+ */
+void choose (xcw_state_t* state) {
+    xcb_window_t* windows;
+    int windows_size;
+    xcb_window_t* tops;
+    xcb_rectangle_t* rects;
+    char** names;
+    if (initialise_tracked_windows(state, &windows, &windows_size, &tops,
+                                   &rects, &names) != 0) {
+        return;
+    }
+    int* order = NULL;
+    int status = state->input->search ?
+        initialise_search_tracking(state, windows, names, windows_size) :
+        initialise_window_tracking(state, windows, names, windows_size, 1,
+                                   &order);
+    if (order != NULL) {
+        reorder_items(windows, sizeof(xcb_window_t), order, windows_size);
+        reorder_items(tops, sizeof(xcb_window_t), order, windows_size);
+        reorder_items(rects, sizeof(xcb_rectangle_t), order, windows_size);
+        reorder_items(names, sizeof(char*), order, windows_size);
+        free(order);
+    }
+
+    // replies to these have arrived by now
+    if (status == 0 && initialise_input(state) == 0 &&
+        initialise_font(state) == 0 && initialise_keycodes(state) == 0) {
+        initialise_tracking(state, windows, tops, rects, names, windows_size);
+        int* paint_order = calloc(windows_size > 0 ? windows_size : 1,
+                                  sizeof(int));
+        initialise_paint_order(state, windows, tops, rects, windows_size,
+                               paint_order);
+        if (initialise_render(state) == 0) {
+            initialise_overlays(&(state->render->state), rects, windows_size,
+                                paint_order);
+        }
+        free(paint_order);
+    } else if (names != NULL) {
+        for (int i = 0; i < windows_size; i++) free(names[i]);
+    }
+    free(names);
+    free(rects);
+    free(tops);
+    free(windows);
+    if (state->status != XCW_RUNNING) return;
+
+    if (state->wsetups_size == 0) {
+        state->status = XCW_NO_MATCH;
+    } else if (windows_size == 1) {
+        // with stable labels, the window's key may not be the first
+        window_setup_t* wsetup = state->wsetups;
+        while (wsetup->window == NULL && wsetup->children == NULL) wsetup++;
+        wsetup_choose(state, wsetup);
+    }
+    if (state->status == XCW_RUNNING && render_start(state) == 0) {
+        input_run(state);
+    }
+}
+
+
+/**
+ * Find the windows that could be chosen, once `initialise_xorg` and
+ * `initialise_atoms` have succeeded.
+ *
+ * listed (output): as for `xcw_list_windows`
+ * listed_size (output): size of `listed`
+ *
+ * returns: 0 on success, -1 on failure (see `xcw_state_fail`); outputs are
+ *     only set on success
+ */
+int list (xcw_state_t* state,
+          xcw_listed_window_t** listed, int* listed_size) {
+    xcb_window_t* windows;
+    int windows_size;
+    xcb_window_t* tops;
+    xcb_rectangle_t* rects;
+    char** names;
+    if (initialise_tracked_windows(state, &windows, &windows_size, &tops,
+                                   &rects, &names) != 0) {
+        return -1;
+    }
+    int* order;
+    int status = initialise_window_tracking(state, windows, names,
+                                            windows_size, 1, &order);
+    if (order != NULL) {
+        reorder_items(rects, sizeof(xcb_rectangle_t), order, windows_size);
+        free(order);
+    }
+    if (status == 0) {
+        *listed = calloc(windows_size > 0 ? windows_size : 1,
+                         sizeof(xcw_listed_window_t));
+        *listed_size = windows_size;
+        wsetups_list(state, rects, *listed);
+    }
+    if (names != NULL) {
+        for (int i = 0; i < windows_size; i++) free(names[i]);
+    }
+    free(names);
+    free(rects);
+    free(tops);
+    free(windows);
+    return status;
+}
+
+
+/**
+ * Undo everything done to the X server while choosing, and free the program
+ * state.  Replies that haven't been used are waited for or discarded, so
+ * that none are left on the connection.
+ *
+ * error (output): with XCW_ERROR, `state->error`; otherwise, set to NULL
+ *
+ * returns: the result of choosing: XCW_CHOSEN, XCW_NO_MATCH or XCW_ERROR
+ */
+int xcw_state_free (xcw_state_t* state, char** error) {
+    xcw_render_t* render = state->render;
+    // overlay windows belong to the render thread's connection
+    xcw_state_t* overlays_state = state;
+    if (render != NULL) {
+        render_stop(state);
+        overlays_state = &(render->state);
+        // keep every overlay window for the next choice
+        state->overlay_pool->idle_max = state->overlay_pool->created_size;
+    }
+
+    if (state->wsetups_root != NULL) {
+        for (int i = 0; i < state->wsetups_root_size; i++) {
+            wsetup_free(overlays_state, &(state->wsetups_root[i]));
+        }
+        free(state->wsetups_root);
+    }
+    free(state->labels);
+    free(state->history);
+    xcw_search_t* search = &(state->search);
+    for (int i = 0; i < search->query_size; i++) {
+        free(search->matches[i]);
+        free(search->levels[i]);
+    }
+    for (int i = 0; i < search->retired_size; i++) free(search->retired[i]);
+    free(search->matches);
+    free(search->matches_sizes);
+    free(search->levels);
+    free(search->retired);
+    free(search->query);
+    title_index_free(&(search->index));
+    for (int i = 0; i < state->tracked_size; i++) {
+        free(state->tracked[i].name);
+    }
+    free(state->tracked);
+    free(state->keycodes_ksl);
+    free(state->overlay_char_widths);
+    free(state->discovery.normal_types);
+    free(state->monitors);
+
+    if (render != NULL) {
+        // the connection and its pool of overlay windows are kept in `input`
+        free(render->state.overlay_owners.slots);
+        if (!xcb_connection_has_error(render->state.xcon)) {
+            xcb_flush(render->state.xcon);
+        }
+        for (int i = 0; i < 2; i++) {
+            if (render->wake_fds[i] != -1) close(render->wake_fds[i]);
+            if (render->stop_fds[i] != -1) close(render->stop_fds[i]);
+            if (render->click_fds[i] != -1) close(render->click_fds[i]);
+        }
+        free(render);
+    }
+
+    xcb_connection_t* xcon = state->xcon;
+    xcw_cookies_t* cookies = &(state->cookies);
+    if (cookies->ewmh != NULL) {
+        xcw_input_t* input = state->input;
+        if (xcb_ewmh_init_atoms_replies(&(input->ewmh), cookies->ewmh, NULL)) {
+            xcb_ewmh_connection_wipe(&(input->ewmh));
+        }
+    }
+    discovery_cancel(&(state->discovery));
+    if (!state->list) {
+        xcb_ungrab_keyboard(xcon, XCB_CURRENT_TIME);
+        if (state->root_events_selected) {
+            uint32_t root_mask[] = { state->root_event_mask };
+            xcb_change_window_attributes(xcon, state->xroot,
+                                         XCB_CW_EVENT_MASK, root_mask);
+        }
+        for (int i = 0; i < state->masked_size; i++) {
+            uint32_t mask[] = { state->masked[i].event_mask };
+            // the window may be gone by now
+            xcb_void_cookie_t cwac = xcb_change_window_attributes_checked(
+                xcon, state->masked[i].window, XCB_CW_EVENT_MASK, mask);
+            xcb_discard_reply(xcon, cwac.sequence);
+        }
+        if (state->overlay_font != XCB_NONE) {
+            xcb_void_cookie_t cfc = xcb_close_font_checked(
+                xcon, state->overlay_font);
+            xcb_discard_reply(xcon, cfc.sequence);
+        }
+    }
+    free(state->masked);
+    unsigned int sequences[] = {
+        cookies->wm_state.sequence, cookies->keyboard_mapping.sequence,
+        cookies->open_font.sequence, cookies->query_font.sequence,
+        cookies->grab_keyboard.sequence, cookies->wm_change_state.sequence,
+        cookies->root_attributes.sequence, cookies->query_pointer.sequence,
+        cookies->input_focus.sequence, cookies->instance_atoms[0].sequence,
+        cookies->instance_atoms[1].sequence,
+        cookies->instance_atoms[2].sequence, cookies->instance_owner.sequence
+    };
+    for (size_t i = 0; i < sizeof(sequences) / sizeof(*sequences); i++) {
+        if (sequences[i] != 0) xcb_discard_reply(xcon, sequences[i]);
+    }
+    if (!xcb_connection_has_error(xcon)) xcb_flush(xcon);
+
+    int status = state->status;
+    if (status == XCW_RUNNING) {
+        // only possible if nothing was started
+        xcw_state_fail(state, "not finished");
+        status = XCW_ERROR;
+    }
+    if (state->instance_window != XCB_NONE) {
+        instance_release(state, status);
+        if (!xcb_connection_has_error(xcon)) xcb_flush(xcon);
+    }
+    free(state->instance_requests);
+    if (state->recorder != NULL) {
+        if (trace_recorder_close(state->recorder, status,
+                                 state->chosen) != 0 &&
+            status != XCW_ERROR) {
+            xcw_state_fail(state, "can't record to %s: %s",
+                           state->input->record_path, strerror(errno));
+            status = XCW_ERROR;
+        }
+        free(state->recorder);
+    }
+    *error = NULL;
+    if (status == XCW_ERROR) *error = state->error;
+    else free(state->error);
+    free(state);
+    return status;
+}
+
+
+// -- public functions
+
+xcw_options_t* xcw_options_create (void) {
+    xcw_input_t input = {
+        NULL, 0, NULL, 0, NULL, 0, 0, OVERLAY_SIZE_FULL,
+        &(ALL_ANCHORS_LOOKUP[0]), ACTION_NONE, 0, NULL, NULL, 0, 0, NULL,
+        NULL, INSTANCE_WAIT, 0, NULL, NULL, NULL, NULL, NULL, NULL, { 0 },
+        XCB_NONE, XCB_NONE, { XCB_NONE, XCB_NONE, XCB_NONE }, NULL, NULL,
+        { NULL, 0, 0, 0, 0 }
+    };
+    xcw_input_t* options = malloc(sizeof(xcw_input_t));
+    if (options != NULL) *options = input;
+    return options;
+}
+
+
+void xcw_options_free (xcw_options_t* options) {
+    free(options->ksl);
+    free(options->blacklist);
+    free(options->whitelist);
+    if (options->filter != NULL) {
+        filter_free(options->filter);
+        free(options->filter);
+    }
+    for (int i = 0; i < options->filter_sources_size; i++) {
+        free(options->filter_sources[i]);
+    }
+    free(options->filter_sources);
+    if (options->label_store != NULL) {
+        label_store_close(options->label_store);
+        free(options->label_store);
+    }
+    free(options->record_path);
+    free(options->display);
+    if (options->atoms_xcon != NULL) xcb_ewmh_connection_wipe(&(options->ewmh));
+    xorg_render_disconnect(options);
+    free(options);
+}
+
+
+int xcw_options_set_characters (xcw_options_t* options, char* characters,
+                                char** error) {
+    // we won't put more than `characters` items in `ksl`
+    int pool_size = strlen(characters);
+    keysyms_lookup_t* ksl = calloc(pool_size + 1, sizeof(keysyms_lookup_t));
+    int size = 0;
+
+    // check validity of characters, compile lookup
+    for (int i = 0; i < pool_size; i++) {
+        char c = characters[i];
+        keysyms_lookup_t* ksl_item = keysyms_lookup_find_char(
+            ALL_KEYSYMS_LOOKUP, ALL_KEYSYMS_LOOKUP_SIZE, c);
+        if (ksl_item == NULL) {
+            free(ksl);
+            *error = NULL;
+            return xcw_error(error, "unknown character: %c", c);
+        }
+        // don't allow duplicates in lookup
+        if (keysyms_lookup_find_char(ksl, size, c) == NULL) {
+            ksl[size] = *ksl_item;
+            size += 1;
+        }
+    }
+
+    if (size < 2) {
+        free(ksl);
+        *error = NULL;
+        return xcw_error(error, "expected at least two characters");
+    }
+    free(options->ksl);
+    options->ksl = realloc(ksl, sizeof(keysyms_lookup_t) * size);
+    options->ksl_size = size;
+    return 0;
+}
+
+
+/**
+ * Add a window to a list of windows in options.
+ *
+ * windows: the list, which is extended, and its size updated
+ */
+void options_add_window (xcb_window_t** windows, int* windows_size,
+                         xcb_window_t window) {
+    *windows = realloc(*windows, sizeof(xcb_window_t) * (*windows_size + 1));
+    (*windows)[*windows_size] = window;
+    *windows_size += 1;
+}
+
+
+void xcw_options_add_blacklist (xcw_options_t* options, xcb_window_t window) {
+    options_add_window(&(options->blacklist), &(options->blacklist_size),
+                       window);
+}
+
+
+void xcw_options_add_whitelist (xcw_options_t* options, xcb_window_t window) {
+    options_add_window(&(options->whitelist), &(options->whitelist_size),
+                       window);
+}
+
+
+void xcw_options_set_visible_only (xcw_options_t* options, int visible_only) {
+    options->visible_only = visible_only != 0;
+}
+
+
+int xcw_options_set_overlay_size (xcw_options_t* options, char* size,
+                                  char** error) {
+    if (strcmp(size, "full") == 0) {
+        options->overlay_size = OVERLAY_SIZE_FULL;
+    } else if (strcmp(size, "label") == 0) {
+        options->overlay_size = OVERLAY_SIZE_LABEL;
+    } else {
+        *error = NULL;
+        return xcw_error(error, "invalid value for overlay size: %s", size);
+    }
+    return 0;
+}
+
+
+int xcw_options_set_anchor (xcw_options_t* options, char* anchor,
+                            char** error) {
+    for (int i = 0; i < ALL_ANCHORS_LOOKUP_SIZE; i++) {
+        if (strcmp(anchor, ALL_ANCHORS_LOOKUP[i].name) == 0) {
+            options->anchor = &(ALL_ANCHORS_LOOKUP[i]);
+            return 0;
+        }
+    }
+    *error = NULL;
+    return xcw_error(error, "invalid value for anchor: %s", anchor);
+}
+
+
+int xcw_options_set_action (xcw_options_t* options, char* action,
+                            char** error) {
+    char* desktop_prefix = "desktop=";
+    *error = NULL;
+    if (strcmp(action, "focus") == 0) {
+        options->action = ACTION_FOCUS;
+    } else if (strcmp(action, "close") == 0) {
+        options->action = ACTION_CLOSE;
+    } else if (strcmp(action, "raise") == 0) {
+        options->action = ACTION_RAISE;
+    } else if (strcmp(action, "minimize") == 0) {
+        options->action = ACTION_MINIMIZE;
+    } else if (strncmp(action, desktop_prefix, strlen(desktop_prefix)) == 0) {
+        char* desktop = action + strlen(desktop_prefix);
+        char* end;
+        errno = 0;
+        unsigned long n = strtoul(desktop, &end, 10);
+        if (errno != 0 || *desktop == '\0' || *desktop == '-' ||
+            *end != '\0' || n > UINT32_MAX) {
+            return xcw_error(error, "invalid desktop for action: %s", desktop);
+        }
+        options->action = ACTION_DESKTOP;
+        options->action_desktop = n;
+    } else {
+        return xcw_error(error, "invalid value for action: %s", action);
+    }
+    return 0;
+}
+
+
+int xcw_options_add_filter (xcw_options_t* options, char* filter,
+                            char** error) {
+    if (options->filter == NULL) {
+        options->filter = calloc(1, sizeof(filter_t));
+    }
+    char* filter_error;
+    int error_position;
+    *error = NULL;
+    if (filter_compile(filter, options->filter,
+                       &filter_error, &error_position) != 0) {
+        return xcw_error(error, "invalid filter: %s: %s at '%s'",
+                         filter, filter_error, filter + error_position);
+    }
+    options->filter_sources = realloc(
+        options->filter_sources,
+        sizeof(char*) * (options->filter_sources_size + 1));
+    options->filter_sources[options->filter_sources_size] = strdup(filter);
+    options->filter_sources_size += 1;
+    return 0;
+}
+
+
+void xcw_options_set_search (xcw_options_t* options, int search) {
+    options->search = search != 0;
+}
+
+
+int xcw_options_set_stable_labels (xcw_options_t* options, char* path,
+                                   char** error) {
+    label_store_t* store = NULL;
+    if (path != NULL) {
+        store = malloc(sizeof(label_store_t));
+        if (label_store_open(path, store) != 0) {
+            free(store);
+            *error = NULL;
+            return xcw_error(error, "can't open %s: %s", path,
+                             strerror(errno));
+        }
+    }
+    if (options->label_store != NULL) {
+        label_store_close(options->label_store);
+        free(options->label_store);
+    }
+    options->label_store = store;
+    return 0;
+}
+
+
+void xcw_options_set_record (xcw_options_t* options, char* path) {
+    free(options->record_path);
+    options->record_path = path == NULL ? NULL : strdup(path);
+}
+
+
+int xcw_options_set_instance (xcw_options_t* options, char* mode,
+                              char** error) {
+    if (strcmp(mode, "wait") == 0) {
+        options->instance = INSTANCE_WAIT;
+    } else if (strcmp(mode, "replace") == 0) {
+        options->instance = INSTANCE_REPLACE;
+    } else if (strcmp(mode, "ignore") == 0) {
+        options->instance = INSTANCE_IGNORE;
+    } else {
+        *error = NULL;
+        return xcw_error(error, "invalid value for instance: %s", mode);
+    }
+    return 0;
+}
+
+
+void xcw_options_set_click (xcw_options_t* options, int click) {
+    options->click = click != 0;
+}
+
+
+void xcw_options_set_display (xcw_options_t* options, char* display) {
+    free(options->display);
+    options->display = display == NULL ? NULL : strdup(display);
+    // the next choice connects again
+    xorg_render_disconnect(options);
+}
+
+
+void xcw_options_set_event_handler (xcw_options_t* options,
+                                    xcw_event_handler_t handler, void* data) {
+    options->event_handler = handler;
+    options->event_handler_data = data;
+}
+
+
+void xcw_options_set_paint_handler (xcw_options_t* options,
+                                    xcw_paint_handler_t handler, void* data) {
+    options->paint_handler = handler;
+    options->paint_handler_data = data;
+}
+
+
+int xcw_choose_window (xcb_connection_t* xcon, xcw_options_t* options,
+                       xcb_window_t* window, char** error) {
+    XCW_PROBE0(choose_start);
+    xcw_state_t* state;
+    if (initialise_xorg(xcon, options, 0, &state) == 0 &&
+        initialise_atoms(state) == 0 && initialise_instance(state) == 0 &&
+        state->status == XCW_RUNNING && initialise_root_events(state) == 0) {
+        choose(state);
+    }
+    xcb_window_t chosen = state->chosen;
+    int status = xcw_state_free(state, error);
+    if (status == XCW_CHOSEN) *window = chosen;
+    XCW_PROBE2(choose_done, status, chosen);
+    return status;
+}
+
+
+int xcw_list_windows (xcb_connection_t* xcon, xcw_options_t* options,
+                      xcw_listed_window_t** windows, int* windows_size,
+                      char** error) {
+    xcw_state_t* state;
+    if (initialise_xorg(xcon, options, 1, &state) == 0 &&
+        initialise_atoms(state) == 0 &&
+        list(state, windows, windows_size) == 0) {
+        // listing has no result
+        state->status = XCW_CHOSEN;
+    }
+    return xcw_state_free(state, error) == XCW_ERROR ? XCW_ERROR : 0;
+}
+
+
+void xcw_listed_windows_free (xcw_listed_window_t* windows,
+                              int windows_size) {
+    for (int i = 0; i < windows_size; i++) free(windows[i].label);
+    free(windows);
+}
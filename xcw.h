@@ -0,0 +1,326 @@
+/*
+
+Licensed under the Apache License, Version 2.0 (the "License"); you may not use
+this file except in compliance with the License. You may obtain a copy of the
+License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software distributed
+under the License is distributed on an "AS IS" BASIS, WITHOUT WARRANTIES OR
+CONDITIONS OF ANY KIND, either express or implied. See the License for the
+specific language governing permissions and limitations under the License.
+
+*/
+
+#ifndef XCW_XCW_H
+#define XCW_XCW_H
+
+#include <xcb/xcb.h>
+
+
+// -- constants
+
+/**
+ * Results of `xcw_choose_window` and `xcw_list_windows`.
+ *
+ * XCW_ERROR: something went wrong; nothing was chosen
+ * XCW_CHOSEN: a window was chosen
+ * XCW_NO_MATCH: the user typed a key that matches no window, or there were no
+ *     windows to choose from
+ */
+#define XCW_ERROR -1
+#define XCW_CHOSEN 0
+#define XCW_NO_MATCH 1
+
+
+// -- types
+
+/**
+ * Options for choosing a window.  Created by `xcw_options_create` and changed
+ * through the `xcw_options_*` functions; the same options can be used for any
+ * number of choices, one at a time.
+ */
+typedef struct xcw_input_t xcw_options_t;
+
+/**
+ * A window that can be chosen, as found by `xcw_list_windows`.
+ *
+ * window: the window ID
+ * label: the characters that would be typed to choose `window`
+ * rect: absolute area of `window`, or its largest visible part with
+ *     `xcw_options_set_visible_only`
+ */
+typedef struct xcw_listed_window_t {
+    xcb_window_t window;
+    char* label;
+    xcb_rectangle_t rect;
+} xcw_listed_window_t;
+
+/**
+ * Called for events received while choosing a window, so that a program
+ * sharing the connection doesn't miss them.
+ *
+ * event: the event, which is freed afterwards
+ * data: as passed to `xcw_options_set_event_handler`
+ */
+typedef void (*xcw_event_handler_t) (xcb_generic_event_t* event, void* data);
+
+/**
+ * Called as overlays are first drawn while choosing a window, once the X
+ * server has drawn them: when the first few (those nearest the pointer and the
+ * focused window) are drawn, and when all of them are.  If there are only a
+ * few windows, it's only called once.
+ *
+ * drawn: number of windows whose labels have been drawn
+ * total: number of windows
+ * seconds: time since `xcw_choose_window` was called
+ * data: as passed to `xcw_options_set_paint_handler`
+ */
+typedef void (*xcw_paint_handler_t) (int drawn, int total, double seconds,
+                                     void* data);
+
+
+// -- functions
+
+/**
+ * Create options with the defaults: no characters (one of
+ * `xcw_options_set_characters` and `xcw_options_set_search` is required),
+ * windows are fully covered, and nothing is done to the chosen window.
+ *
+ * returns: the options, which should be freed with `xcw_options_free`, or NULL
+ *     if memory can't be allocated
+ */
+xcw_options_t* xcw_options_create (void);
+
+/**
+ * Free options, and anything remembered by using them, including the overlay
+ * windows kept for the next choice.
+ */
+void xcw_options_free (xcw_options_t* options);
+
+/**
+ * Set the characters that labels are made of, or that can be typed with
+ * `xcw_options_set_search`.
+ *
+ * characters: at least two of the numbers 0-9 and the letters a-z;
+ *     repeated characters are ignored
+ * error (output): on failure, a description of the problem, which should be
+ *     freed (or NULL if memory can't be allocated)
+ *
+ * returns: 0 on success, -1 if `characters` is invalid
+ */
+int xcw_options_set_characters (xcw_options_t* options, char* characters,
+                                char** error);
+
+/**
+ * Ignore a window.
+ */
+void xcw_options_add_blacklist (xcw_options_t* options, xcb_window_t window);
+
+/**
+ * Only include some windows.  Windows not passed to this are ignored, unless
+ * this is never called.
+ */
+void xcw_options_add_whitelist (xcw_options_t* options, xcb_window_t window);
+
+/**
+ * Set whether to ignore windows that are completely covered by other windows,
+ * and only cover the visible part of partially covered windows.
+ */
+void xcw_options_set_visible_only (xcw_options_t* options, int visible_only);
+
+/**
+ * Set how much of each window to cover.
+ *
+ * size: 'full' or 'label' (just enough to show the text)
+ * error (output): as for `xcw_options_set_characters`
+ *
+ * returns: 0 on success, -1 if `size` is invalid
+ */
+int xcw_options_set_overlay_size (xcw_options_t* options, char* size,
+                                  char** error);
+
+/**
+ * Set where to place overlays when only covering enough to show the label.
+ *
+ * anchor: 'centre', 'top-left', 'top', 'top-right', 'left', 'right',
+ *     'bottom-left', 'bottom' or 'bottom-right'
+ * error (output): as for `xcw_options_set_characters`
+ *
+ * returns: 0 on success, -1 if `anchor` is invalid
+ */
+int xcw_options_set_anchor (xcw_options_t* options, char* anchor,
+                            char** error);
+
+/**
+ * Set what to ask the window manager to do to the chosen window.
+ *
+ * action: 'focus', 'close', 'raise', 'minimize' or 'desktop=N' (move it to
+ *     desktop N, counting from 0)
+ * error (output): as for `xcw_options_set_characters`
+ *
+ * returns: 0 on success, -1 if `action` is invalid
+ */
+int xcw_options_set_action (xcw_options_t* options, char* action,
+                            char** error);
+
+/**
+ * Only include windows matching a filter, in the syntax described by
+ * `xorg-choose-window --help`.  If this is called more than once, every filter
+ * must match.  Docks, desktops and other special windows are left out unless a
+ * filter tests window types.  Windows without a type are normal.
+ *
+ * filter: the filter; not kept
+ * error (output): as for `xcw_options_set_characters`, including the position
+ *     of the problem in `filter`
+ *
+ * returns: 0 on success, -1 if `filter` is invalid
+ */
+int xcw_options_add_filter (xcw_options_t* options, char* filter,
+                            char** error);
+
+/**
+ * Set whether windows are chosen by typing part of their title or class
+ * instead of their label.  If no characters are set, every allowed character
+ * can be typed.
+ */
+void xcw_options_set_search (xcw_options_t* options, int search);
+
+/**
+ * Keep each window's label across choices, and across programs using the same
+ * file, instead of labelling windows by position.  Labels are remembered by
+ * window and application (WM_CLASS), so a window that is reopened, or a
+ * program that is restarted, usually gets its old label back.  Labels may be
+ * longer than necessary, and skip some characters.  Doesn't apply with
+ * `xcw_options_set_search`.
+ *
+ * path: the file labels are remembered in, which is created if it doesn't
+ *     exist; or NULL to stop keeping labels
+ * error (output): as for `xcw_options_set_characters`
+ *
+ * returns: 0 on success, -1 if the file can't be opened
+ */
+int xcw_options_set_stable_labels (xcw_options_t* options, char* path,
+                                   char** error);
+
+/**
+ * Record each choice to a file, replacing it, so that it can be replayed
+ * without the X server by xcw-replay: the requests used to find windows with
+ * their replies and timing, the labels given, keys typed, and the result.  The
+ * trace includes window titles.  If writing fails, the choice fails.
+ *
+ * path: the file, or NULL to stop recording; copied
+ */
+void xcw_options_set_record (xcw_options_t* options, char* path);
+
+/**
+ * Set what to do when another chooser (from this library, or another process)
+ * is already running on the display, found through the _XCW_INSTANCE
+ * selection it owns: "wait" (the default) for it to finish and take its
+ * result, without finding windows or drawing anything; "replace" to stop it,
+ * and choose once it has; or "ignore" it, in which case grabbing the keyboard
+ * fails if it doesn't finish within a second.  If it fails, or stops without
+ * answering, we choose instead.  A result taken from another chooser was
+ * chosen with that chooser's filters and characters, but our own action (see
+ * `xcw_options_set_action`) is still performed on it.
+ *
+ * error (output): as for `xcw_options_set_characters`
+ *
+ * returns: 0 on success, -1 if `mode` is invalid
+ */
+int xcw_options_set_instance (xcw_options_t* options, char* mode,
+                              char** error);
+
+/**
+ * Set whether clicking a window's overlay chooses it, as typing the rest of its
+ * label would.  Clicks elsewhere go to other windows as usual.
+ */
+void xcw_options_set_click (xcw_options_t* options, int click);
+
+/**
+ * Set the display that overlays are drawn on, which must be the one the
+ * connection passed to `xcw_choose_window` is to (see there).  Only needed if
+ * that isn't the display named by $DISPLAY.
+ *
+ * display: the display name, as for `xcb_connect`, or NULL for $DISPLAY;
+ *     copied
+ */
+void xcw_options_set_display (xcw_options_t* options, char* display);
+
+/**
+ * Set a function to call with every event received on the connection passed to
+ * `xcw_choose_window`, other than key presses.  This includes events the
+ * program sharing the connection asked for, and events asked for while
+ * choosing (substructure events on the root window, and structure events on
+ * client windows inside frames).  Errors are passed to `handler` too, since
+ * they may be for the program's own requests; without a handler, they make
+ * the choice fail.
+ *
+ * handler: the function, or NULL to drop events
+ * data: passed to `handler`
+ */
+void xcw_options_set_event_handler (xcw_options_t* options,
+                                    xcw_event_handler_t handler, void* data);
+
+/**
+ * Set a function to call as overlays are first drawn, to measure how long it
+ * takes.  Measuring costs a round trip once everything is drawn.
+ *
+ * handler: the function, or NULL to not measure
+ * data: passed to `handler`
+ */
+void xcw_options_set_paint_handler (xcw_options_t* options,
+                                    xcw_paint_handler_t handler, void* data);
+
+/**
+ * Let the user choose a window: grab the keyboard, draw a label over each
+ * window, and wait until one is typed.  Before returning, the keyboard is
+ * released, overlays are unmapped, and event masks changed on `xcon` are
+ * restored.
+ *
+ * Overlays are drawn by a thread with its own connection, so the library opens
+ * a second connection, to the display named by $DISPLAY or set with
+ * `xcw_options_set_display`; everything else uses `xcon`.  Choosing fails if
+ * the second connection is plainly to a different display from `xcon`.
+ *
+ * Atoms are interned once per connection and remembered by `options`, so
+ * `options` should only be reused with a connection to the same display.  The
+ * overlay windows, and the thread's connection they belong to, are kept by
+ * `options` too, so that choosing again with the same connection creates no
+ * windows; they're released by `xcw_options_free`.
+ *
+ * xcon: an open connection
+ * window (output): the chosen window, with XCW_CHOSEN
+ * error (output): with XCW_ERROR, a description of the problem, which should
+ *     be freed (or NULL if memory can't be allocated)
+ *
+ * returns: XCW_CHOSEN, XCW_NO_MATCH or XCW_ERROR
+ */
+int xcw_choose_window (xcb_connection_t* xcon, xcw_options_t* options,
+                       xcb_window_t* window, char** error);
+
+/**
+ * Find the windows that could be chosen, with their labels, without grabbing
+ * the keyboard or drawing anything.  Options only affecting choosing are
+ * ignored.
+ *
+ * xcon: an open connection
+ * windows (output): the windows, in label order; should be freed with
+ *     `xcw_listed_windows_free`
+ * windows_size (output): size of `windows`
+ * error (output): as for `xcw_choose_window`
+ *
+ * returns: 0 on success (even if there are no windows), or XCW_ERROR
+ */
+int xcw_list_windows (xcb_connection_t* xcon, xcw_options_t* options,
+                      xcw_listed_window_t** windows, int* windows_size,
+                      char** error);
+
+/**
+ * Free windows returned by `xcw_list_windows`.
+ */
+void xcw_listed_windows_free (xcw_listed_window_t* windows, int windows_size);
+
+
+#endif